@@ -0,0 +1,89 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_ANNOTATE_H_
+#define SRC_UCI_ANNOTATE_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "engine.h"
+#include "pgn.h"
+
+
+namespace chessUCI {
+
+/**
+ *  \namespace chessUCI::annotate
+ *  \brief Batch analysis of PGN files, run with "uci annotate <file>".
+ */
+namespace annotate {
+
+/** A struct holding the settings of an annotation run. */
+struct AnnotateSettings {
+    /** The limits of the search of each ply. */
+    SearchLimits limits;
+    /** The number of games analysed at once, each on its own thread. */
+    int threads;
+    /** The size of the hash table of each thread in megabytes. */
+    int hash;
+
+    AnnotateSettings();
+};
+
+/**
+ *  Analyse every ply of a game and write it back as PGN, with the score and
+ *  the best move of each position in a comment after the move played there.
+ *  The game is walked forward one move at a time, and the hash table is kept
+ *  from ply to ply.
+ *
+ *  \param engine           The engine to analyse with.
+ *  \param game             The game to analyse.
+ *  \param limits           The limits of the search of each ply.
+ *  \param out              The stream to write the annotated game to.
+ *
+ *  \return                 False if the game has an illegal move, in which
+ *                          case it is annotated up to that move.
+ */
+bool annotateGame(Engine& engine, const PgnGame& game,
+                  const SearchLimits& limits, std::ostream& out);
+
+/**
+ *  Annotate every game of a PGN stream. Games are read, analysed on
+ *  \ref AnnotateSettings::threads threads and written back in their original
+ *  order as soon as possible, with only a few games in memory at any time.
+ *
+ *  \param in               The PGN stream to read.
+ *  \param out              The stream to write the annotated games to.
+ *  \param err              The stream to report errors to.
+ *  \param settings         The settings of the run.
+ *
+ *  \return                 The number of games annotated.
+ */
+int annotateStream(std::istream& in, std::ostream& out, std::ostream& err,
+                   const AnnotateSettings& settings);
+
+/**
+ *  Run the annotate mode from the command line. The arguments are the PGN
+ *  file ("-" for standard input) followed by any of "nodes <n>",
+ *  "movetime <ms>", "depth <plies>", "threads <n>" and "hash <mb>".
+ *
+ *  \param args             The command-line arguments after "annotate".
+ *  \param out              The stream to write the annotated games to.
+ *  \param err              The stream to report errors to.
+ *
+ *  \return                 The exit status of the program.
+ */
+int run(const std::vector<std::string>& args, std::ostream& out,
+        std::ostream& err);
+
+}   // namespace annotate
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_ANNOTATE_H_
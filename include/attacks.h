@@ -0,0 +1,163 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_ATTACKS_H_
+#define SRC_UCI_ATTACKS_H_
+
+#include <cstdint>
+
+#include "typedefs.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define ATTACKS_X86
+#include <immintrin.h>
+#endif
+
+
+namespace chessUCI {
+
+/**
+ *  \namespace chessUCI::attacks
+ *  \brief Sliding piece attacks looked up in precomputed tables.
+ *
+ *  The tables can be indexed in two ways: by magic multiplication, which
+ *  runs on any CPU, or by the BMI2 PEXT instruction, which is faster where
+ *  the CPU implements it in hardware. The backend is chosen once at startup
+ *  (see \ref bestBackend). Code that looks attacks up takes the backend as
+ *  a template parameter and is instantiated once per backend, so the choice
+ *  costs nothing per lookup; \ref dispatch calls the right instantiation.
+ */
+namespace attacks {
+
+typedef chessCore::bitboard bitboard;
+
+/** An enum representing the ways of indexing the attack tables. */
+enum Backend {
+    /** Magic multiplication, available everywhere. */
+    backend_magic,
+    /** BMI2 parallel bit extraction. */
+    backend_pext
+};
+
+/** How to find the attacks of a slider on one square. */
+struct SquareTable {
+    /** The squares whose occupancy matters. */
+    bitboard mask;
+    /** The magic multiplier, for \ref backend_magic only. */
+    bitboard magic;
+    /** The attacks of the square, indexed by the relevant occupancy. */
+    const bitboard* attacks;
+    /** 64 minus the number of bits in \ref mask. */
+    unsigned shift;
+};
+
+/** The magic tables of rooks and bishops. */
+extern SquareTable rook_magic[64];
+extern SquareTable bishop_magic[64];
+/** The PEXT tables of rooks and bishops. */
+extern SquareTable rook_pext[64];
+extern SquareTable bishop_pext[64];
+
+/** Build the tables and choose the backend. Safe to call more than once. */
+void init();
+
+/**
+ *  Check whether the CPU has the BMI2 instructions.
+ *
+ *  \return                 True if \ref backend_pext can run.
+ */
+bool pextSupported();
+
+/**
+ *  Get the backend chosen by \ref init: PEXT if the CPU has a fast
+ *  implementation of it (AMD CPUs before Zen 3 emulate it in microcode),
+ *  magic multiplication otherwise.
+ *
+ *  \return                 The backend.
+ */
+Backend bestBackend();
+
+/**
+ *  Get the name of a backend.
+ *
+ *  \param backend          The backend.
+ *
+ *  \return                 "magic" or "pext".
+ */
+const char* backendName(Backend backend);
+
+/** Looks attacks up by magic multiplication. */
+struct MagicAttacks {
+    static bitboard rook(int square, bitboard occupied) {
+        const SquareTable& t = rook_magic[square];
+        return t.attacks[((occupied & t.mask) * t.magic) >> t.shift];
+    }
+
+    static bitboard bishop(int square, bitboard occupied) {
+        const SquareTable& t = bishop_magic[square];
+        return t.attacks[((occupied & t.mask) * t.magic) >> t.shift];
+    }
+};
+
+/**
+ *  Extract the bits of a value selected by a mask. Callers that aren't
+ *  compiled for BMI2 get a function call instead of the bare instruction,
+ *  so hot loops using \ref PextAttacks should be compiled for BMI2 too.
+ *
+ *  \param value            The value.
+ *  \param mask             The bits to extract.
+ *
+ *  \return                 The selected bits of \p value, packed together.
+ */
+#ifdef ATTACKS_X86
+__attribute__((target("bmi2")))
+inline uint64_t pext(uint64_t value, uint64_t mask) {
+    return _pext_u64(value, mask);
+}
+#else
+inline uint64_t pext(uint64_t value, uint64_t mask) {
+    uint64_t result = 0;
+    for (uint64_t bit = 1; mask; bit <<= 1, mask &= mask - 1) {
+        if (value & mask & -mask) result |= bit;
+    }
+    return result;
+}
+#endif
+
+/** Looks attacks up by parallel bit extraction. Needs BMI2. */
+struct PextAttacks {
+    static bitboard rook(int square, bitboard occupied) {
+        const SquareTable& t = rook_pext[square];
+        return t.attacks[pext(occupied, t.mask)];
+    }
+
+    static bitboard bishop(int square, bitboard occupied) {
+        const SquareTable& t = bishop_pext[square];
+        return t.attacks[pext(occupied, t.mask)];
+    }
+};
+
+/**
+ *  Call a generic function with the lookup struct of a backend.
+ *
+ *  \param backend          The backend.
+ *  \param f                The function, called with a \ref MagicAttacks or
+ *                          a \ref PextAttacks.
+ *
+ *  \return                 The result of \p f.
+ */
+template <typename F>
+auto dispatch(Backend backend, F f) -> decltype(f(MagicAttacks())) {
+    if (backend == backend_pext) return f(PextAttacks());
+    return f(MagicAttacks());
+}
+
+}   // namespace attacks
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_ATTACKS_H_
@@ -0,0 +1,169 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_BENCH_H_
+#define SRC_UCI_BENCH_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace chessUCI {
+
+/**
+ *  \namespace chessUCI::bench
+ *  \brief Benchmarks of the interface, run with "uci bench <name>".
+ */
+namespace bench {
+
+/**
+ *  Compare the per-query overhead of the in-process \ref Engine API with that
+ *  of the UCI text protocol, using shallow searches so that the search itself
+ *  does not dominate.
+ *
+ *  \param out              The output stream to report to.
+ *  \param num_queries      The number of queries to time for each path.
+ */
+void apiOverhead(std::ostream& out, int num_queries);
+
+/**
+ *  Measure the per-node cost of repetition detection at the end of a long
+ *  game, against a naive scan of the whole game.
+ *
+ *  \param out              The output stream to report to.
+ *  \param game_length      The number of plies in the game.
+ */
+void repetition(std::ostream& out, int game_length);
+
+/**
+ *  Measure how many moves per second the long algebraic notation codec
+ *  parses (with its legality check) and formats.
+ *
+ *  \param out              The output stream to report to.
+ *  \param num_positions    The number of positions to take moves from.
+ */
+void lanCodec(std::ostream& out, int num_positions);
+
+/**
+ *  Measure the time to reach a fixed depth on the second and later moves of
+ *  a game, with the hash table and predicted line kept from move to move and
+ *  with every search started cold.
+ *
+ *  \param out              The output stream to report to.
+ *  \param num_moves        The number of plies in the game.
+ *  \param depth            The depth to search each position to.
+ */
+void treeReuse(std::ostream& out, int num_moves, int depth);
+
+/**
+ *  Search a fixed suite of positions with the "Deterministic" option to a
+ *  fixed depth, reporting the best move, nodes and speed of each. The best
+ *  moves and node counts are the same from run to run of the same build, and
+ *  the node counts change with the shape of the tree, so
+ *  scripts/regression.sh compares them against a stored baseline.
+ *
+ *  \param out              The output stream to report to.
+ *  \param depth            The depth to search each position to.
+ */
+void search(std::ostream& out, int depth);
+
+/**
+ *  Search the positions of \ref search to a fixed depth with the
+ *  "Deterministic" option, reporting the nodes and time each takes. Fewer
+ *  nodes to the same depth means better move ordering or pruning.
+ *
+ *  \param out              The output stream to report to.
+ *  \param depth            The depth to search each position to.
+ */
+void timeToDepth(std::ostream& out, int depth);
+
+/**
+ *  Search the positions of \ref search to a fixed depth with the
+ *  "Deterministic" option, once with all root moves and once restricted
+ *  to two of them as with "go searchmoves", reporting the nodes and time
+ *  of each. An analysis query on a few moves should cost a fraction of a
+ *  full search.
+ *
+ *  \param out              The output stream to report to.
+ *  \param depth            The depth to search each position to.
+ */
+void restrictedRoot(std::ostream& out, int depth);
+
+/**
+ *  Measure sliding attack lookups per second with each backend the CPU
+ *  supports, checking that they agree.
+ *
+ *  \param out              The output stream to report to.
+ *  \param num_lookups      The number of rook and bishop lookups to time.
+ */
+void slidingAttacks(std::ostream& out, int num_lookups);
+
+/**
+ *  Measure the throughput of each NNUE kernel the CPU supports (full
+ *  evaluations, incremental updates and evaluations from the accumulator)
+ *  against the core's evaluation, checking that all kernels agree. With a
+ *  network file, also compare the speed of a fixed-node search with each
+ *  evaluation.
+ *
+ *  \param out              The output stream to report to.
+ *  \param num_positions    The number of positions to evaluate.
+ *  \param eval_file        The network to use, or "" for random weights.
+ */
+void eval(std::ostream& out, int num_positions, const std::string& eval_file);
+
+/**
+ *  Search the positions of \ref search with the "Deterministic" option and
+ *  a node limit, with the evaluation cache off and at a few sizes. The
+ *  searches are identical, so the difference in speed is what the cache
+ *  saves.
+ *
+ *  \param out              The output stream to report to.
+ *  \param nodes            The node limit of each search.
+ */
+void evalCache(std::ostream& out, uint64_t nodes);
+
+/**
+ *  Solve a suite of mate-in-N puzzles with the mate solver, reporting the
+ *  mate found in each against the expected length, and the puzzles and
+ *  positions solved per second.
+ *
+ *  \param out              The output stream to report to.
+ *  \param repeats          How many times to solve the suite, each time
+ *                          with a cleared table.
+ */
+void mate(std::ostream& out, int repeats);
+
+/**
+ *  Count the leaves of the move trees of a suite of positions with
+ *  \ref Position, generating legal moves with pin and check masks and by
+ *  playing each move, with each attack backend the CPU can run, and with
+ *  the core's board, checking the counts against the known ones and
+ *  reporting leaves per second.
+ *
+ *  \param out              The output stream to report to.
+ *  \param depth            The depth to count to, or 0 for a depth per
+ *                          position that takes a moment.
+ */
+void moveGeneration(std::ostream& out, int depth);
+
+/**
+ *  Run the benchmark named by the first argument, or all of them.
+ *
+ *  \param args             The command-line arguments after "bench".
+ *  \param out              The output stream to report to.
+ *
+ *  \return                 The exit status of the program.
+ */
+int run(const std::vector<std::string>& args, std::ostream& out);
+
+}   // namespace bench
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_BENCH_H_
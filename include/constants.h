@@ -0,0 +1,30 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_CONSTANTS_H_
+#define SRC_UCI_CONSTANTS_H_
+
+#include "typedefs.h"
+
+
+namespace chessUCI {
+
+/** The maximum number of plies the search can reach. */
+const int MAX_PLY = 128;
+
+/** The maximum number of legal moves in any chess position. */
+const int MAX_MOVES = 256;
+
+/** The score of a position where the side to move is mated right now. */
+const chessCore::value_t MATE_VALUE = 30000;
+
+/** Scores beyond this bound (in absolute value) are mate scores. */
+const chessCore::value_t MATE_BOUND = MATE_VALUE - MAX_PLY;
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_CONSTANTS_H_
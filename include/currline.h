@@ -0,0 +1,61 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_CURRLINE_H_
+#define SRC_UCI_CURRLINE_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "constants.h"
+#include "move.h"
+
+
+namespace chessUCI {
+
+/**
+ *  The line a search thread is searching, published by that thread and
+ *  sampled by another under a sequence lock. The writer never waits: it
+ *  makes the sequence number odd, stores the moves, and makes it even
+ *  again. A reader copies the moves and tries again if the number was odd
+ *  or changed in the meantime. The moves are stored packed, as relaxed
+ *  atomics, so a torn read is detected rather than undefined.
+ */
+class SharedLine {
+ private:
+    /** Odd while the line is being written. */
+    std::atomic<uint32_t> sequence;
+    /** The number of moves in the line. */
+    std::atomic<uint8_t> length;
+    /** The moves of the line. */
+    std::atomic<uint16_t> moves[MAX_PLY];
+
+ public:
+    /** Constructor for SharedLine, with an empty line. */
+    SharedLine();
+
+    /**
+     *  Replace the line. Only one thread may publish.
+     *
+     *  \param line             The moves.
+     *  \param num_moves        The number of moves in \p line.
+     */
+    void publish(const chessCore::move_t* line, int num_moves);
+
+    /**
+     *  Copy the line, as it was at some point while reading.
+     *
+     *  \param line             Filled with the moves, room for \ref MAX_PLY.
+     *
+     *  \return                 The number of moves.
+     */
+    int read(chessCore::move_t* line) const;
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_CURRLINE_H_
@@ -0,0 +1,758 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_ENGINE_H_
+#define SRC_UCI_ENGINE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "constants.h"
+#include "currline.h"
+#include "evalcache.h"
+#include "history.h"
+#include "membudget.h"
+#include "matesearch.h"
+#include "metrics.h"
+#include "move.h"
+#include "movepick.h"
+#include "nnue.h"
+#include "numa.h"
+#include "options.h"
+#include "rootmoves.h"
+#include "stats.h"
+#include "tt.h"
+#include "typedefs.h"
+#include "watchdog.h"
+
+
+namespace chessUCI {
+
+/**
+ *  A struct holding the limits of a search, i.e. the typed equivalent of the
+ *  UCI "go" command.
+ */
+struct SearchLimits {
+    /** Start searching in ponder mode. */
+    bool ponder;
+    /** Search until \ref Engine::stop is called. */
+    bool infinite;
+    /** Amount of time white has on the clock in milliseconds. */
+    uint32_t wtime;
+    /** Amount of time black has on the clock in milliseconds. */
+    uint32_t btime;
+    /** White increment per move in milliseconds. */
+    uint32_t winc;
+    /** Black increment per move in milliseconds. */
+    uint32_t binc;
+    /** Number of moves to the next time control. */
+    uint16_t movestogo;
+    /** Maximum search depth in plies. */
+    uint8_t depth;
+    /** Maximum search time in milliseconds. */
+    uint32_t movetime;
+    /** Maximum number of nodes to search, over all threads. */
+    uint64_t nodes;
+    /** Look for a mate in this many moves instead of searching normally. */
+    uint8_t mate;
+    /** Only search these root moves, or all of them if empty. */
+    std::vector<chessCore::move_t> searchmoves;
+
+    SearchLimits();
+};
+
+/**
+ *  A struct holding the result of one search iteration, i.e. the structured
+ *  equivalent of a UCI "info" line.
+ */
+struct SearchInfo {
+    /** Search depth in plies, 0 for a status update with no score. */
+    int depth;
+    /** Selective search depth in plies. */
+    int seldepth;
+    /** Time spent searching in milliseconds. */
+    uint32_t time;
+    /** Number of nodes searched. */
+    uint64_t nodes;
+    /** Number of nodes searched per second. */
+    uint64_t nps;
+    /** The score in centipawns from the point of view of the side to move. */
+    chessCore::value_t score;
+    /** Principal variation, i.e. the best line found. */
+    std::vector<chessCore::move_t> pv;
+    /** How full the hash table is, out of 1000. */
+    int hashfull;
+    /** The CPU load of the search threads, out of 1000. */
+    int cpuload;
+    /** The move being searched at the root, or a null move. */
+    chessCore::move_t currmove;
+    /** The number of \ref currmove among the root moves, from 1. */
+    int currmovenumber;
+    /** A root move followed by the line that refutes it, or empty. */
+    std::vector<chessCore::move_t> refutation;
+    /** The line each search thread is searching, empty if not shown. */
+    std::vector<std::vector<chessCore::move_t>> currline;
+    /** A string to be displayed. If set, the other fields are unused. */
+    std::string string;
+
+    SearchInfo();
+
+    /**
+     *  Check whether \ref score is a mate score.
+     *
+     *  \return                 True if the score is a mate score.
+     */
+    bool isMate() const;
+
+    /**
+     *  Get the number of moves (not plies) to mate. Negative if the side to
+     *  move is getting mated.
+     *
+     *  \return                 The number of moves to mate.
+     */
+    int mateIn() const;
+};
+
+/**
+ *  Convert a move to its long algebraic notation, e.g. "e2e4" or "e7e8q".
+ *
+ *  \param move             The move to convert.
+ *
+ *  \return                 The move in long algebraic notation.
+ */
+std::string move_to_string(chessCore::move_t move);
+
+class Engine;
+
+/**
+ *  The state of one search thread. All threads search the same root and share
+ *  the transposition table ("lazy SMP"); only the main thread (id 0) keeps
+ *  track of time and reports results.
+ */
+class SearchWorker {
+    friend class Engine;
+
+ private:
+    /** The engine the worker belongs to. */
+    Engine& engine;
+    /** The index of the worker, 0 for the main thread. */
+    int id;
+    /** The NUMA node the worker runs on. */
+    int numa_node;
+
+    /** Number of nodes searched, read by the main thread while searching. */
+    std::atomic<uint64_t> nodes;
+    /** The highest ply reached in the current iteration. */
+    int seldepth;
+    /** The last depth that was searched completely. */
+    int completed_depth;
+    /** The score of the last completed iteration. */
+    chessCore::value_t root_score;
+
+    /** Triangular principal variation table. */
+    chessCore::move_t pv_table[MAX_PLY][MAX_PLY];
+    /** Lengths of the lines in \ref pv_table. */
+    int pv_length[MAX_PLY];
+    /** The principal variation of the last completed iteration. */
+    std::vector<chessCore::move_t> root_pv;
+    /** The moves searched at the root, in the order they are searched. */
+    RootMoves root_moves;
+    /** The keys of the game followed by those of the current line. */
+    KeyHistory history;
+    /** The counters of the current search. */
+    SearchStats stats;
+    /** The node count at which the main thread checks its limits next. */
+    uint64_t next_check;
+    /** Hash table hits since the last trace event. */
+    uint32_t tt_hits;
+    /** Hash table misses since the last trace event. */
+    uint32_t tt_misses;
+    /** The move ordering heuristics learnt in the current search. */
+    MoveHistory heuristics;
+    /** The move being searched at each ply. */
+    chessCore::move_t current_moves[MAX_PLY];
+    /** The number of the root move being searched, from 1, 0 if none. */
+    int root_move_number;
+    /** Whether \ref current_line is published, for "UCI_ShowCurrLine". */
+    bool publish_line;
+    /** The line being searched, sampled by the main thread. */
+    SharedLine current_line;
+    /** The static evaluations this worker computed. */
+    EvalCache eval_cache;
+    /** The \ref Engine::eval_generation the cache was filled under. */
+    uint32_t cache_generation;
+    /** The late move reduction by depth and move number, from the options. */
+    int8_t reductions[64][64];
+    /** Whether the current search evaluates with the network. */
+    bool use_nnue;
+    /** The pieces of the position at each ply. */
+    nnue::Pieces pieces[MAX_PLY + 1];
+    /** The accumulators of the position at each ply. */
+    nnue::Accumulator accumulators[MAX_PLY + 1];
+
+    /**
+     *  Count a node, and let the main thread check the limits now and then.
+     *  Checks are batched, but never step over a node limit, so a
+     *  single-threaded search stops after exactly that many nodes. Every so
+     *  often the current line is published too, if it is shown.
+     *
+     *  \param ply              The distance from the root in plies.
+     *
+     *  \return                 True if the search should stop.
+     */
+    bool countNode(int ply);
+
+    /**
+     *  Count a hash table probe, and trace the counts now and then. Only
+     *  called while tracing.
+     *
+     *  \param hit              Whether the probe found the position.
+     */
+    void countProbe(bool hit);
+
+    /**
+     *  Evaluate a position with the network if one is loaded, and with the
+     *  core otherwise.
+     *
+     *  \param pos              The position.
+     *  \param ply              The distance from the root in plies.
+     *
+     *  \return                 The score from the point of view of the side
+     *                          to move.
+     */
+    chessCore::value_t evaluate(chessCore::Board& pos, int ply);
+
+    /**
+     *  Update the pieces of the next ply for a move, and its accumulator if
+     *  the network is in use.
+     *
+     *  \param move             The move played at \p ply.
+     *  \param ply              The distance from the root in plies.
+     */
+    void pushMove(chessCore::move_t move, int ply);
+
+    /**
+     *  The negamax alpha-beta search. Moves after the first are searched
+     *  with a null window and searched again if they beat alpha. Late quiet
+     *  moves are searched to a reduced depth first; near the leaves, nodes
+     *  whose static evaluation is far above beta are cut, and quiet moves
+     *  that can't bring a position far below alpha back up are skipped.
+     *
+     *  \param pos              The position to search.
+     *  \param alpha            The lower bound.
+     *  \param beta             The upper bound.
+     *  \param depth            The remaining depth in plies.
+     *  \param ply              The distance from the root in plies.
+     *
+     *  \return                 The score of the position.
+     */
+    chessCore::value_t alphaBeta(chessCore::Board& pos,
+                                 chessCore::value_t alpha,
+                                 chessCore::value_t beta,
+                                 int depth, int ply);
+
+    /**
+     *  Search the root in a window around the score of the last iteration,
+     *  widening the side that fails until the score falls inside.
+     *
+     *  \param root             The root position.
+     *  \param depth            The depth of the iteration.
+     *  \param window           Half the width of the first window.
+     *
+     *  \return                 The score of the root.
+     */
+    chessCore::value_t aspirationSearch(chessCore::Board& root, int depth,
+                                        int window);
+
+    /**
+     *  Search captures only until the position is quiet.
+     *
+     *  \param pos              The position to search.
+     *  \param alpha            The lower bound.
+     *  \param beta             The upper bound.
+     *  \param ply              The distance from the root in plies.
+     *
+     *  \return                 The score of the position.
+     */
+    chessCore::value_t quiesce(chessCore::Board& pos,
+                               chessCore::value_t alpha,
+                               chessCore::value_t beta, int ply);
+
+ public:
+    /**
+     *  Constructor for SearchWorker.
+     *
+     *  \param engine           The engine the worker belongs to.
+     *  \param id               The index of the worker.
+     *  \param numa_node        The NUMA node the worker runs on.
+     */
+    SearchWorker(Engine& engine, int id, int numa_node);
+
+    /** Search the root position by iterative deepening until stopped. */
+    void search();
+};
+
+/**
+ *  The in-process engine API. This owns the board and the search threads, and
+ *  can be driven directly without going through the UCI text protocol.
+ *  \ref chessInterface is a thin adapter over this class.
+ */
+class Engine {
+    friend class SearchWorker;
+
+ public:
+    /** Callback for the result of each search iteration. */
+    typedef std::function<void(const SearchInfo&)> InfoCallback;
+    /** Callback for the best move (and the move to ponder on, if any). */
+    typedef std::function<void(chessCore::move_t, chessCore::move_t)>
+            BestMoveCallback;
+
+ private:
+    /** The board we're searching. */
+    chessCore::Board board;
+    /** The keys of the positions of the game up to \ref board. */
+    KeyHistory game_history;
+    /** The pieces of \ref board, for the network. */
+    nnue::Pieces pieces;
+    /**
+     *  The memory of the tables and the threads, declared before them so
+     *  that it outlives their charges.
+     */
+    MemoryBudget memory;
+    /** The charge of the workers against \ref memory. */
+    MemoryCharge search_memory;
+    /** The charge of \ref network against \ref memory. */
+    MemoryCharge network_memory;
+    /** The network named by the "EvalFile" option, if any. */
+    nnue::Network network;
+    /** What happened when "EvalFile" last changed, reported by \ref go. */
+    std::string eval_message;
+    /** Bumped whenever the evaluation changes, to invalidate eval caches. */
+    uint32_t eval_generation;
+
+    /** The engine options. */
+    OptionRegistry options;
+    /** The thread applying heavy option changes, e.g. resizing the table. */
+    std::thread config_thread;
+    /** A mutex guarding \ref config_thread. */
+    std::mutex config_mutex;
+    /** The options snapshot the current search was started with. */
+    std::shared_ptr<const OptionValues> search_options;
+
+    /** The NUMA topology of the machine. */
+    NumaTopology topology;
+    /** How threads and memory are placed on NUMA nodes. */
+    NumaPolicy numa_policy;
+    /** The size asked of the transposition table in megabytes. */
+    size_t hash_size;
+    /**
+     *  The size the table was allocated at in megabytes: \ref hash_size
+     *  unless that much memory couldn't be had.
+     */
+    size_t hash_granted;
+    /** The size of the mate solver's table in megabytes. */
+    size_t mate_hash_size;
+    /** The size of each worker's evaluation cache in megabytes. */
+    size_t eval_cache_size;
+    /** What the memory budget last shrank, reported by \ref go. */
+    std::string memory_message;
+    /** The transposition table shared by all workers. */
+    TranspositionTable tt;
+    /** The solver for "go mate", with a table of its own. */
+    MateSolver mate_solver;
+    /** The search workers, one per thread. */
+    std::vector<std::unique_ptr<SearchWorker>> workers;
+
+    /** The thread the main worker runs on. */
+    std::thread search_thread;
+    /** A mutex guarding \ref search_thread. */
+    std::mutex thread_mutex;
+    /** Set to stop the search as soon as possible. */
+    std::atomic<bool> stop_flag;
+    /** Set while the search is pondering, i.e. has no time limit. */
+    std::atomic<bool> pondering;
+    /** Set while a search is running. */
+    std::atomic<bool> running;
+
+    /** The root of the last search. */
+    chessCore::Board last_root;
+    /** The principal variation of the last search. */
+    std::vector<chessCore::move_t> last_pv;
+    /** The moves to search at the root, which the workers copy. */
+    RootMoves root_moves;
+    /** The rest of \ref last_pv from the current root, to try first. */
+    std::vector<chessCore::move_t> predicted_moves;
+    /** The keys of the positions in which to try \ref predicted_moves. */
+    std::vector<uint64_t> predicted_keys;
+
+    /** Where the statistics of each iteration are written. */
+    StatsWriter stats_writer;
+    /** The number of searches started so far. */
+    uint64_t search_count;
+    /** The statistics of the iterations of the current search. */
+    std::vector<IterationStats> iterations;
+    /** The counters of the main worker when the last iteration ended. */
+    SearchStats last_stats;
+    /** Where the process metrics are written. */
+    MetricsWriter metrics_writer;
+    /** The nodes searched by all searches before the current one. */
+    uint64_t total_nodes;
+    /** The number of threads the current search runs on. */
+    int search_threads;
+    /** Measures the CPU load of the current search. */
+    CpuMeter cpu_meter;
+    /** The time of the next status update, in milliseconds. */
+    uint32_t next_status;
+    /** The time the current lines are sampled next, in milliseconds. */
+    uint32_t next_currline;
+
+    /** The limits of the current search. */
+    SearchLimits limits;
+    /** The time at which the current search started. */
+    std::chrono::steady_clock::time_point start_time;
+    /** The time allotted to the current search in milliseconds, 0 if none. */
+    uint32_t time_budget;
+    /** The best move of the last iteration of the main worker. */
+    chessCore::move_t last_best;
+    /** The number of iterations in a row that \ref last_best stayed best. */
+    int best_move_stability;
+    /**
+     *  The time by which the best move must be sent, in milliseconds from
+     *  the start of the search (or from the ponder hit), 0 if none.
+     */
+    uint32_t hard_deadline;
+    /** Called after each completed iteration of the main worker. */
+    InfoCallback on_info;
+    /** Called with the best move, once per search. */
+    BestMoveCallback on_best_move;
+    /** Set once the best move of the current search has been sent. */
+    std::atomic<bool> best_move_sent;
+    /** A mutex guarding \ref fallback_move and \ref fallback_ponder. */
+    std::mutex fallback_mutex;
+    /** The move the watchdog sends if the search can't. */
+    chessCore::move_t fallback_move;
+    /** The move to ponder on that goes with \ref fallback_move. */
+    chessCore::move_t fallback_ponder;
+
+    /**
+     *  Forces a best move out if the search misses its deadline. Declared
+     *  last, so that it is destroyed before anything its callback uses.
+     */
+    Watchdog watchdog;
+
+    /**
+     *  Set up a game from a position, without any moves played.
+     *
+     *  \param fen              The position in FEN format, or "startpos".
+     */
+    void startGame(std::string fen);
+
+    /**
+     *  Play a move on \ref board and record it in \ref game_history.
+     *
+     *  \param move             The move to play.
+     */
+    void playMove(chessCore::move_t move);
+
+    /**
+     *  Bring the tables, the workers and the NUMA placement in line with the
+     *  latest options snapshot. Runs on \ref config_thread.
+     */
+    void applyOptions();
+
+    /**
+     *  Size the tables from the options, shrunk to fit in the
+     *  "MemoryBudget" option along with the workers and the network:
+     *  \ref hash_size, \ref mate_hash_size and \ref eval_cache_size. Sets
+     *  \ref memory_message if they had to be shrunk. The tables themselves
+     *  are resized by their owners.
+     *
+     *  \param values           The options to plan for.
+     */
+    void planMemory(const OptionValues& values);
+
+    /**
+     *  Reallocate the table at \ref hash_size, halving it while the memory
+     *  can't be had, and add to \ref memory_message if it is smaller.
+     *
+     *  \param reallocate       Whether to reallocate, or only report the
+     *                          size of the table as it is.
+     */
+    void resizeHash(bool reallocate);
+
+    /**
+     *  Fill \ref predicted_moves if the current position lies on the last
+     *  principal variation, e.g. when the opponent played the expected reply.
+     */
+    void predictLine();
+
+    /** Compute \ref time_budget and \ref hard_deadline from \ref limits. */
+    void allotTime();
+
+    /**
+     *  Set the fallback move before the search has a result: the first root
+     *  move, i.e. the hash move of the root if it is legal and allowed.
+     */
+    void initFallback();
+
+    /**
+     *  Arm the watchdog for \ref hard_deadline, if there is one.
+     *
+     *  \param from             The time the deadline counts from.
+     */
+    void armWatchdog(std::chrono::steady_clock::time_point from);
+
+    /**
+     *  Called by the watchdog at the hard deadline: stop the search, give it
+     *  a moment to send its own move, then send the fallback move, and
+     *  report the overrun.
+     */
+    void deadlineExpired();
+
+    /**
+     *  Check whether the search should stop because of time or node limits.
+     *
+     *  \return                 True if the search should stop.
+     */
+    bool limitReached();
+
+    /**
+     *  Get the time since the search started.
+     *
+     *  \return                 The elapsed time in milliseconds.
+     */
+    uint32_t elapsed() const;
+
+    /**
+     *  Report an iteration of the main worker and decide whether to go on.
+     *  With a time budget, the next iteration is only started if little of
+     *  it is gone: less the longer the best move has stayed best and the
+     *  more of the nodes it took, more when it has just changed.
+     *
+     *  \param main             The main worker.
+     *
+     *  \return                 True if the next iteration should be started.
+     */
+    bool iterationDone(const SearchWorker& main);
+
+    /**
+     *  Once a second at most, send a status line with the speed, the hash
+     *  table use, the CPU load and the current root move, and write the
+     *  metrics file. A few times a second, send the line each thread is
+     *  searching if "UCI_ShowCurrLine" is set. Called by the main worker as
+     *  it counts nodes.
+     */
+    void reportStatus();
+
+    /**
+     *  Send the refutation of each root move but the best: the move, then
+     *  the hash moves that follow it. Called at the end of an iteration if
+     *  "UCI_ShowRefutations" is set.
+     *
+     *  \param main             The main worker.
+     */
+    void reportRefutations(const SearchWorker& main);
+
+    /**
+     *  Write the metrics file, if there is one.
+     *
+     *  \param nodes            The nodes searched by the current search.
+     *  \param searching        Whether the search is still running.
+     */
+    void writeMetrics(uint64_t nodes, bool searching);
+
+    /**
+     *  Report the search speed of each NUMA node.
+     */
+    void reportNumaNodes();
+
+    /** Report a summary of \ref iterations. */
+    void reportStats();
+
+    /**
+     *  Create the workers and place them on NUMA nodes.
+     *
+     *  \param num_threads      The number of workers.
+     */
+    void createWorkers(int num_threads);
+
+    /**
+     *  The body of the search thread: run the main worker, and the helpers
+     *  on threads of their own, then send the best move unless the watchdog
+     *  already has.
+     */
+    void searchLoop();
+
+    /** In infinite and ponder mode, wait for the GUI to end the search. */
+    void waitForStop();
+
+    /**
+     *  Send the best move of a line, or the fallback move if the line is
+     *  empty, unless the watchdog already has. Disarms the watchdog.
+     *
+     *  \param pv               The principal variation.
+     */
+    void sendBestMove(const std::vector<chessCore::move_t>& pv);
+
+    /**
+     *  The body of the search thread for "go mate": run the mate solver,
+     *  report what it proved, and send its first move (or the fallback).
+     */
+    void solveMate();
+
+ public:
+    Engine();
+    ~Engine();
+
+    /**
+     *  Forget the previous game. The hash table is only marked stale, not
+     *  cleared; use the "Clear Hash" option for that.
+     */
+    void newGame();
+
+    /**
+     *  Set the position to search.
+     *
+     *  \param fen              The position in FEN format, or "startpos".
+     *  \param moves            Moves to play from that position.
+     *  \param num_moves        The number of moves in \p moves.
+     */
+    void setPosition(std::string fen, const chessCore::move_t* moves,
+                     size_t num_moves);
+
+    /**
+     *  Set the position to search. If a move is illegal, the position is
+     *  left as it was before that move.
+     *
+     *  \param fen              The position in FEN format, or "startpos".
+     *  \param moves            Moves to play from that position, in long
+     *                          algebraic notation.
+     *
+     *  \return                 True if all the moves were legal.
+     */
+    bool setPosition(std::string fen, const std::vector<std::string>& moves);
+
+    /**
+     *  Play a move on the current position, e.g. to walk through a game
+     *  without replaying it from the start.
+     *
+     *  \param move             The move to play. It must be legal.
+     */
+    void makeMove(chessCore::move_t move);
+
+    /**
+     *  Get the current position.
+     *
+     *  \return                 The board that will be searched.
+     */
+    const chessCore::Board& getBoard() const;
+
+    /**
+     *  Set the size of the transposition table. This clears the table.
+     *
+     *  \param megabytes        The size in megabytes.
+     */
+    void setHashSize(size_t megabytes);
+
+    /**
+     *  Set the number of search threads.
+     *
+     *  \param num_threads      The number of threads, at least 1.
+     */
+    void setThreads(int num_threads);
+
+    /**
+     *  Set how threads and memory are placed on NUMA nodes. This reallocates
+     *  the transposition table.
+     *
+     *  \param policy           The policy.
+     */
+    void setNumaPolicy(NumaPolicy policy);
+
+    /**
+     *  Set an option by name, as in the UCI "setoption" command. Options that
+     *  need reallocation (Hash, Threads, NumaPolicy) are applied on a
+     *  background thread; \ref waitForOptions blocks until that is done.
+     *
+     *  \param name             The name of the option, in any case.
+     *  \param value            The new value, as a string.
+     *
+     *  \return                 True if the option exists and the value is
+     *                          valid.
+     */
+    bool setOption(const std::string& name, const std::string& value);
+
+    /** Block until all option changes have been applied. */
+    void waitForOptions();
+
+    /**
+     *  Get the engine options.
+     *
+     *  \return                 The option registry.
+     */
+    const OptionRegistry& getOptions() const;
+
+    /**
+     *  Get the NUMA topology detected at startup.
+     *
+     *  \return                 The topology.
+     */
+    const NumaTopology& getTopology() const;
+
+    /**
+     *  Get the memory budget and what each component uses.
+     *
+     *  \return                 The budget.
+     */
+    const MemoryBudget& getMemoryBudget() const;
+
+    /**
+     *  Start searching the current position on a background thread.
+     *
+     *  \param searchLimits     The limits of the search.
+     *  \param onInfo           Called after each completed iteration.
+     *  \param onBestMove       Called once when the search finishes.
+     */
+    void go(const SearchLimits& searchLimits, InfoCallback onInfo,
+            BestMoveCallback onBestMove);
+
+    /** Stop the search as soon as possible. */
+    void stop();
+
+    /** Switch a pondering search to a normal timed search. */
+    void ponderhit();
+
+    /** Block until the current search (if any) has finished. */
+    void wait();
+
+    /**
+     *  Get the number of nodes searched by all workers in the current or last
+     *  search.
+     *
+     *  \return                 The number of nodes.
+     */
+    uint64_t totalNodes() const;
+
+    /**
+     *  Check whether a search is running.
+     *
+     *  \return                 True if a search is running.
+     */
+    bool isSearching() const;
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_ENGINE_H_
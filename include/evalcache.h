@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_EVALCACHE_H_
+#define SRC_UCI_EVALCACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "membudget.h"
+#include "typedefs.h"
+
+
+namespace chessUCI {
+
+/**
+ *  A cache of static evaluations keyed by the position's hash key, owned by
+ *  one search thread. Positions reached again through transpositions, and
+ *  the static evaluation a node shares with its quiescence search, are then
+ *  evaluated once. A position always evaluates to the same score, so
+ *  unless two keys collide the cache changes the speed of a search but not
+ *  its result. Like the transposition table, it only compares the upper 32
+ *  bits of keys.
+ */
+class EvalCache {
+ private:
+    /** An entry of the cache. */
+    struct Entry {
+        /** The upper 32 bits of the position's hash key. */
+        uint32_t key;
+        /** The evaluation of the position. */
+        chessCore::value_t value;
+    };
+
+    /** The entries, a power of two of them, or none if the cache is off. */
+    std::vector<Entry> entries;
+    /** The size the cache was last given, in megabytes. */
+    size_t megabytes;
+    /** The charge of \ref entries against the memory budget. */
+    MemoryCharge charge;
+
+ public:
+    /** Constructor for EvalCache, with the cache off. */
+    EvalCache();
+
+    EvalCache(const EvalCache&) = delete;
+    EvalCache& operator=(const EvalCache&) = delete;
+
+    /**
+     *  Charge the memory of the cache to a budget.
+     *
+     *  \param budget           The budget, or null for none.
+     */
+    void track(MemoryBudget* budget) {
+        charge.attach(budget);
+    }
+
+    /**
+     *  Reallocate and clear the cache, unless it already has the size.
+     *
+     *  \param new_megabytes    The size in megabytes, 0 to turn it off.
+     */
+    void resize(size_t new_megabytes);
+
+    /** Forget all evaluations. */
+    void clear();
+
+    /**
+     *  Check whether the cache is on.
+     *
+     *  \return                 True if the cache has entries.
+     */
+    bool enabled() const {
+        return !entries.empty();
+    }
+
+    /**
+     *  Look up a position.
+     *
+     *  \param key              The hash key of the position.
+     *  \param value            Set to the evaluation if the position is
+     *                          found.
+     *
+     *  \return                 True if the position was found.
+     */
+    bool probe(uint64_t key, chessCore::value_t* value) const {
+        const Entry& entry = entries[key & (entries.size() - 1)];
+        if (entry.key != static_cast<uint32_t>(key >> 32)) return false;
+        *value = entry.value;
+        return true;
+    }
+
+    /**
+     *  Store the evaluation of a position, replacing what was in its slot.
+     *
+     *  \param key              The hash key of the position.
+     *  \param value            The evaluation.
+     */
+    void store(uint64_t key, chessCore::value_t value) {
+        Entry& entry = entries[key & (entries.size() - 1)];
+        entry.key = static_cast<uint32_t>(key >> 32);
+        entry.value = value;
+    }
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_EVALCACHE_H_
@@ -0,0 +1,149 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_HISTORY_H_
+#define SRC_UCI_HISTORY_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+
+namespace chessUCI {
+
+/**
+ *  The hash keys of every position of the game and of the current search
+ *  line, stored contiguously, for detecting draws by repetition and by the
+ *  fifty-move rule.
+ *
+ *  A position can only repeat one reached an even number of plies earlier,
+ *  and not before the last irreversible move (capture or pawn move), so
+ *  repetition checks only scan that window in steps of two. A small counting
+ *  filter indexed by the low bits of the keys rules out almost every
+ *  position before any scan at all.
+ */
+class KeyHistory {
+ public:
+    /** The number of slots in the filter, a power of two. */
+    static const int FILTER_SIZE = 1024;
+
+ private:
+    /** The hash keys of the positions, oldest first. */
+    std::vector<uint64_t> keys;
+    /** The number of plies since the last irreversible move. */
+    std::vector<uint16_t> rule50;
+    /** The number of positions in the history. */
+    size_t count;
+    /** How many of the positions fall in each slot of the filter. */
+    uint16_t filter[FILTER_SIZE];
+
+ public:
+    KeyHistory();
+
+    /**
+     *  Reset the history to a copy of another one, e.g. the game history, and
+     *  make room for a search line on top of it.
+     *
+     *  \param other            The history to copy.
+     *  \param extra            The number of positions that may be pushed.
+     */
+    void reset(const KeyHistory& other, size_t extra);
+
+    /** Forget all the positions. */
+    void clear();
+
+    /**
+     *  Add a position.
+     *
+     *  \param key              The hash key of the position.
+     *  \param halfmove_clock   The number of plies since the last irreversible
+     *                          move.
+     */
+    void push(uint64_t key, unsigned halfmove_clock) {
+        if (count == keys.size()) {
+            keys.resize(count * 2 + 16);
+            rule50.resize(count * 2 + 16);
+        }
+        keys[count] = key;
+        rule50[count] = halfmove_clock;
+        count++;
+        filter[key & (FILTER_SIZE - 1)]++;
+    }
+
+    /** Remove the latest position. */
+    void pop() {
+        count--;
+        filter[keys[count] & (FILTER_SIZE - 1)]--;
+    }
+
+    /**
+     *  Get the key of the latest position.
+     *
+     *  \return                 The hash key.
+     */
+    uint64_t top() const {
+        return keys[count - 1];
+    }
+
+    /**
+     *  Get the number of positions.
+     *
+     *  \return                 The number of positions.
+     */
+    size_t size() const {
+        return count;
+    }
+
+    /**
+     *  Check whether the latest position occurred before.
+     *
+     *  \return                 True if the position is a repetition.
+     */
+    bool isRepetition() const {
+        uint64_t key = keys[count - 1];
+        if (filter[key & (FILTER_SIZE - 1)] < 2) return false;
+
+        size_t window = std::min<size_t>(rule50[count - 1], count - 1);
+        for (size_t back = 2; back <= window; back += 2) {
+            if (keys[count - 1 - back] == key) return true;
+        }
+        return false;
+    }
+
+    /**
+     *  Count how often the latest position occurred before. Unlike
+     *  \ref isRepetition, which the search uses, this is for deciding games,
+     *  which are only drawn by the third occurrence.
+     *
+     *  \return                 The number of earlier occurrences.
+     */
+    int repetitions() const {
+        uint64_t key = keys[count - 1];
+        if (filter[key & (FILTER_SIZE - 1)] < 2) return 0;
+
+        int found = 0;
+        size_t window = std::min<size_t>(rule50[count - 1], count - 1);
+        for (size_t back = 2; back <= window; back += 2) {
+            if (keys[count - 1 - back] == key) found++;
+        }
+        return found;
+    }
+
+    /**
+     *  Check whether the latest position is drawn by the fifty-move rule.
+     *
+     *  \return                 True if fifty moves passed without a capture or
+     *                          a pawn move.
+     */
+    bool isFiftyMoveDraw() const {
+        return rule50[count - 1] >= 100;
+    }
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_HISTORY_H_
@@ -0,0 +1,67 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_LAN_H_
+#define SRC_UCI_LAN_H_
+
+#include <cstddef>
+#include <string>
+
+#include "board.h"
+#include "move.h"
+
+
+namespace chessUCI {
+
+/** The length of the longest move in long algebraic notation, "e7e8q". */
+const int LAN_LENGTH = 5;
+
+/** A buffer big enough for any move in long algebraic notation. */
+typedef char lan_buffer[LAN_LENGTH + 1];
+
+/**
+ *  Write a move in long algebraic notation (as used by UCI), without
+ *  allocating. The null move is written as "0000".
+ *
+ *  \param move             The move to write.
+ *  \param buf              The buffer to write to, NUL-terminated.
+ *
+ *  \return                 The number of characters written, excluding NUL.
+ */
+int format_lan(chessCore::move_t move, char* buf);
+
+/**
+ *  Parse a move in long algebraic notation, e.g. "e2e4" or "e7e8q", and check
+ *  that it is legal in a position.
+ *
+ *  \param board            The position the move is played in.
+ *  \param str              The move.
+ *  \param length           The length of \p str.
+ *  \param move             Set to the move if it is legal.
+ *
+ *  \return                 True if the move is well-formed and legal.
+ */
+bool parse_lan(chessCore::Board& board, const char* str, size_t length,
+               chessCore::move_t* move);
+
+/**
+ *  Parse a move in long algebraic notation and check that it is legal.
+ *
+ *  \param board            The position the move is played in.
+ *  \param str              The move.
+ *  \param move             Set to the move if it is legal.
+ *
+ *  \return                 True if the move is well-formed and legal.
+ */
+inline bool parse_lan(chessCore::Board& board, const std::string& str,
+                      chessCore::move_t* move) {
+    return parse_lan(board, str.data(), str.size(), move);
+}
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_LAN_H_
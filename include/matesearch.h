@@ -0,0 +1,214 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_MATESEARCH_H_
+#define SRC_UCI_MATESEARCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "board.h"
+#include "membudget.h"
+#include "move.h"
+
+
+namespace chessUCI {
+
+/** The outcome of a mate search. */
+struct MateResult {
+    /** An enum representing what the search proved. */
+    enum Outcome {
+        /** The side to move mates within the limit. */
+        mate_found,
+        /** The side to move has no mate within the limit. */
+        no_mate,
+        /** The search was stopped before deciding. */
+        unknown
+    };
+
+    /** What the search proved. */
+    Outcome outcome;
+    /** The length of the mate in moves, if one was found. */
+    int mate_in;
+    /** The moves of the mate, if one was found. */
+    std::vector<chessCore::move_t> pv;
+    /**
+     *  The longest mate ruled out, in moves: the limit if no mate was found,
+     *  less if the search was stopped.
+     */
+    int no_mate_in;
+    /** The number of positions expanded. */
+    uint64_t nodes;
+
+    MateResult();
+};
+
+/**
+ *  Solves "mate in N" problems by depth-first proof-number search (df-pn).
+ *  Positions where the attacker is to move are OR nodes, proven if any move
+ *  mates; positions where the defender is to move are AND nodes, proven if
+ *  every reply is mated. The search always expands the most proving node,
+ *  the one that needs the fewest positions to be resolved, so forcing lines
+ *  (checks, which leave the defender few replies) are explored first
+ *  without any chess knowledge. All attacking moves are tried, so a failed
+ *  search proves there is no mate.
+ *
+ *  The proof and disproof numbers are kept in a table of the solver's own,
+ *  keyed by position and remaining depth, which persists between searches.
+ *  Repetitions count as disproven.
+ */
+class MateSolver {
+ public:
+    /**
+     *  Called every few thousand positions with the number searched so far.
+     *  Returns true to stop the search.
+     */
+    typedef std::function<bool(uint64_t)> StopCallback;
+
+ private:
+    /** An entry of the table. */
+    struct Entry {
+        /** The hash key of the position. */
+        uint64_t key;
+        /** The proof number. */
+        uint32_t pn;
+        /** The disproof number. */
+        uint32_t dn;
+        /** The number of positions expanded to get these numbers. */
+        uint32_t work;
+        /** The length of the mate in plies, once proven. */
+        uint16_t plies;
+        /** The plies left to mate in. */
+        uint8_t depth;
+        /** The search that stored the entry. */
+        uint8_t generation;
+    };
+
+    /** The number of entries a position can go in. */
+    static const int BUCKET_SIZE = 4;
+
+    /** The entries, a power of two of them. */
+    std::vector<Entry> table;
+    /** The size the table was last given, in megabytes. */
+    size_t megabytes;
+    /** The charge of \ref table against the memory budget. */
+    MemoryCharge charge;
+    /** The number of the current search, wrapping around. */
+    uint8_t generation;
+
+    /** The positions expanded in the current search. */
+    uint64_t nodes;
+    /** Asked whether to stop the current search. */
+    StopCallback should_stop;
+    /** Set once the current search should stop. */
+    bool stopped;
+    /** The keys of the positions on the current line. */
+    std::vector<uint64_t> path;
+
+    /**
+     *  Get the bucket of a position.
+     *
+     *  \param key              The hash key of the position.
+     *  \param depth            The plies left.
+     *
+     *  \return                 The first of \ref BUCKET_SIZE entries.
+     */
+    Entry* bucket(uint64_t key, int depth);
+
+    /**
+     *  Store a result, over the same position if it is in its bucket, and
+     *  otherwise over an entry of an earlier search or the entry that took
+     *  the least work. Keeping expensive results stops the search from
+     *  going round in circles re-proving positions that keep pushing each
+     *  other out.
+     *
+     *  \param entry            The result.
+     */
+    void store(const Entry& entry);
+
+    /**
+     *  Look up the proof and disproof numbers of a position.
+     *
+     *  \param key              The hash key of the position.
+     *  \param depth            The plies left.
+     *  \param pn               Set to the proof number.
+     *  \param dn               Set to the disproof number.
+     *  \param plies            Set to the length of the mate if proven.
+     */
+    void lookup(uint64_t key, int depth, uint32_t* pn, uint32_t* dn,
+                int* plies);
+
+    /**
+     *  Search a position until its proof number reaches \p thpn or its
+     *  disproof number reaches \p thdn, and store the result.
+     *
+     *  \param pos              The position.
+     *  \param depth            The plies left.
+     *  \param attacker         Whether the attacker is to move.
+     *  \param thpn             The proof number threshold.
+     *  \param thdn             The disproof number threshold.
+     */
+    void mid(chessCore::Board& pos, int depth, bool attacker,
+             uint32_t thpn, uint32_t thdn);
+
+    /**
+     *  Follow a proven position's shortest mate through the table.
+     *
+     *  \param root             The proven position, attacker to move.
+     *  \param depth            The plies left.
+     *
+     *  \return                 The moves of the mate.
+     */
+    std::vector<chessCore::move_t> provenLine(const chessCore::Board& root,
+                                              int depth);
+
+ public:
+    /** Constructor for MateSolver, without a table yet. */
+    MateSolver();
+
+    MateSolver(const MateSolver&) = delete;
+    MateSolver& operator=(const MateSolver&) = delete;
+
+    /**
+     *  Charge the memory of the table to a budget.
+     *
+     *  \param budget           The budget, or null for none.
+     */
+    void track(MemoryBudget* budget) {
+        charge.attach(budget);
+    }
+
+    /**
+     *  Reallocate and clear the table, unless it already has the size.
+     *
+     *  \param new_megabytes    The size in megabytes, at least 1.
+     */
+    void resize(size_t new_megabytes);
+
+    /** Forget all positions. */
+    void clear();
+
+    /**
+     *  Look for a mate in at most some number of moves for the side to
+     *  move. Mates in 1, 2, ... moves are looked for in turn, so the mate
+     *  found is the shortest one.
+     *
+     *  \param root             The position.
+     *  \param max_moves        The longest mate to look for, in moves.
+     *  \param stop             Asked now and then whether to stop.
+     *
+     *  \return                 What the search proved.
+     */
+    MateResult solve(const chessCore::Board& root, int max_moves,
+                     StopCallback stop);
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_MATESEARCH_H_
@@ -0,0 +1,191 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_MEMBUDGET_H_
+#define SRC_UCI_MEMBUDGET_H_
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+
+namespace chessUCI {
+
+/** An enum representing the owners of large allocations. */
+enum MemoryComponent {
+    /** The transposition table. */
+    mem_hash,
+    /** The table of the mate solver. */
+    mem_mate_hash,
+    /** The evaluation caches of the search threads. */
+    mem_eval_cache,
+    /** The search threads' own state: stacks of boards and accumulators. */
+    mem_search,
+    /** The NNUE network. */
+    mem_network,
+    num_memory_components
+};
+
+/**
+ *  Get the name of a component, as used in reports.
+ *
+ *  \param component        The component.
+ *
+ *  \return                 The name.
+ */
+const char* memory_component_name(MemoryComponent component);
+
+/** A table whose size is fitted into a \ref MemoryBudget. */
+struct MemoryRequest {
+    /** The component the table belongs to. */
+    MemoryComponent component;
+    /** The size asked for in megabytes, set to the size granted. */
+    size_t megabytes;
+    /** The smallest size the table works with, in megabytes. */
+    size_t min_megabytes;
+    /** The number of copies of the table, e.g. one per thread. */
+    size_t copies;
+};
+
+/**
+ *  The memory an engine may use, and what each component of it uses. The
+ *  budget doesn't allocate anything itself: tables are sized with \ref fit
+ *  before they are allocated, and then charge what they really allocated
+ *  through a \ref MemoryCharge. The counters are atomic, as search threads
+ *  allocate their caches when they start.
+ */
+class MemoryBudget {
+ private:
+    /** The budget in bytes, 0 for none. */
+    size_t limit;
+    /** The bytes charged by each component. */
+    std::atomic<size_t> used[num_memory_components];
+
+ public:
+    /** Constructor for MemoryBudget, without a limit. */
+    MemoryBudget();
+
+    /**
+     *  Set the budget. Tables already allocated are not resized.
+     *
+     *  \param megabytes        The budget in megabytes, 0 for none.
+     */
+    void setLimit(size_t megabytes);
+
+    /**
+     *  Get the budget.
+     *
+     *  \return                 The budget in bytes, 0 for none.
+     */
+    size_t getLimit() const {
+        return limit;
+    }
+
+    /**
+     *  Change what a component is charged.
+     *
+     *  \param component        The component.
+     *  \param old_bytes        The bytes it was charged for the allocation.
+     *  \param new_bytes        The bytes to charge it now.
+     */
+    void charge(MemoryComponent component, size_t old_bytes,
+                size_t new_bytes);
+
+    /**
+     *  Get what a component is charged.
+     *
+     *  \param component        The component.
+     *
+     *  \return                 The bytes charged.
+     */
+    size_t getUsed(MemoryComponent component) const;
+
+    /**
+     *  Get what all components are charged.
+     *
+     *  \return                 The bytes charged.
+     */
+    size_t totalUsed() const;
+
+    /**
+     *  Shrink tables so that they fit in the budget along with a fixed cost,
+     *  by halving the one that takes the most memory until they all fit or
+     *  are at their smallest. Halving the largest keeps the sizes in
+     *  proportion, so no one table is starved.
+     *
+     *  \param fixed_bytes      The memory the tables must leave room for.
+     *  \param requests         The tables, whose sizes are shrunk.
+     *  \param num_requests     The number of tables in \p requests.
+     *
+     *  \return                 True if nothing had to be shrunk.
+     */
+    bool fit(size_t fixed_bytes, MemoryRequest* requests,
+             int num_requests) const;
+
+    /**
+     *  Describe what each component uses, e.g. "memory 21.4 of 64 MB: hash
+     *  16.0 MB, ...".
+     *
+     *  \return                 The description.
+     */
+    std::string report() const;
+};
+
+/**
+ *  The charge of one allocation against a \ref MemoryBudget, which the
+ *  owner of the allocation updates when it resizes it. Released when
+ *  destroyed, so the budget must outlive it. Until it is attached to a
+ *  budget, the charge is only remembered.
+ */
+class MemoryCharge {
+ private:
+    /** The budget charged, or null. */
+    MemoryBudget* budget;
+    /** The component charged. */
+    MemoryComponent component;
+    /** The bytes charged. */
+    size_t bytes;
+
+ public:
+    /**
+     *  Constructor for MemoryCharge, of nothing.
+     *
+     *  \param component        The component to charge.
+     */
+    explicit MemoryCharge(MemoryComponent component);
+    ~MemoryCharge();
+
+    MemoryCharge(const MemoryCharge&) = delete;
+    MemoryCharge& operator=(const MemoryCharge&) = delete;
+
+    /**
+     *  Move the charge to a budget.
+     *
+     *  \param new_budget       The budget, or null for none.
+     */
+    void attach(MemoryBudget* new_budget);
+
+    /**
+     *  Change the charge, e.g. after a reallocation.
+     *
+     *  \param new_bytes        The bytes allocated now.
+     */
+    void set(size_t new_bytes);
+
+    /**
+     *  Get the charge.
+     *
+     *  \return                 The bytes charged.
+     */
+    size_t get() const {
+        return bytes;
+    }
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_MEMBUDGET_H_
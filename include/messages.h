@@ -0,0 +1,201 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_MESSAGES_H_
+#define SRC_UCI_MESSAGES_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+namespace chessUCI {
+
+/** A sub-namespace with some enums and structs for parsing convenience. */
+namespace MessageTypes {
+/**
+ *  An enum representing the different types of message that the engine can
+ *  receive from the GUI.
+ */
+enum GUIMessage {
+    uci_message,
+    debug_message,
+    isready_message,
+    setoption_message,
+    register_message,
+    ucinewgame_message,
+    position_message,
+    go_message,
+    stop_message,
+    ponderhit_message,
+    quit_message
+};
+
+/**
+ *  An enum representing the different types of message that the engine can
+ *  send the GUI.
+ */
+enum EngineMessage {
+    id_message,
+    uciok_message,
+    readyok_message,
+    bestmove_message,
+    copyprotection_message,
+    registration_message,
+    info_message,
+    option_message
+};
+
+/** An enum representing the copyprotect status options. */
+enum CopyProtectMessage {
+    checking_copyprotect,
+    ok_copyprotect,
+    error_copyprotect
+};
+
+/** An enum representing the registration status options. */
+enum RegistrationMessage {
+    checking_registration,
+    ok_registration,
+    error_registration
+};
+
+/** A struct representing an info message from the engine to the GUI. */
+struct InfoMessage {
+    /** Search depth in plies. */
+    uint8_t depth;
+    /** Selection search depth in plies. */
+    uint8_t seldepth;
+    /** Time spent searching in milliseconds. */
+    uint32_t time;
+    /** Number of nodes searched. */
+    uint64_t nodes;
+    /** Principal variation, i.e. the best line found. */
+    std::vector<std::string> pv;
+    /** Number of PVs. Only used in multi-pv mode. */
+    uint8_t multipv;
+    /** String representation of the score. */
+    std::string score;
+    /** Currently searching this move. */
+    std::string currmove;
+    /** Number of the move currently being searched. */
+    uint16_t currmovenumber;
+    /** How full the hash table is, out of 1000. */
+    uint16_t hashfull;
+    /** Number of nodes searched per second. */
+    uint64_t nps;
+    /** Number of hits in the endgame tablebases. */
+    uint16_t tbhits;
+    /** Number of hits in the shredder endgame tablebases. */
+    uint16_t sbhits;
+    /** Current CPU usage of the engine, out of 1000. */
+    uint16_t cpuload;
+    /**
+     *  The first move of refutation is refuted by the line formed by the rest
+     *  of refutation.
+     */
+    std::vector<std::string> refutation;
+    /** The current line being searched by each cpu. */
+    std::vector<std::vector<std::string>> currline;
+    /** A string to be displayed by the engine. */
+    std::string string;
+
+
+    InfoMessage();
+    /**
+     *  Print the info message to an output stream.
+     *
+     *  \param out              The output stream to print to.
+     *  \param infoMessage      The info message to print.
+     *
+     *  \return                 The output stream.
+     */
+    friend std::ostream& operator<<(std::ostream& out,
+                                    const InfoMessage& infoMessage);
+};
+
+/** An enum representing the possible types of an option. */
+enum OptionTypeValue {
+    check_type,
+    spin_type,
+    combo_type,
+    button_type,
+    string_type
+};
+
+/** A struct representing an option message from the engine to the GUI. */
+struct OptionMessage {
+    /** The name of the option. */
+    std::string name;
+    /** The type of the option. See \ref OptionTypeValue. */
+    OptionTypeValue type;
+    /** The default value for the option. */
+    std::string option_default;
+    /** The minimum value for the option, if relevant. */
+    std::string option_min;
+    /** The maximum value for the option, if relevant. */
+    std::string option_max;
+    /** The possible values of option, if relevant. */
+    std::vector<std::string> vars;
+
+    OptionMessage();
+
+    /**
+     *  Check if the option message is valid.
+     *
+     *  \return                 True if the message is valid, false otherwise.
+     */
+    bool valid() const;
+
+    /**
+     *  Print the option message to an output stream.
+     *
+     *  \param out              The output stream to print to.
+     *  \param optionMessage    The option message to print.
+     *
+     *  \return                 The output stream.
+     */
+    friend std::ostream& operator<<(std::ostream& out,
+                                    const OptionMessage& optionMessage);
+};
+
+/** A struct representing a go message from the GUI to the engine. */
+struct GoMessage {
+    /** Restrict search to these move only. */
+    std::vector<std::string> searchmoves;
+    /** Start searching in ponder mode. */
+    bool ponder;
+    /** Amount of time white has on the clock in milliseconds. */
+    uint32_t wtime;
+    /** Amount of time black has on the clock in milliseconds. */
+    uint32_t btime;
+    /** White increment per move in milliseconds. */
+    uint32_t winc;
+    /** Black increment per move in milliseconds. */
+    uint32_t binc;
+    /** Number of moves to the next time control. */
+    uint16_t movestogo;
+    /** Maximum search depth in plies.*/
+    uint8_t depth;
+    /** Maximum number of nodes to search. */
+    uint64_t nodes;
+    /** Search for mate in this many moves. */
+    uint8_t mate;
+    /** Maximum search time in milliseconds.. */
+    uint32_t movetime;
+    /** Search forever until a "stop" message from the GUI. */
+    bool infinite;
+
+    GoMessage();
+};
+
+}   // namespace MessageTypes
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_MESSAGES_H_
@@ -0,0 +1,118 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_METRICS_H_
+#define SRC_UCI_METRICS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+
+namespace chessUCI {
+
+/**
+ *  Get the CPU time used by the process so far, user and system.
+ *
+ *  \return                 The CPU time in seconds.
+ */
+double process_cpu_seconds();
+
+/**
+ *  Get the memory of the process resident in RAM.
+ *
+ *  \return                 The resident memory in bytes, or 0 if unknown.
+ */
+uint64_t resident_memory_bytes();
+
+/** Measures the CPU load of the process from a starting point. */
+class CpuMeter {
+ private:
+    /** The CPU time at the starting point, in seconds. */
+    double start_cpu;
+    /** The wall time at the starting point. */
+    std::chrono::steady_clock::time_point start_wall;
+
+ public:
+    /** Constructor for CpuMeter, starting now. */
+    CpuMeter();
+
+    /** Move the starting point to now. */
+    void start();
+
+    /**
+     *  Get the CPU load since the starting point.
+     *
+     *  \param num_threads      The number of threads the process should be
+     *                          keeping busy.
+     *
+     *  \return                 CPU time over wall time times \p num_threads,
+     *                          out of 1000.
+     */
+    int load(int num_threads) const;
+};
+
+/** The values exported in the metrics file. */
+struct Metrics {
+    /** The number of searches started. */
+    uint64_t searches;
+    /** The nodes searched by all searches. */
+    uint64_t nodes;
+    /** The speed of the current or last search in nodes per second. */
+    uint64_t nps;
+    /** How full the hash table is, out of 1000. */
+    int hashfull;
+    /** The CPU load of the current or last search, out of 1000. */
+    int cpuload;
+    /** The number of search threads. */
+    int threads;
+    /** Whether a search is running. */
+    bool searching;
+
+    Metrics();
+};
+
+/**
+ *  Writes \ref Metrics to a file in the Prometheus text exposition format,
+ *  e.g. for node_exporter's textfile collector. The file is written whole
+ *  to a temporary file and renamed over the old one, so readers never see
+ *  a partial file.
+ */
+class MetricsWriter {
+ private:
+    /** The file written to, "" if none. */
+    std::string path;
+
+ public:
+    /**
+     *  Set the file to write to, and check that it can be written.
+     *
+     *  \param new_path         The file, or "" to stop writing.
+     *
+     *  \return                 False if the file can't be written, in which
+     *                          case nothing is written.
+     */
+    bool open(const std::string& new_path);
+
+    /**
+     *  Get the file being written to.
+     *
+     *  \return                 The name of the file, "" if none.
+     */
+    const std::string& getPath() const;
+
+    /**
+     *  Replace the file with the current values.
+     *
+     *  \param metrics          The values.
+     */
+    void write(const Metrics& metrics);
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_METRICS_H_
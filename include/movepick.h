@@ -0,0 +1,190 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_MOVEPICK_H_
+#define SRC_UCI_MOVEPICK_H_
+
+#include <cstdint>
+
+#include "board.h"
+#include "constants.h"
+#include "move.h"
+#include "nnue.h"
+#include "rootmoves.h"
+
+
+namespace chessUCI {
+
+/**
+ *  The move ordering heuristics a search thread learns as it searches,
+ *  indexed by side to move and the from and to squares of moves.
+ */
+struct MoveHistory {
+    /** The largest absolute history score. */
+    static const int MAX_SCORE = 16384;
+
+    /** Quiet moves that caused cutoffs at each ply, most recent first. */
+    chessCore::move_t killers[MAX_PLY][2];
+    /** The quiet move that last refuted each move of the opponent. */
+    chessCore::move_t counter_moves[64][64];
+    /** How often quiet moves caused cutoffs, less how often they didn't. */
+    int16_t history[2][64][64];
+
+    MoveHistory();
+
+    /** Forget everything. */
+    void clear();
+
+    /**
+     *  Learn from a quiet move that caused a cutoff.
+     *
+     *  \param side             The side that played the move.
+     *  \param move             The move.
+     *  \param previous         The move before it, or a null move.
+     *  \param tried            The quiet moves tried before it.
+     *  \param num_tried        The number of moves in \p tried.
+     *  \param depth            The remaining depth.
+     *  \param ply              The distance from the root.
+     */
+    void update(int side, chessCore::move_t move, chessCore::move_t previous,
+                const chessCore::move_t* tried, int num_tried, int depth,
+                int ply);
+};
+
+/**
+ *  Hands out the legal moves of a position one at a time, in stages: the
+ *  hash move, captures and queen promotions by most valuable victim and
+ *  least valuable attacker, the killer moves, the counter move, and the
+ *  remaining quiet moves by history score. Each stage is only sorted when
+ *  the search gets to it, so a cutoff early on saves the ordering of the
+ *  rest. At the root, the moves are handed out in the order of the root
+ *  moves instead. All state lives in the picker, which belongs on the
+ *  stack.
+ */
+class MovePicker {
+ public:
+    /** An enum representing the stages of the picker. */
+    enum Stage {
+        stage_root,
+        stage_tt,
+        stage_init_noisy,
+        stage_noisy,
+        stage_killer_1,
+        stage_killer_2,
+        stage_counter,
+        stage_init_quiet,
+        stage_quiet,
+        stage_done
+    };
+
+ private:
+    /** The legal moves: noisy ones, then quiet ones. */
+    chessCore::move_t moves[MAX_MOVES];
+    /** The scores of the moves of the current stage. */
+    int scores[MAX_MOVES];
+    /** The number of legal moves. */
+    int num_moves;
+    /** The end of the noisy moves in \ref moves. */
+    int end_noisy;
+    /** The end of the quiet moves not handed out by an earlier stage. */
+    int end_quiet;
+    /** The start of the moves not handed out yet in the current stage. */
+    int current;
+    /** The end of the moves of the current stage. */
+    int end;
+    /** The stage of the next move. */
+    Stage next_stage;
+    /** Whether the last move handed out was quiet. */
+    bool last_quiet;
+    /** Whether quiet moves are skipped. */
+    bool noisy_only;
+
+    /** The pieces of the position, for ordering captures. */
+    const nnue::Pieces& pieces;
+    /** The heuristics to order quiet moves by. */
+    const MoveHistory& heuristics;
+    /** The side to move. */
+    int side;
+    /** The hash move, or a null move. */
+    chessCore::move_t tt_move;
+    /** The killer moves of the ply. */
+    chessCore::move_t killers[2];
+    /** The counter move to the previous move, or a null move. */
+    chessCore::move_t counter;
+
+    /**
+     *  Remove a quiet move from those left, if it's there.
+     *
+     *  \param move             The move.
+     *
+     *  \return                 True if the move was found and removed.
+     */
+    bool takeQuiet(chessCore::move_t move);
+
+    /** Hand out the best-scored move of the current stage, or a null move. */
+    chessCore::move_t pickBest();
+
+ public:
+    /**
+     *  Constructor for MovePicker. Generates the legal moves.
+     *
+     *  \param pos              The position.
+     *  \param pieces           The pieces of the position.
+     *  \param heuristics       The heuristics of the search thread.
+     *  \param tt_move          The move to try first, or a null move.
+     *  \param previous         The move that led to the position, or a null
+     *                          move.
+     *  \param ply              The distance from the root.
+     *  \param noisy_only       Whether to skip quiet moves, for quiescence.
+     */
+    MovePicker(chessCore::Board& pos, const nnue::Pieces& pieces,
+               const MoveHistory& heuristics, chessCore::move_t tt_move,
+               chessCore::move_t previous, int ply, bool noisy_only);
+
+    /**
+     *  Constructor for MovePicker at the root. Hands out the root moves in
+     *  their order.
+     *
+     *  \param root_moves       The root moves.
+     *  \param pieces           The pieces of the root.
+     *  \param heuristics       The heuristics of the search thread.
+     */
+    MovePicker(const RootMoves& root_moves, const nnue::Pieces& pieces,
+               const MoveHistory& heuristics);
+
+    /**
+     *  Get the number of legal moves, whether or not they will be handed
+     *  out.
+     *
+     *  \return                 The number of legal moves.
+     */
+    int numMoves() const {
+        return num_moves;
+    }
+
+    /**
+     *  Get the next move.
+     *
+     *  \return                 The move, or a null move if there are none
+     *                          left.
+     */
+    chessCore::move_t next();
+
+    /**
+     *  Check whether the last move handed out was quiet, i.e. neither a
+     *  capture nor a queen promotion.
+     *
+     *  \return                 True if it was quiet.
+     */
+    bool lastWasQuiet() const {
+        return last_quiet;
+    }
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_MOVEPICK_H_
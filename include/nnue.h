@@ -0,0 +1,311 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_NNUE_H_
+#define SRC_UCI_NNUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "move.h"
+#include "typedefs.h"
+
+
+namespace chessUCI {
+
+/**
+ *  \namespace chessUCI::nnue
+ *  \brief An efficiently updatable neural network evaluation, used instead
+ *  of the core's evaluation when the "EvalFile" option names a network.
+ *
+ *  The network has one input per piece and square (768 in all) seen from
+ *  each side, a hidden layer of \ref HIDDEN neurons per side (the
+ *  accumulators, updated incrementally as moves are made), and one output
+ *  computed from the clipped accumulators of the side to move and of the
+ *  other side. The inner loops run on the fastest SIMD kernel the CPU
+ *  supports, chosen at runtime.
+ */
+namespace nnue {
+
+/** The number of inputs of each side: 12 pieces on 64 squares. */
+const int NUM_FEATURES = 768;
+/** The number of hidden neurons of each side. */
+const int HIDDEN = 256;
+/** The value hidden neurons are clipped to. */
+const int QA = 255;
+/** The quantisation factor of the output weights. */
+const int QB = 64;
+/** The output is scaled by OUTPUT_SCALE / (QA * QB) to give centipawns. */
+const int OUTPUT_SCALE = 400;
+
+/**
+ *  The pieces on the board, kept alongside a chessCore::Board because the
+ *  network needs to know which piece stands on each square. Pieces are
+ *  numbered colour * 6 + type, with the types in the order PNBRQK, and
+ *  squares from a1 = 0 to h8 = 63.
+ */
+class Pieces {
+ public:
+    /** The value of an empty square. */
+    static const int8_t NONE = -1;
+
+    /** A piece added to or removed from a square. */
+    struct Change {
+        int8_t piece;
+        uint8_t square;
+    };
+
+    /** The pieces a move added and removed. */
+    struct Changes {
+        int num_added;
+        int num_removed;
+        Change added[2];
+        Change removed[2];
+    };
+
+ private:
+    /** The piece on each square, or \ref NONE. */
+    int8_t squares[64];
+
+ public:
+    /** Constructor for Pieces, for the starting position. */
+    Pieces();
+
+    /**
+     *  Set up the pieces from the placement field of a FEN.
+     *
+     *  \param fen              The position in FEN format, or "startpos".
+     *
+     *  \return                 False if the placement field is invalid, in
+     *                          which case the board is left empty.
+     */
+    bool setFen(const std::string& fen);
+
+    /**
+     *  Get the piece on a square.
+     *
+     *  \param square           The square.
+     *
+     *  \return                 The piece, or \ref NONE.
+     */
+    int8_t at(int square) const {
+        return squares[square];
+    }
+
+    /**
+     *  Play a move.
+     *
+     *  \param move             The move, legal in the current position.
+     *  \param changes          Set to the pieces added and removed, if not
+     *                          null.
+     */
+    void doMove(chessCore::move_t move, Changes* changes);
+};
+
+/**
+ *  The hidden layer of both sides, indexed by colour. The kernels use
+ *  unaligned loads, so accumulators can live anywhere.
+ */
+struct Accumulator {
+    int16_t values[2][HIDDEN];
+};
+
+/** A set of implementations of the inner loops for one instruction set. */
+struct Kernel {
+    /** The name of the instruction set. */
+    const char* name;
+
+    /**
+     *  Add rows of weights to a hidden layer and subtract others.
+     *
+     *  \param out              The result, \ref HIDDEN values.
+     *  \param in               The layer to start from.
+     *  \param add              The rows to add.
+     *  \param num_add          The number of rows in \p add.
+     *  \param sub              The rows to subtract.
+     *  \param num_sub          The number of rows in \p sub.
+     */
+    void (*addSub)(int16_t* out, const int16_t* in,
+                   const int16_t* const* add, int num_add,
+                   const int16_t* const* sub, int num_sub);
+
+    /**
+     *  Clip both hidden layers to [0, \ref QA] and take their dot product
+     *  with the output weights.
+     *
+     *  \param us               The layer of the side to move.
+     *  \param them             The layer of the other side.
+     *  \param weights          2 * \ref HIDDEN output weights, those of the
+     *                          side to move first.
+     *
+     *  \return                 The dot product.
+     */
+    int32_t (*output)(const int16_t* us, const int16_t* them,
+                      const int16_t* weights);
+};
+
+/**
+ *  Get the kernels the CPU can run.
+ *
+ *  \return                 The kernels, fastest first; the portable scalar
+ *                          kernel is always last.
+ */
+std::vector<const Kernel*> supportedKernels();
+
+/**
+ *  A quantised network, mapped read-only from a file. The file is
+ *  little-endian and holds, in order:
+ *  - the magic "SBNN", then as uint32 the version (1), \ref NUM_FEATURES and
+ *    \ref HIDDEN;
+ *  - int16 feature weights, \ref HIDDEN per feature, the features numbered
+ *    piece * 64 + square from the point of view of white;
+ *  - \ref HIDDEN int16 feature biases;
+ *  - 2 * \ref HIDDEN int16 output weights, those of the side to move first;
+ *  - the int32 output bias.
+ *  Black's side uses the same weights with colours swapped and the board
+ *  flipped vertically.
+ */
+class Network {
+ public:
+    /** The size of a network file in bytes. */
+    static const size_t FILE_SIZE;
+
+ private:
+    /** The mapped file, or null if none is mapped. */
+    void* mapping;
+    /** The network, if it isn't mapped from a file. */
+    std::vector<char> buffer;
+    /** The file the network was loaded from, "" if none. */
+    std::string path;
+    /** The feature weights, null if no network is loaded. */
+    const int16_t* feature_weights;
+    /** The feature biases. */
+    const int16_t* feature_biases;
+    /** The output weights. */
+    const int16_t* output_weights;
+    /** The output bias. */
+    int32_t output_bias;
+    /** The kernel used. */
+    const Kernel* kernel;
+
+    /**
+     *  Point the weights into a network file.
+     *
+     *  \param data             The contents of the file.
+     *  \param error            Set to the reason if it isn't a network.
+     *
+     *  \return                 True if the contents are a network.
+     */
+    bool attach(const char* data, std::string* error);
+
+    /**
+     *  Get the weights of a piece on a square for one side.
+     *
+     *  \param side             The side, 0 for white and 1 for black.
+     *  \param change           The piece and square.
+     *
+     *  \return                 \ref HIDDEN weights.
+     */
+    const int16_t* row(int side, Pieces::Change change) const;
+
+ public:
+    /** Constructor for Network, with no network loaded. */
+    Network();
+    ~Network();
+
+    Network(const Network&) = delete;
+    Network& operator=(const Network&) = delete;
+
+    /**
+     *  Map a network file.
+     *
+     *  \param new_path         The file.
+     *  \param error            Set to the reason if the file can't be used.
+     *
+     *  \return                 True if the network was loaded. Otherwise no
+     *                          network is loaded.
+     */
+    bool load(const std::string& new_path, std::string* error);
+
+    /**
+     *  Fill the network with small pseudo-random weights, for benchmarks.
+     *
+     *  \param seed             The seed of the weights.
+     */
+    void loadRandom(uint64_t seed);
+
+    /** Forget the network. */
+    void unload();
+
+    /**
+     *  Check whether a network is loaded.
+     *
+     *  \return                 True if a network is loaded.
+     */
+    bool loaded() const {
+        return feature_weights != nullptr;
+    }
+
+    /**
+     *  Get the file the network was loaded from.
+     *
+     *  \return                 The name of the file, "" if none.
+     */
+    const std::string& getPath() const;
+
+    /**
+     *  Get the kernel in use.
+     *
+     *  \return                 The kernel.
+     */
+    const Kernel& getKernel() const;
+
+    /**
+     *  Use another kernel, e.g. to compare them.
+     *
+     *  \param new_kernel       The kernel, which the CPU must support.
+     */
+    void setKernel(const Kernel& new_kernel);
+
+    /**
+     *  Compute the accumulator of a position from scratch.
+     *
+     *  \param pieces           The pieces on the board.
+     *  \param acc              The accumulator to fill.
+     */
+    void refresh(const Pieces& pieces, Accumulator* acc) const;
+
+    /**
+     *  Compute the accumulator of a position from that of its parent.
+     *
+     *  \param parent           The accumulator before the move.
+     *  \param changes          The pieces the move added and removed.
+     *  \param acc              The accumulator to fill.
+     */
+    void update(const Accumulator& parent, const Pieces::Changes& changes,
+                Accumulator* acc) const;
+
+    /**
+     *  Evaluate a position.
+     *
+     *  \param acc              The accumulator of the position.
+     *  \param side             The side to move.
+     *
+     *  \return                 The score in centipawns, from the point of
+     *                          view of the side to move.
+     */
+    chessCore::value_t evaluate(const Accumulator& acc,
+                                chessCore::colour side) const;
+};
+
+}   // namespace nnue
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_NNUE_H_
@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_NUMA_H_
+#define SRC_UCI_NUMA_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+namespace chessUCI {
+
+/** An enum representing how threads and memory are placed on NUMA nodes. */
+enum NumaPolicy {
+    /** First-touch on multi-node machines, nothing on single-node ones. */
+    numa_auto,
+    /** Interleave the hash table pages across all nodes. */
+    numa_interleave,
+    /** Each node's threads initialise (and so own) a slice of the hash. */
+    numa_firsttouch,
+    /** Don't pin threads or place memory. */
+    numa_none
+};
+
+/**
+ *  Convert a string to a NumaPolicy.
+ *
+ *  \param name             The name of the policy, e.g. "interleave".
+ *  \param policy           Set to the policy if the name is valid.
+ *
+ *  \return                 True if the name is valid.
+ */
+bool numa_policy_from_string(std::string name, NumaPolicy* policy);
+
+/**
+ *  Convert a NumaPolicy to its name.
+ *
+ *  \param policy           The policy.
+ *
+ *  \return                 The name of the policy, e.g. "interleave".
+ */
+std::string numa_policy_to_string(NumaPolicy policy);
+
+/** The NUMA nodes of the machine and the CPUs that belong to them. */
+class NumaTopology {
+ private:
+    /** The kernel's id of each node. */
+    std::vector<int> node_ids;
+    /** The CPUs of each node. */
+    std::vector<std::vector<int>> node_cpus;
+
+ public:
+    /**
+     *  Detect the topology from /sys/devices/system/node. On other platforms,
+     *  or if that fails, the machine is treated as a single node.
+     */
+    NumaTopology();
+
+    /**
+     *  Get the number of nodes.
+     *
+     *  \return                 The number of nodes, at least 1.
+     */
+    int numNodes() const;
+
+    /**
+     *  Get the CPUs of a node.
+     *
+     *  \param node             The node.
+     *
+     *  \return                 The CPUs of the node, possibly empty if unknown.
+     */
+    const std::vector<int>& cpus(int node) const;
+
+    /**
+     *  Get the node that a search thread should run on, spreading threads
+     *  evenly across nodes.
+     *
+     *  \param thread_id        The index of the thread.
+     *
+     *  \return                 The node.
+     */
+    int nodeForThread(int thread_id) const;
+
+    /**
+     *  Bind the calling thread to the CPUs of a node.
+     *
+     *  \param node             The node.
+     *
+     *  \return                 True if the thread was bound.
+     */
+    bool bindThisThread(int node) const;
+
+    /**
+     *  Ask the kernel to interleave the pages of a memory range across all
+     *  nodes. Must be called before the memory is first touched.
+     *
+     *  \param addr             The start of the range, page aligned.
+     *  \param size             The size of the range in bytes.
+     *
+     *  \return                 True if the policy was applied.
+     */
+    bool interleave(void* addr, size_t size) const;
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_NUMA_H_
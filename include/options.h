@@ -0,0 +1,251 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_OPTIONS_H_
+#define SRC_UCI_OPTIONS_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "messages.h"
+
+
+namespace chessUCI {
+
+/**
+ *  The typed values of all the engine options. Once published by
+ *  \ref OptionRegistry a snapshot is never modified, so the search can read
+ *  it without locks or string lookups.
+ */
+struct OptionValues {
+    /** The size of the transposition table in megabytes. */
+    int hash;
+    /** The number of search threads. */
+    int threads;
+    /** How threads and memory are placed on NUMA nodes. */
+    std::string numa_policy;
+    /** Time kept in reserve to send the best move, in milliseconds. */
+    int move_overhead;
+    /** Keep the hash table and the predicted line from move to move. */
+    bool tree_reuse;
+    /** Make searches reproducible: one thread, a fresh hash table. */
+    bool deterministic;
+    /** Whether the line each thread is searching is sent. */
+    bool show_currline;
+    /** Whether the refutation of each root move is sent. */
+    bool show_refutations;
+    /** The size of the mate solver's table in megabytes. */
+    int mate_hash;
+    /** The size of each thread's evaluation cache in megabytes. */
+    int eval_cache;
+    /** The memory the tables must fit in, in megabytes, 0 for no limit. */
+    int memory_budget;
+    /** Half the width of the root aspiration window, 0 to search without. */
+    int aspiration_window;
+    /** The reverse futility margin per ply of depth. */
+    int rfp_margin;
+    /** The highest depth reverse futility pruning applies at, 0 for none. */
+    int rfp_depth;
+    /** The futility margin per ply of depth. */
+    int futility_margin;
+    /** The highest depth futility pruning applies at, 0 for none. */
+    int futility_depth;
+    /** The constant term of late move reductions, in hundredths of a ply. */
+    int lmr_base;
+    /** The divisor of late move reductions, in hundredths. */
+    int lmr_divisor;
+    /** The lowest depth late moves are reduced at, 0 for none. */
+    int lmr_min_depth;
+    /** The NNUE network file, or "" for the core's evaluation. */
+    std::string eval_file;
+    /** The file written by "debug on". */
+    std::string trace_file;
+    /** The file the statistics of each iteration are written to, or "". */
+    std::string stats_file;
+    /** The file the process metrics are written to, or "". */
+    std::string metrics_file;
+
+    OptionValues();
+};
+
+/**
+ *  The registry of the engine options. It generates the "option" messages,
+ *  parses "setoption" values into an \ref OptionValues, and publishes the
+ *  result as a new immutable snapshot with a single atomic store.
+ *
+ *  Options are set from one thread (the one reading commands); any number of
+ *  threads may read snapshots. Snapshots are reference counted: a search
+ *  holds on to the one it started with, and an old snapshot is freed once
+ *  the last reader lets go of it.
+ */
+class OptionRegistry {
+ public:
+    /** What happened when setting an option. */
+    enum SetResult {
+        /** The option doesn't exist or the value is invalid. */
+        set_invalid,
+        /** The new value was published. */
+        set_ok,
+        /** The new value was published and must be applied by the engine. */
+        set_needs_apply
+    };
+
+ private:
+    /** An option, and where its value is stored. */
+    struct Option {
+        /** The option as it is advertised to the GUI. */
+        MessageTypes::OptionMessage message;
+        /** The storage of spin options. */
+        int OptionValues::* int_field;
+        /** The storage of check options. */
+        bool OptionValues::* bool_field;
+        /** The storage of combo and string options. */
+        std::string OptionValues::* string_field;
+        /** Called when a button option is pressed. */
+        std::function<void()> on_press;
+        /** Whether changes must be applied by the engine, e.g. reallocation. */
+        bool needs_apply;
+
+        Option();
+    };
+
+    /** The options, in the order they were registered. */
+    std::vector<Option> options;
+    /**
+     *  The latest snapshot, only read and written with the atomic
+     *  shared_ptr functions.
+     */
+    std::shared_ptr<const OptionValues> current;
+
+    /**
+     *  Find an option by name, ignoring case.
+     *
+     *  \param name             The name of the option.
+     *
+     *  \return                 The option, or nullptr.
+     */
+    const Option* find(const std::string& name) const;
+
+    /**
+     *  Register an option and store its default value.
+     *
+     *  \param option           The option.
+     */
+    void add(const Option& option);
+
+    /**
+     *  Publish a new snapshot.
+     *
+     *  \param values           The new values.
+     */
+    void publish(const OptionValues& values);
+
+ public:
+    OptionRegistry();
+
+    OptionRegistry(const OptionRegistry&) = delete;
+    OptionRegistry& operator=(const OptionRegistry&) = delete;
+
+    /**
+     *  Register a spin option.
+     *
+     *  \param name             The name of the option.
+     *  \param field            Where the value is stored.
+     *  \param value            The default value.
+     *  \param min              The minimum value.
+     *  \param max              The maximum value.
+     *  \param needs_apply      Whether the engine must act on changes.
+     */
+    void addSpin(std::string name, int OptionValues::* field, int value,
+                 int min, int max, bool needs_apply = false);
+
+    /**
+     *  Register a check option.
+     *
+     *  \param name             The name of the option.
+     *  \param field            Where the value is stored.
+     *  \param value            The default value.
+     *  \param needs_apply      Whether the engine must act on changes.
+     */
+    void addCheck(std::string name, bool OptionValues::* field, bool value,
+                  bool needs_apply = false);
+
+    /**
+     *  Register a combo option.
+     *
+     *  \param name             The name of the option.
+     *  \param field            Where the value is stored.
+     *  \param value            The default value.
+     *  \param vars             The possible values.
+     *  \param needs_apply      Whether the engine must act on changes.
+     */
+    void addCombo(std::string name, std::string OptionValues::* field,
+                  std::string value, std::vector<std::string> vars,
+                  bool needs_apply = false);
+
+    /**
+     *  Register a string option.
+     *
+     *  \param name             The name of the option.
+     *  \param field            Where the value is stored.
+     *  \param value            The default value.
+     *  \param needs_apply      Whether the engine must act on changes.
+     */
+    void addString(std::string name, std::string OptionValues::* field,
+                   std::string value, bool needs_apply = false);
+
+    /**
+     *  Register a button option.
+     *
+     *  \param name             The name of the option.
+     *  \param on_press         Called when the button is pressed.
+     */
+    void addButton(std::string name, std::function<void()> on_press);
+
+    /**
+     *  Get the "option" messages for all the options.
+     *
+     *  \return                 The messages, in registration order.
+     */
+    std::vector<MessageTypes::OptionMessage> messages() const;
+
+    /**
+     *  Set an option from a "setoption" message.
+     *
+     *  \param name             The name of the option, in any case.
+     *  \param value            The new value, as a string.
+     *
+     *  \return                 See \ref SetResult.
+     */
+    SetResult set(const std::string& name, const std::string& value);
+
+    /**
+     *  Get the latest snapshot, to keep reading while options change.
+     *
+     *  \return                 The option values.
+     */
+    std::shared_ptr<const OptionValues> snapshot() const {
+        return std::atomic_load(&current);
+    }
+
+    /**
+     *  Get the latest snapshot. The reference is only valid until the next
+     *  option is set, so this is for the thread that sets them; other
+     *  threads take a \ref snapshot.
+     *
+     *  \return                 The option values.
+     */
+    const OptionValues& values() const {
+        return *current;
+    }
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_OPTIONS_H_
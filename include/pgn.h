@@ -0,0 +1,82 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_PGN_H_
+#define SRC_UCI_PGN_H_
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace chessUCI {
+
+/** A game read from a PGN file: its tags and its main line. */
+struct PgnGame {
+    /** The tag pairs, e.g. ("White", "Carlsen"), in file order. */
+    std::vector<std::pair<std::string, std::string>> tags;
+    /** The moves of the main line in SAN, without move numbers. */
+    std::vector<std::string> moves;
+    /** The game termination marker, e.g. "1-0" or "*". */
+    std::string result;
+
+    /**
+     *  Get the value of a tag.
+     *
+     *  \param name             The name of the tag.
+     *
+     *  \return                 The value, or "" if the tag is missing.
+     */
+    std::string tag(const std::string& name) const;
+};
+
+/**
+ *  A streaming PGN parser. Games are read one at a time, so files of any size
+ *  can be processed in constant memory. Comments, variations, NAGs and move
+ *  suffixes such as "!?" are skipped.
+ */
+class PgnReader {
+ private:
+    /** The stream to read from. */
+    std::istream& in;
+
+    /**
+     *  Skip a comment or a (possibly nested) variation.
+     *
+     *  \param open             The character that opened it.
+     */
+    void skipBlock(char open);
+
+    /**
+     *  Read a tag pair, after its opening bracket.
+     *
+     *  \param game             The game to add the tag to.
+     */
+    void readTag(PgnGame* game);
+
+ public:
+    /**
+     *  Constructor for PgnReader.
+     *
+     *  \param in               The stream to read from.
+     */
+    explicit PgnReader(std::istream& in);
+
+    /**
+     *  Read the next game.
+     *
+     *  \param game             Set to the game.
+     *
+     *  \return                 False at the end of the stream.
+     */
+    bool next(PgnGame* game);
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_PGN_H_
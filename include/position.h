@@ -0,0 +1,276 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_POSITION_H_
+#define SRC_UCI_POSITION_H_
+
+#include <cstdint>
+#include <string>
+
+#include "attacks.h"
+#include "constants.h"
+#include "move.h"
+#include "typedefs.h"
+
+
+namespace chessUCI {
+
+/**
+ *  A compact board that generates and plays moves without the core, laid
+ *  out for the cache. The pieces are kept twice: as bitboards, one per piece
+ *  and one per side, which fill the first two cache lines, and as a mailbox
+ *  of the piece on each square, which fills the third. Pieces are numbered
+ *  as in \ref nnue::Pieces, colour * 6 + type with the types in the order
+ *  PNBRQK, and squares from a1 = 0 to h8 = 63. Moves use the core's
+ *  encoding.
+ *
+ *  What a move can't be undone from (castling rights, the en passant
+ *  square, the fifty-move counter, the captured piece and the hash key) is
+ *  kept in a stack of small records, one per ply: a move copies the top
+ *  record and changes the copy, so undoing it is a pointer decrement.
+ *  Positions are big and not copyable, so they belong on the stack or in
+ *  another object; the hash keys are its own and don't match the core's.
+ */
+class alignas(64) Position {
+ public:
+    /** The value of an empty square. */
+    static const int8_t NONE = -1;
+
+    /** The bits of the castling rights. */
+    enum Castling {
+        white_king_side = 1,
+        white_queen_side = 2,
+        black_king_side = 4,
+        black_queen_side = 8
+    };
+
+    /** The state of the position that a move can't be undone from. */
+    struct State {
+        /** The hash key of the position. */
+        uint64_t key;
+        /** The castling rights, a combination of \ref Castling. */
+        uint8_t castling;
+        /** The square a pawn can be taken en passant on, or -1. */
+        int8_t en_passant;
+        /** The number of plies since the last capture or pawn move. */
+        uint8_t rule50;
+        /** The piece the last move captured, or \ref NONE. */
+        int8_t captured;
+    };
+
+ private:
+    /** The squares of each piece. */
+    chessCore::bitboard by_piece[12];
+    /** The squares of the pieces of each side. */
+    chessCore::bitboard by_colour[2];
+    /** The occupied squares. */
+    chessCore::bitboard occupied;
+    /** The side to move. */
+    chessCore::colour side;
+    /** The piece on each square, or \ref NONE. */
+    alignas(64) int8_t squares[64];
+    /** The top of \ref stack, the state of the current position. */
+    State* state;
+    /** The states of the set position and the moves played since. */
+    State stack[MAX_PLY + 1];
+
+    /** Put a piece on an empty square. */
+    void put(int piece, int square) {
+        chessCore::bitboard bit = chessCore::bitboard{1} << square;
+        by_piece[piece] |= bit;
+        by_colour[piece / 6] |= bit;
+        occupied |= bit;
+        squares[square] = static_cast<int8_t>(piece);
+    }
+
+    /** Take the piece off a square. */
+    void remove(int square) {
+        chessCore::bitboard bit = chessCore::bitboard{1} << square;
+        int piece = squares[square];
+        by_piece[piece] &= ~bit;
+        by_colour[piece / 6] &= ~bit;
+        occupied &= ~bit;
+        squares[square] = NONE;
+    }
+
+    /** Empty the board. */
+    void clear();
+
+    /**
+     *  Get the pieces of a side that attack a square.
+     *
+     *  \param square           The square.
+     *  \param by               The attacking side.
+     *  \param occupancy        The occupied squares, which block sliders.
+     *
+     *  \return                 The attackers, as a bitboard.
+     */
+    template <typename Attacks>
+    chessCore::bitboard attackers(int square, chessCore::colour by,
+                                  chessCore::bitboard occupancy) const;
+
+    /**
+     *  Generate the moves of the side to move. If \p LEGAL, the checkers
+     *  of the king and the pieces pinned to it are found first, and only
+     *  legal moves are generated: out of check, moves must capture the
+     *  checker or block it, pinned pieces may only move along the pin, and
+     *  the king may not step onto an attacked square. Otherwise the moves
+     *  that obey the rules of movement are generated, whether or not they
+     *  leave the king in check. Castling is only generated if it is legal.
+     */
+    template <typename Attacks, bool LEGAL>
+    int generate(chessCore::move_t* moves) const;
+
+ public:
+    /** Constructor for Position, for the starting position. */
+    Position();
+
+    Position(const Position&) = delete;
+    Position& operator=(const Position&) = delete;
+
+    /**
+     *  Set up a position.
+     *
+     *  \param fen              The position in FEN format, or "startpos".
+     *                          The move counters may be left out.
+     *
+     *  \return                 False if the FEN is invalid, in which case
+     *                          the board is left empty.
+     */
+    bool setFen(const std::string& fen);
+
+    /**
+     *  Get the side to move.
+     *
+     *  \return                 The side to move.
+     */
+    chessCore::colour getSide() const {
+        return side;
+    }
+
+    /**
+     *  Get the piece on a square.
+     *
+     *  \param square           The square.
+     *
+     *  \return                 The piece, or \ref NONE.
+     */
+    int8_t at(int square) const {
+        return squares[square];
+    }
+
+    /**
+     *  Get the squares of a piece.
+     *
+     *  \param piece            The piece.
+     *
+     *  \return                 The squares, as a bitboard.
+     */
+    chessCore::bitboard pieces(int piece) const {
+        return by_piece[piece];
+    }
+
+    /**
+     *  Get the squares of the pieces of a side.
+     *
+     *  \param c                The side.
+     *
+     *  \return                 The squares, as a bitboard.
+     */
+    chessCore::bitboard pieces(chessCore::colour c) const {
+        return by_colour[c];
+    }
+
+    /**
+     *  Get the state that moves can't be undone from.
+     *
+     *  \return                 The state of the current position.
+     */
+    const State& getState() const {
+        return *state;
+    }
+
+    /**
+     *  Get the hash key of the position.
+     *
+     *  \return                 The hash key.
+     */
+    uint64_t getKey() const {
+        return state->key;
+    }
+
+    /**
+     *  Play a move. At most \ref MAX_PLY moves can be on the board at once.
+     *
+     *  \param move             The move, legal in the current position.
+     */
+    void doMove(chessCore::move_t move);
+
+    /**
+     *  Take back the last move played.
+     *
+     *  \param move             The move.
+     */
+    void undoMove(chessCore::move_t move);
+
+    /**
+     *  Check whether a side attacks a square.
+     *
+     *  \param square           The square.
+     *  \param by               The attacking side.
+     *
+     *  \return                 True if a piece of \p by attacks \p square.
+     */
+    template <typename Attacks>
+    bool attacked(int square, chessCore::colour by) const;
+
+    /**
+     *  Generate the legal moves, without playing any of them.
+     *
+     *  \param moves            Filled with the moves, room for
+     *                          \ref MAX_MOVES.
+     *
+     *  \return                 The number of moves.
+     */
+    template <typename Attacks>
+    int generateMoves(chessCore::move_t* moves) const {
+        return generate<Attacks, true>(moves);
+    }
+
+    /**
+     *  Generate the legal moves the slow way: generate the moves that obey
+     *  the rules of movement, and keep each if the king isn't attacked once
+     *  it is played. For checking and benchmarking \ref generateMoves.
+     *
+     *  \param moves            Filled with the moves, room for
+     *                          \ref MAX_MOVES.
+     *
+     *  \return                 The number of moves.
+     */
+    template <typename Attacks>
+    int generateMovesByPlaying(chessCore::move_t* moves);
+};
+
+/**
+ *  Count the leaf nodes of the tree of legal moves to a depth, counting the
+ *  moves of the last ply without playing them.
+ *
+ *  \param pos              The position, unchanged on return.
+ *  \param depth            The depth in plies, at most \ref MAX_PLY.
+ *  \param backend          The sliding attack backend to use.
+ *  \param by_playing       Whether to generate moves with
+ *                          \ref Position::generateMovesByPlaying rather
+ *                          than \ref Position::generateMoves.
+ *
+ *  \return                 The number of leaves.
+ */
+uint64_t perft(Position& pos, int depth, attacks::Backend backend,
+               bool by_playing = false);
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_POSITION_H_
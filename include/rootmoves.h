@@ -0,0 +1,127 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_ROOTMOVES_H_
+#define SRC_UCI_ROOTMOVES_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "board.h"
+#include "move.h"
+#include "nnue.h"
+#include "typedefs.h"
+
+
+namespace chessUCI {
+
+/** A move at the root and what the search learnt about it. */
+struct RootMove {
+    /** The move. */
+    chessCore::move_t move;
+    /** The nodes of its subtree in the current iteration. */
+    uint64_t nodes;
+    /** The nodes of its subtree in the last completed iteration. */
+    uint64_t last_nodes;
+    /**
+     *  The score of its last search, a bound unless it was the best move,
+     *  or -\ref MATE_VALUE if it hasn't been searched.
+     */
+    chessCore::value_t score;
+};
+
+/**
+ *  The moves searched at the root: all the legal moves, or those of "go
+ *  searchmoves". Each search thread keeps a copy, in the order it searches
+ *  them, and counts the nodes of each subtree. When an iteration completes,
+ *  the best move goes first and the others are sorted by the effort they
+ *  took, since a move that took many nodes to refute is the likeliest to
+ *  become best at the next depth.
+ */
+class RootMoves {
+ private:
+    /** The moves, in the order they are searched. */
+    std::vector<RootMove> moves;
+
+ public:
+    /**
+     *  Set up the moves of a position, in the order of the move picker with
+     *  no history: the hash move, then captures, then quiet moves.
+     *
+     *  \param board            The position.
+     *  \param pieces           The pieces of \p board.
+     *  \param tt_move          The hash move of the position, or a null
+     *                          move.
+     *  \param allowed          The moves to search, or empty for all. Moves
+     *                          that aren't legal are left out, and if none
+     *                          is legal all moves are searched.
+     */
+    void init(chessCore::Board& board, const nnue::Pieces& pieces,
+              chessCore::move_t tt_move,
+              const std::vector<chessCore::move_t>& allowed);
+
+    /**
+     *  Get the number of moves.
+     *
+     *  \return                 The number of moves.
+     */
+    int size() const {
+        return static_cast<int>(moves.size());
+    }
+
+    /**
+     *  Get a move by its place in the search order.
+     *
+     *  \param i                The place, from 0.
+     *
+     *  \return                 The move.
+     */
+    RootMove& operator[](int i) {
+        return moves[i];
+    }
+
+    /**
+     *  Get a move by its place in the search order.
+     *
+     *  \param i                The place, from 0.
+     *
+     *  \return                 The move.
+     */
+    const RootMove& operator[](int i) const {
+        return moves[i];
+    }
+
+    /**
+     *  Check whether a move is searched.
+     *
+     *  \param move             The move.
+     *
+     *  \return                 True if \p move is one of the root moves.
+     */
+    bool contains(chessCore::move_t move) const;
+
+    /**
+     *  Reorder the moves for the next iteration once one completes: the
+     *  best move first, then the rest by the nodes they took, most first,
+     *  and then by score. The node counts start over.
+     *
+     *  \param best             The best move of the iteration.
+     */
+    void iterationDone(chessCore::move_t best);
+
+    /**
+     *  Get the share of the last completed iteration that went into the
+     *  best move, which is high when the other moves were refuted quickly.
+     *
+     *  \return                 The share, from 0 to 1.
+     */
+    double bestShare() const;
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_ROOTMOVES_H_
@@ -0,0 +1,135 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_SELFPLAY_H_
+#define SRC_UCI_SELFPLAY_H_
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace chessUCI {
+
+/**
+ *  \namespace chessUCI::selfplay
+ *  \brief Matches between two configurations of the engine, run with
+ *  "uci selfplay".
+ */
+namespace selfplay {
+
+/** A struct holding the settings of a match. */
+struct MatchSettings {
+    /** The maximum number of games to play. */
+    int games;
+    /** The number of games played at once, each on its own thread. */
+    int concurrency;
+    /** The "go" command sent for every move, e.g. "go nodes 20000". */
+    std::string go_command;
+    /** Games longer than this many plies are adjudicated as draws. */
+    int max_plies;
+    /** The openings, as moves in long algebraic notation from startpos. */
+    std::vector<std::vector<std::string>> openings;
+    /** The options ("setoption" name and value) of players A and B. */
+    std::vector<std::pair<std::string, std::string>> options[2];
+    /** The Elo difference of the SPRT null hypothesis. */
+    double elo0;
+    /** The Elo difference of the SPRT alternative hypothesis. */
+    double elo1;
+    /** The SPRT false positive rate. */
+    double alpha;
+    /** The SPRT false negative rate. */
+    double beta;
+
+    MatchSettings();
+};
+
+/** A struct holding the results of a match, from player A's point of view. */
+struct MatchResult {
+    /** The number of games won by A. */
+    int wins;
+    /** The number of games drawn. */
+    int draws;
+    /** The number of games lost by A. */
+    int losses;
+    /** The nodes reported by each player. */
+    uint64_t nodes[2];
+    /** The search time reported by each player in milliseconds. */
+    uint64_t time[2];
+
+    MatchResult();
+
+    /**
+     *  Get the number of games played.
+     *
+     *  \return                 The number of games.
+     */
+    int games() const;
+
+    /**
+     *  Get A's score, e.g. 0.5 if all games were drawn.
+     *
+     *  \return                 The score, between 0 and 1.
+     */
+    double score() const;
+
+    /**
+     *  Estimate the Elo difference between A and B.
+     *
+     *  \param margin           Set to the half-width of the 95% confidence
+     *                          interval.
+     *
+     *  \return                 The Elo difference.
+     */
+    double elo(double* margin) const;
+
+    /**
+     *  Compute the log-likelihood ratio of the SPRT between elo1 and elo0.
+     *
+     *  \param elo0             The Elo difference of the null hypothesis.
+     *  \param elo1             The Elo difference of the alternative.
+     *
+     *  \return                 The log-likelihood ratio.
+     */
+    double llr(double elo0, double elo1) const;
+};
+
+/**
+ *  Play a match between two players, each a \ref chessInterface talking UCI
+ *  over in-memory streams. Every opening is played twice with colours
+ *  reversed. The match stops early once the SPRT accepts a hypothesis.
+ *
+ *  \param settings         The settings of the match.
+ *  \param log              The stream to report each game to.
+ *
+ *  \return                 The results.
+ */
+MatchResult playMatch(const MatchSettings& settings, std::ostream& log);
+
+/**
+ *  Run a match from the command line. The arguments are any of
+ *  "games <n>", "concurrency <n>", "nodes <n>", "movetime <ms>",
+ *  "depth <plies>", "maxplies <n>", "openings <file>", "elo0 <elo>",
+ *  "elo1 <elo>", and "a.<option> <value>" or "b.<option> <value>" to set an
+ *  option of one player.
+ *
+ *  \param args             The command-line arguments after "selfplay".
+ *  \param out              The stream to report to.
+ *  \param err              The stream to report errors to.
+ *
+ *  \return                 The exit status of the program.
+ */
+int run(const std::vector<std::string>& args, std::ostream& out,
+        std::ostream& err);
+
+}   // namespace selfplay
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_SELFPLAY_H_
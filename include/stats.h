@@ -0,0 +1,163 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_STATS_H_
+#define SRC_UCI_STATS_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "typedefs.h"
+
+
+namespace chessUCI {
+
+/** Counters kept by a search thread, cumulative over one search. */
+struct SearchStats {
+    /** Nodes searched in quiescence. */
+    uint64_t qnodes;
+    /** Hash table probes in the main search. */
+    uint64_t tt_probes;
+    /** Probes that found the position. */
+    uint64_t tt_hits;
+    /** Probes whose score was used without searching. */
+    uint64_t tt_cutoffs;
+    /** Nodes that failed high. */
+    uint64_t beta_cutoffs;
+    /** Nodes that failed high on their first move. */
+    uint64_t first_move_cutoffs;
+    /** Lookups in the evaluation cache. */
+    uint64_t eval_probes;
+    /** Lookups that found the position. */
+    uint64_t eval_hits;
+    /** Nodes cut by reverse futility pruning. */
+    uint64_t rfp_cutoffs;
+    /** Moves skipped by futility pruning. */
+    uint64_t futility_prunes;
+    /** Moves searched to a reduced depth. */
+    uint64_t lmr_reductions;
+    /** Reduced moves searched again at full depth. */
+    uint64_t lmr_researches;
+    /** Root searches that fell outside the aspiration window. */
+    uint64_t aspiration_fails;
+
+    SearchStats();
+};
+
+/** The statistics of one iteration of the main search thread. */
+struct IterationStats {
+    /** The depth of the iteration. */
+    int depth;
+    /** The selective depth reached. */
+    int seldepth;
+    /** The score of the iteration. */
+    chessCore::value_t score;
+    /** Time since the search started in milliseconds. */
+    uint32_t time;
+    /** Time spent on this iteration in milliseconds. */
+    uint32_t iteration_time;
+    /** Nodes searched since the search started. */
+    uint64_t nodes;
+    /** Nodes searched in this iteration. */
+    uint64_t iteration_nodes;
+    /** Nodes of this iteration over nodes of the last, 0 for the first. */
+    double branching_factor;
+    /** Share of the nodes of this iteration searched in quiescence. */
+    double qnode_share;
+    /** Share of the hash table probes that found the position. */
+    double tt_hit_rate;
+    /** Share of the hash table probes that cut the search off. */
+    double tt_cutoff_rate;
+    /** Share of the fail-high nodes that failed high on the first move. */
+    double first_move_cutoff_rate;
+    /** Share of the evaluation cache lookups that found the position. */
+    double eval_hit_rate;
+    /** Share of the reduced moves searched again at full depth. */
+    double lmr_research_rate;
+    /** Root searches of this iteration outside the aspiration window. */
+    uint32_t aspiration_fails;
+
+    IterationStats();
+
+    /**
+     *  Compute the statistics of an iteration from the counters at its start
+     *  and at its end.
+     *
+     *  \param before           The counters when the iteration started.
+     *  \param after            The counters when the iteration ended.
+     *  \param nodes_before     The nodes searched when it started.
+     *  \param nodes_after      The nodes searched when it ended.
+     *  \param last_nodes       The nodes of the previous iteration, or 0.
+     */
+    void compute(const SearchStats& before, const SearchStats& after,
+                 uint64_t nodes_before, uint64_t nodes_after,
+                 uint64_t last_nodes);
+};
+
+/**
+ *  Appends iteration statistics to a file, one row per iteration, as CSV if
+ *  the file name ends in ".csv" and as JSON lines otherwise. The file is
+ *  rotated (renamed to ".1", ".2" and so on) when it grows too large.
+ */
+class StatsWriter {
+ public:
+    /** The size from which the file is rotated, in bytes. */
+    static const uint64_t MAX_FILE_SIZE = 64 * 1024 * 1024;
+    /** The number of rotated files kept. */
+    static const int MAX_ROTATED_FILES = 4;
+
+ private:
+    /** The file. */
+    std::ofstream file;
+    /** The name of the file, "" if none is open. */
+    std::string path;
+    /** Whether the file is CSV rather than JSON lines. */
+    bool csv;
+    /** The size of the file in bytes. */
+    uint64_t size;
+
+    /** Open \ref path for appending, writing the CSV header if it's new. */
+    void reopen();
+
+    /** Rename the file and the older rotated files, and start a new one. */
+    void rotate();
+
+ public:
+    StatsWriter();
+
+    /**
+     *  Write to a file from now on.
+     *
+     *  \param new_path         The name of the file, or "" to stop writing.
+     *
+     *  \return                 False if the file can't be opened.
+     */
+    bool open(const std::string& new_path);
+
+    /**
+     *  Get the name of the file.
+     *
+     *  \return                 The name of the file, "" if none is open.
+     */
+    const std::string& getPath() const;
+
+    /**
+     *  Write the statistics of an iteration.
+     *
+     *  \param search           The number of the search.
+     *  \param stats            The statistics.
+     */
+    void write(uint64_t search, const IterationStats& stats);
+
+    /** Write buffered rows to the file. */
+    void flush();
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_STATS_H_
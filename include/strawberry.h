@@ -0,0 +1,117 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_STRAWBERRY_H_
+#define SRC_UCI_STRAWBERRY_H_
+
+/*
+ *  A C wrapper around chessUCI::Engine, for embedding the engine in programs
+ *  that are not written in C++.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** An opaque handle to an engine. */
+typedef struct strawberry_engine strawberry_engine;
+
+/** A move. Squares are numbered from a1 = 0 to h8 = 63. */
+typedef struct {
+    /** The square the piece moves from. */
+    uint8_t from;
+    /** The square the piece moves to. */
+    uint8_t to;
+    /** The promotion piece ('n', 'b', 'r' or 'q'), or 0. */
+    char promotion;
+} strawberry_move;
+
+/** The limits of a search. Zero means no limit. */
+typedef struct {
+    int ponder;
+    int infinite;
+    uint32_t wtime;
+    uint32_t btime;
+    uint32_t winc;
+    uint32_t binc;
+    uint16_t movestogo;
+    uint8_t depth;
+    uint32_t movetime;
+    uint64_t nodes;
+    /** Search for a mate in this many moves. */
+    uint8_t mate;
+    /** The moves to search, or null for all. Illegal moves are ignored. */
+    const strawberry_move* searchmoves;
+    size_t num_searchmoves;
+} strawberry_limits;
+
+/** The result of one search iteration. */
+typedef struct {
+    int depth;
+    int seldepth;
+    uint32_t time;
+    uint64_t nodes;
+    uint64_t nps;
+    /** The score in centipawns, or moves to mate if mate is set. */
+    int32_t score;
+    int mate;
+    /** The principal variation, only valid during the callback. */
+    const strawberry_move* pv;
+    size_t pv_length;
+    /** How full the hash table is, out of 1000. */
+    int hashfull;
+    /** A message to display. If set, the other fields are unused. */
+    const char* string;
+} strawberry_info;
+
+typedef void (*strawberry_info_callback)(const strawberry_info* info,
+                                         void* user_data);
+typedef void (*strawberry_bestmove_callback)(strawberry_move best,
+                                             strawberry_move ponder,
+                                             void* user_data);
+
+strawberry_engine* strawberry_new(void);
+void strawberry_free(strawberry_engine* engine);
+
+void strawberry_new_game(strawberry_engine* engine);
+
+/** Set the size of the hash table in megabytes. */
+void strawberry_set_hash(strawberry_engine* engine, size_t megabytes);
+/** Set the number of search threads. */
+void strawberry_set_threads(strawberry_engine* engine, int num_threads);
+/**
+ *  Set any engine option by name, as in the UCI "setoption" command. Returns
+ *  0 on success, -1 if the option doesn't exist or the value is invalid.
+ */
+int strawberry_set_option(strawberry_engine* engine, const char* name,
+                          const char* value);
+
+/**
+ *  Set the position to search. fen may be "startpos". Returns 0 on success,
+ *  or -1 if one of the moves is illegal.
+ */
+int strawberry_set_position(strawberry_engine* engine, const char* fen,
+                            const strawberry_move* moves, size_t num_moves);
+
+/** Start a search. The callbacks are called from the search thread. */
+void strawberry_go(strawberry_engine* engine, const strawberry_limits* limits,
+                   strawberry_info_callback on_info,
+                   strawberry_bestmove_callback on_bestmove,
+                   void* user_data);
+
+void strawberry_stop(strawberry_engine* engine);
+void strawberry_ponderhit(strawberry_engine* engine);
+void strawberry_wait(strawberry_engine* engine);
+
+#ifdef __cplusplus
+}   // extern "C"
+#endif
+
+#endif  // SRC_UCI_STRAWBERRY_H_
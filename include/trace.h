@@ -0,0 +1,206 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_TRACE_H_
+#define SRC_UCI_TRACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+namespace chessUCI {
+
+/** An enum representing the kinds of events that can be traced. */
+enum TraceEventType : uint8_t {
+    /** A line was read from the GUI. a: its number, b: its length. */
+    trace_command_received,
+    /** A command was handled. a: its kind, b: how long it took in us. */
+    trace_command_dispatched,
+    /** A search iteration started. a: the depth. */
+    trace_iteration_start,
+    /** A search iteration ended. a: the score, b: the nodes searched. */
+    trace_iteration_end,
+    /** A burst of hash table probes. a: hits, b: misses. */
+    trace_tt_burst,
+    /** The main thread checked its limits. a: elapsed ms, b: nodes. */
+    trace_time_check,
+    /** A root move beat the best one so far. a: its index, b: the score. */
+    trace_root_fail_high,
+    /** An iteration scored lower than the last. a: the score, b: the last. */
+    trace_root_fail_low,
+    /**
+     *  An aspiration window failed low and was widened. a: the score, b: the
+     *  new lower bound.
+     */
+    trace_aspiration_fail_low,
+    /**
+     *  An aspiration window failed high and was widened. a: the score, b:
+     *  the new upper bound.
+     */
+    trace_aspiration_fail_high,
+    /**
+     *  The watchdog stopped a search at its hard deadline. a: ms past the
+     *  time budget the best move was sent, b: 1 if it was the fallback.
+     */
+    trace_deadline_overrun,
+    /** The number of event types. */
+    trace_num_types
+};
+
+/** A fixed-size binary trace event. */
+struct TraceEvent {
+    /** Nanoseconds since tracing started. */
+    uint64_t time;
+    /** The index of the ring of the thread that recorded the event. */
+    uint16_t thread;
+    /** See \ref TraceEventType. */
+    TraceEventType type;
+    /** The first argument, depending on the type. */
+    int32_t a;
+    /** The second argument, depending on the type. */
+    int64_t b;
+};
+
+/**
+ *  A single-producer single-consumer ring buffer of trace events. The thread
+ *  owning the ring pushes without locks or allocation; when the ring is full
+ *  the event is counted as dropped rather than waiting for the consumer.
+ */
+class TraceRing {
+ public:
+    /** The number of events a ring holds, a power of two. */
+    static const size_t CAPACITY = 4096;
+
+ private:
+    /** The events. */
+    TraceEvent events[CAPACITY];
+    /** The number of events ever pushed; written by the producer only. */
+    std::atomic<uint64_t> head;
+    /** The number of events ever popped; written by the consumer only. */
+    std::atomic<uint64_t> tail;
+
+ public:
+    /** The number of events dropped because the ring was full. */
+    std::atomic<uint64_t> dropped;
+    /** Whether a thread currently owns the ring. */
+    std::atomic<bool> in_use;
+    /** The index of the ring, used as the thread id in the trace. */
+    uint16_t id;
+
+    /**
+     *  Constructor for TraceRing.
+     *
+     *  \param id               The index of the ring.
+     */
+    explicit TraceRing(uint16_t id);
+
+    /**
+     *  Add an event, or drop it if the ring is full. Producer only.
+     *
+     *  \param event            The event.
+     */
+    void push(const TraceEvent& event) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == CAPACITY) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        events[h & (CAPACITY - 1)] = event;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    /**
+     *  Remove events. Consumer only.
+     *
+     *  \param out              The buffer to copy the events to.
+     *  \param max              The size of \p out.
+     *
+     *  \return                 The number of events removed.
+     */
+    size_t pop(TraceEvent* out, size_t max);
+
+    /** Throw away all the events. Consumer only. */
+    void discard();
+};
+
+/**
+ *  \namespace chessUCI::trace
+ *  \brief Low-overhead tracing of the interface and the search, enabled by
+ *  the UCI "debug" command.
+ *
+ *  Each thread records into a ring of its own, and a background thread
+ *  drains the rings into a file in the Chrome trace event format (viewable
+ *  with chrome://tracing or Perfetto). When tracing is off, recording an
+ *  event costs one relaxed atomic load.
+ */
+namespace trace {
+
+/** Set while tracing is on; use \ref on to check it. */
+extern std::atomic<bool> enabled;
+
+/** A struct holding the totals of a trace. */
+struct TraceStats {
+    /** The number of events written. */
+    uint64_t events;
+    /** The number of events dropped because a ring was full. */
+    uint64_t dropped;
+
+    TraceStats();
+};
+
+/**
+ *  Check whether tracing is on.
+ *
+ *  \return                 True if events are being recorded.
+ */
+inline bool on() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ *  Record an event in the calling thread's ring. Use \ref event instead.
+ *
+ *  \param type             The kind of event.
+ *  \param a                The first argument.
+ *  \param b                The second argument.
+ */
+void record(TraceEventType type, int32_t a, int64_t b);
+
+/**
+ *  Record an event if tracing is on.
+ *
+ *  \param type             The kind of event.
+ *  \param a                The first argument.
+ *  \param b                The second argument.
+ */
+inline void event(TraceEventType type, int32_t a = 0, int64_t b = 0) {
+    if (on()) record(type, a, b);
+}
+
+/**
+ *  Start tracing to a file. Does nothing if tracing is already on.
+ *
+ *  \param path             The file to write the trace to.
+ *
+ *  \return                 False if the file can't be opened.
+ */
+bool start(const std::string& path);
+
+/**
+ *  Stop tracing, write the remaining events and close the file.
+ *
+ *  \return                 The totals of the trace.
+ */
+TraceStats stop();
+
+}   // namespace trace
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_TRACE_H_
@@ -0,0 +1,176 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_TT_H_
+#define SRC_UCI_TT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "membudget.h"
+#include "move.h"
+#include "numa.h"
+#include "typedefs.h"
+
+
+namespace chessUCI {
+
+/** An enum representing what a stored score says about the true score. */
+enum TTBound : uint8_t {
+    bound_none,
+    /** The true score is at most the stored score. */
+    bound_upper,
+    /** The true score is at least the stored score. */
+    bound_lower,
+    /** The stored score is the true score. */
+    bound_exact
+};
+
+/** An entry of the transposition table. */
+struct TTEntry {
+    /** The upper 32 bits of the position's hash key. */
+    uint32_t key;
+    /** The best move found in the position. */
+    chessCore::move_t move;
+    /** The score of the position. */
+    int16_t score;
+    /** The depth the position was searched to. */
+    int8_t depth;
+    /** See \ref TTBound. */
+    TTBound bound;
+    /** The search the entry was last written by, see \ref newSearch. */
+    uint8_t generation;
+};
+
+/**
+ *  A transposition table shared by all search threads. Races between threads
+ *  are tolerated: a torn entry at worst gives a bad move or score, and moves
+ *  are always checked against the legal moves before being played.
+ *
+ *  Entries are kept from one search to the next. Each search bumps a
+ *  generation counter instead of clearing the table, and the replacement
+ *  policy only protects deep entries written by the current search, so
+ *  stale entries are overwritten as the new search needs the room.
+ */
+class TranspositionTable {
+ private:
+    /** The entries. */
+    TTEntry* table;
+    /** The number of entries, a power of two. */
+    size_t num_entries;
+    /** The size of the allocation in bytes. */
+    size_t alloc_size;
+    /** The generation of the current search. */
+    uint8_t generation;
+    /** The charge of \ref table against the memory budget. */
+    MemoryCharge charge;
+
+    /** Free the table. */
+    void release();
+
+    /**
+     *  Allocate the table, without touching its memory.
+     *
+     *  \param megabytes        The maximum size of the table.
+     *
+     *  \return                 False if the memory can't be had.
+     */
+    bool allocate(size_t megabytes);
+
+ public:
+    TranspositionTable();
+    ~TranspositionTable();
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    /**
+     *  Charge the memory of the table to a budget.
+     *
+     *  \param budget           The budget, or null for none.
+     */
+    void track(MemoryBudget* budget) {
+        charge.attach(budget);
+    }
+
+    /**
+     *  Reallocate the table and place its memory according to a NUMA policy.
+     *  If the memory can't be had, the size is halved until it can.
+     *
+     *  \param megabytes        The maximum size of the table.
+     *  \param topology         The NUMA topology of the machine.
+     *  \param policy           How to place the memory.
+     *  \param num_threads      How many threads to clear the table with.
+     *
+     *  \return                 The size allocated in megabytes, at most
+     *                          \p megabytes. Throws std::bad_alloc if not
+     *                          even 1 MB could be allocated.
+     */
+    size_t resize(size_t megabytes, const NumaTopology& topology,
+                  NumaPolicy policy, int num_threads);
+
+    /**
+     *  Zero the table, with each slice written by a thread bound to the node
+     *  that should own it under the first-touch policy.
+     *
+     *  \param topology         The NUMA topology of the machine.
+     *  \param policy           How to place the memory.
+     *  \param num_threads      How many threads to clear the table with.
+     */
+    void clear(const NumaTopology& topology, NumaPolicy policy,
+               int num_threads);
+
+    /**
+     *  Start a new search (or a new game): entries written before now become
+     *  stale and may be replaced by any new entry.
+     */
+    void newSearch() {
+        generation++;
+    }
+
+    /**
+     *  Look up a position.
+     *
+     *  \param key              The hash key of the position.
+     *  \param entry            Set to the entry if found.
+     *
+     *  \return                 True if the position was found.
+     */
+    bool probe(uint64_t key, TTEntry* entry) const {
+        const TTEntry& slot = table[key & (num_entries - 1)];
+        if (slot.key != static_cast<uint32_t>(key >> 32) ||
+            slot.bound == bound_none) {
+            return false;
+        }
+        *entry = slot;
+        return true;
+    }
+
+    /**
+     *  Store the result of searching a position.
+     *
+     *  \param key              The hash key of the position.
+     *  \param move             The best move, or the null move.
+     *  \param score            The score, already adjusted for mate distance.
+     *  \param depth            The depth searched.
+     *  \param bound            What the score says about the true score.
+     */
+    void store(uint64_t key, chessCore::move_t move, chessCore::value_t score,
+               int depth, TTBound bound);
+
+    /**
+     *  Estimate how full the table is by sampling the first entries. Only
+     *  entries of the current search are counted.
+     *
+     *  \return                 How full the table is, out of 1000.
+     */
+    int hashfull() const;
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_TT_H_
@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_UCI_WATCHDOG_H_
+#define SRC_UCI_WATCHDOG_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+namespace chessUCI {
+
+/**
+ *  A timer thread that calls a function once a deadline passes, unless it is
+ *  disarmed first. The thread is started the first time the watchdog is
+ *  armed, and the function runs on it, so it must be safe to call alongside
+ *  whatever the rest of the program is doing.
+ */
+class Watchdog {
+ public:
+    /** A point in time on the steady clock. */
+    typedef std::chrono::steady_clock::time_point time_point;
+
+ private:
+    /** The timer thread. */
+    std::thread thread;
+    /** A mutex guarding the fields below. */
+    std::mutex mutex;
+    /** Signalled when the fields below change. */
+    std::condition_variable changed;
+    /** Set to make the timer thread exit. */
+    bool quit;
+    /** Set while a deadline is pending. */
+    bool armed;
+    /** Set while the function is running. */
+    bool firing;
+    /** The pending deadline. */
+    time_point deadline;
+    /** The function to call at \ref deadline. */
+    std::function<void()> on_expiry;
+
+    /** The body of the timer thread. */
+    void run();
+
+ public:
+    /** Constructor for Watchdog, disarmed. */
+    Watchdog();
+    ~Watchdog();
+
+    Watchdog(const Watchdog&) = delete;
+    Watchdog& operator=(const Watchdog&) = delete;
+
+    /**
+     *  Set the deadline, replacing any pending one.
+     *
+     *  \param new_deadline     When to call \p callback.
+     *  \param callback         The function to call.
+     */
+    void arm(time_point new_deadline, std::function<void()> callback);
+
+    /**
+     *  Cancel the pending deadline, if any. If the function is running it is
+     *  waited for, so it must not call this itself.
+     */
+    void disarm();
+};
+
+}   // namespace chessUCI
+
+#endif  // SRC_UCI_WATCHDOG_H_
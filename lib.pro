@@ -0,0 +1,93 @@
+# Copyright (c) 2022, Frederick Pringle
+# All rights reserved.
+# 
+# This source code is licensed under the BSD-style license found in the
+# LICENSE file in the root directory of this source tree.
+
+# A static library with the core and the engine API, for embedding the engine
+# in-process without going through the UCI text protocol.
+
+TEMPLATE = lib
+CONFIG += staticlib
+TARGET = build/strawberry
+CORE_DIR = $${_PRO_FILE_PWD}../core
+OBJECTS_DIR = obj/lib
+MOC_DIR = obj/lib/unix
+
+INCLUDEPATH += $${CORE_DIR}/include \
+               include
+
+QT -= core gui
+
+HEADERS += include/annotate.h \
+           include/attacks.h \
+           include/constants.h \
+           include/currline.h \
+           include/engine.h \
+           include/evalcache.h \
+           include/history.h \
+           include/interface.h \
+           include/lan.h \
+           include/matesearch.h \
+           include/membudget.h \
+           include/messages.h \
+           include/metrics.h \
+           include/movepick.h \
+           include/nnue.h \
+           include/numa.h \
+           include/options.h \
+           include/pgn.h \
+           include/position.h \
+           include/rootmoves.h \
+           include/selfplay.h \
+           include/stats.h \
+           include/strawberry.h \
+           include/trace.h \
+           include/tt.h \
+           include/watchdog.h \
+           $${CORE_DIR}/include/action.h \
+           $${CORE_DIR}/include/board.h \
+           $${CORE_DIR}/include/eval.h \
+           $${CORE_DIR}/include/hash.h \
+           $${CORE_DIR}/include/init.h \
+           $${CORE_DIR}/include/move.h \
+           $${CORE_DIR}/include/play.h \
+           $${CORE_DIR}/include/search.h \
+           $${CORE_DIR}/include/tree.h \
+           $${CORE_DIR}/include/twiddle.h \
+           $${CORE_DIR}/include/typedefs.h
+
+SOURCES += src/annotate.cpp \
+           src/attacks.cpp \
+           src/currline.cpp \
+           src/engine.cpp \
+           src/evalcache.cpp \
+           src/history.cpp \
+           src/interface.cpp \
+           src/lan.cpp \
+           src/matesearch.cpp \
+           src/membudget.cpp \
+           src/metrics.cpp \
+           src/movepick.cpp \
+           src/nnue.cpp \
+           src/numa.cpp \
+           src/options.cpp \
+           src/pgn.cpp \
+           src/position.cpp \
+           src/rootmoves.cpp \
+           src/selfplay.cpp \
+           src/stats.cpp \
+           src/strawberry.cpp \
+           src/trace.cpp \
+           src/tt.cpp \
+           src/watchdog.cpp \
+           src/worker.cpp \
+           $${CORE_DIR}/src/action.cpp \
+           $${CORE_DIR}/src/board.cpp \
+           $${CORE_DIR}/src/check.cpp \
+           $${CORE_DIR}/src/eval.cpp \
+           $${CORE_DIR}/src/hash.cpp \
+           $${CORE_DIR}/src/init.cpp \
+           $${CORE_DIR}/src/move.cpp \
+           $${CORE_DIR}/src/play.cpp \
+           $${CORE_DIR}/src/search.cpp
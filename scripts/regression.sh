@@ -0,0 +1,85 @@
+#!/bin/sh
+# Copyright (c) 2022, Frederick Pringle
+# All rights reserved.
+#
+# This source code is licensed under the BSD-style license found in the
+# LICENSE file in the root directory of this source tree.
+#
+# Run the deterministic search benchmark, which searches every position to a
+# fixed depth, and compare it against a baseline. The best move and node
+# count of every position must match exactly, so any change to the shape of
+# the tree is caught; the total speed may not drop by more than NPS_TOLERANCE
+# percent (default 5).
+#
+# No baseline is committed until one has been made on the reference machine.
+# To bootstrap it, run scripts/regression.sh --update there and commit
+# scripts/bench_baseline.txt; until then the check fails.
+#
+# Usage: scripts/regression.sh [--update] [binary]
+#   --update    Write the current results as the new baseline.
+#   binary      The engine to run, build/uci by default.
+
+set -e
+cd "$(dirname "$0")/.."
+
+UPDATE=0
+if [ "$1" = "--update" ]; then
+    UPDATE=1
+    shift
+fi
+BINARY=${1:-build/uci}
+BASELINE=scripts/bench_baseline.txt
+NPS_TOLERANCE=${NPS_TOLERANCE:-5}
+
+OUTPUT=$(mktemp)
+trap 'rm -f "$OUTPUT"' EXIT
+"$BINARY" bench search > "$OUTPUT"
+
+if [ $UPDATE = 1 ]; then
+    cp "$OUTPUT" "$BASELINE"
+    echo "Baseline written to $BASELINE"
+    exit 0
+fi
+if [ ! -f "$BASELINE" ]; then
+    echo "No baseline $BASELINE: create one with scripts/regression.sh" \
+         "--update on the reference machine" >&2
+    exit 1
+fi
+
+awk -v tolerance="$NPS_TOLERANCE" '
+    # the baseline: "position <n> bestmove <move> nodes <n> nps <n>"
+    FNR == NR {
+        if ($1 == "position") {
+            move[$2] = $4
+            nodes[$2] = $6
+        } else if ($1 == "total") {
+            base_nps = $5
+        }
+        next
+    }
+    $1 == "position" {
+        if (!($2 in move)) {
+            print "position " $2 ": not in the baseline"
+            failed = 1
+        } else if ($4 != move[$2] || $6 != nodes[$2]) {
+            print "position " $2 ": bestmove " $4 " nodes " $6 \
+                  ", baseline bestmove " move[$2] " nodes " nodes[$2]
+            failed = 1
+        }
+    }
+    $1 == "total" {
+        change = base_nps ? ($5 - base_nps) * 100 / base_nps : 0
+        printf "nps %d, baseline %d (%+.1f%%)\n", $5, base_nps, change
+        if (change < -tolerance) {
+            print "nps dropped by more than " tolerance "%"
+            failed = 1
+        }
+    }
+    END {
+        if (failed) {
+            print "FAILED"
+            exit 1
+        }
+        print "OK"
+    }
+' "$BASELINE" "$OUTPUT"
@@ -0,0 +1,302 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "annotate.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "lan.h"
+
+namespace chessUCI {
+
+namespace annotate {
+
+namespace {
+    /** The longest line written, as recommended by the PGN standard. */
+    const int MAX_LINE_LENGTH = 79;
+
+    /** The search of each ply when no limit is given. */
+    const uint64_t DEFAULT_NODES = 100000;
+
+    /** Writes whitespace-separated tokens, wrapping long lines. */
+    class TokenWriter {
+     private:
+        std::ostream& out;
+        int column;
+
+     public:
+        explicit TokenWriter(std::ostream& out) : out(out), column(0) {}
+
+        void write(const std::string& token) {
+            int length = token.size();
+            if (column > 0 && column + 1 + length > MAX_LINE_LENGTH) {
+                out << "\n";
+                column = 0;
+            } else if (column > 0) {
+                out << " ";
+                column++;
+            }
+            out << token;
+            column += length;
+        }
+
+        void endLine() {
+            out << "\n";
+            column = 0;
+        }
+    };
+
+    /** The full move number of a FEN, 1 for the starting position. */
+    int fullmove_number(const std::string& fen) {
+        std::istringstream ss(fen);
+        std::string field;
+        int number = 1;
+        for (int i = 0; i < 6 && ss >> field; i++) {
+            if (i == 5) number = std::max(1, std::atoi(field.c_str()));
+        }
+        return number;
+    }
+
+    /** A comment with the score (from white's point of view) and best move. */
+    std::string eval_comment(const SearchInfo& info, chessCore::move_t best,
+                             bool white_to_move) {
+        std::string eval;
+        if (info.isMate()) {
+            int mate = white_to_move ? info.mateIn() : -info.mateIn();
+            eval = "#" + std::to_string(mate);
+        } else {
+            char buf[16];
+            int score = white_to_move ? info.score : -info.score;
+            std::snprintf(buf, sizeof(buf), "%.2f", score / 100.0);
+            eval = buf;
+        }
+        return "{[%eval " + eval + "," + std::to_string(info.depth) +
+               "] best " + move_to_string(best) + "}";
+    }
+
+    /**
+     *  Convert a move in SAN and check that it's legal, by matching it against
+     *  the legal moves the same way as UCI moves.
+     */
+    bool parse_san(chessCore::Board board, const std::string& san,
+                   chessCore::move_t* move) {
+        lan_buffer buf;
+        int length = format_lan(board.move_from_SAN(san), buf);
+        return parse_lan(board, buf, length, move);
+    }
+
+    /** Read a positive number argument. */
+    bool parse_number(const std::string& arg, uint64_t* number) {
+        if (arg.empty() || arg.size() > 18 ||
+            arg.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        *number = std::stoull(arg);
+        return true;
+    }
+}   // namespace
+
+AnnotateSettings::AnnotateSettings() {
+    threads = std::max<int>(1, std::thread::hardware_concurrency());
+    hash = 16;
+}
+
+bool annotateGame(Engine& engine, const PgnGame& game,
+                  const SearchLimits& limits, std::ostream& out) {
+    for (const auto& tag : game.tags) {
+        out << "[" << tag.first << " \"";
+        for (char c : tag.second) {
+            if (c == '"' || c == '\\') out << '\\';
+            out << c;
+        }
+        out << "\"]\n";
+    }
+    out << "\n";
+
+    std::string fen = game.tag("FEN");
+    engine.newGame();
+    engine.setPosition(fen.empty() ? "startpos" : fen, nullptr, 0);
+    int move_number = fen.empty() ? 1 : fullmove_number(fen);
+
+    TokenWriter writer(out);
+    bool legal = true;
+    bool first = true;
+    for (const std::string& san : game.moves) {
+        chessCore::Board board = engine.getBoard();
+        bool white_to_move = board.getSide() == chessCore::white;
+        chessCore::move_t move;
+        if (!parse_san(board, san, &move)) {
+            writer.write("{illegal move " + san + "}");
+            legal = false;
+            break;
+        }
+
+        SearchInfo last_info;
+        chessCore::move_t best_move;
+        engine.go(limits,
+                  [&](const SearchInfo& info) {
+                      if (info.string.empty()) last_info = info;
+                  },
+                  [&](chessCore::move_t best, chessCore::move_t) {
+                      best_move = best;
+                  });
+        engine.wait();
+
+        if (white_to_move) {
+            writer.write(std::to_string(move_number) + ".");
+        } else if (first) {
+            writer.write(std::to_string(move_number) + "...");
+        }
+        writer.write(san);
+        if (best_move != chessCore::move_t()) {
+            writer.write(eval_comment(last_info, best_move, white_to_move));
+        }
+
+        engine.makeMove(move);
+        if (!white_to_move) move_number++;
+        first = false;
+    }
+
+    writer.write(game.result.empty() ? "*" : game.result);
+    writer.endLine();
+    out << "\n";
+    return legal;
+}
+
+int annotateStream(std::istream& in, std::ostream& out, std::ostream& err,
+                   const AnnotateSettings& settings) {
+    int num_threads = std::max(settings.threads, 1);
+    // bounds the games read but not yet written, however slow one of them is
+    const int max_in_flight = 2 * num_threads;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::queue<std::pair<int, PgnGame>> jobs;
+    std::map<int, std::string> finished;
+    int num_read = 0;
+    int next_to_write = 0;
+    bool end_of_input = false;
+
+    auto work = [&]() {
+        Engine engine;
+        engine.setThreads(1);
+        engine.setHashSize(settings.hash);
+
+        while (true) {
+            std::pair<int, PgnGame> job;
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                cv.wait(lock, [&]() { return !jobs.empty() || end_of_input; });
+                if (jobs.empty()) return;
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+
+            std::ostringstream text;
+            bool legal = annotateGame(engine, job.second, settings.limits,
+                                      text);
+
+            std::lock_guard<std::mutex> lock{mutex};
+            if (!legal) err << "Illegal move in game " << job.first + 1 << "\n";
+            finished[job.first] = text.str();
+            while (!finished.empty() &&
+                   finished.begin()->first == next_to_write) {
+                out << finished.begin()->second;
+                finished.erase(finished.begin());
+                next_to_write++;
+            }
+            out.flush();
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) threads.emplace_back(work);
+
+    PgnReader reader(in);
+    PgnGame game;
+    while (reader.next(&game)) {
+        std::unique_lock<std::mutex> lock{mutex};
+        cv.wait(lock, [&]() {
+            return num_read - next_to_write < max_in_flight;
+        });
+        jobs.emplace(num_read++, std::move(game));
+        cv.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        end_of_input = true;
+    }
+    cv.notify_all();
+
+    for (std::thread& thread : threads) thread.join();
+    return num_read;
+}
+
+int run(const std::vector<std::string>& args, std::ostream& out,
+        std::ostream& err) {
+    if (args.empty()) {
+        err << "Usage: uci annotate <file.pgn> [nodes <n>] [movetime <ms>] "
+               "[depth <plies>] [threads <n>] [hash <mb>]\n";
+        return 1;
+    }
+
+    AnnotateSettings settings;
+    for (size_t i = 1; i < args.size(); i += 2) {
+        uint64_t number;
+        if (i + 1 >= args.size() || !parse_number(args[i + 1], &number)) {
+            err << "Invalid argument: " << args[i] << "\n";
+            return 1;
+        }
+        if (args[i] == "nodes") {
+            settings.limits.nodes = number;
+        } else if (args[i] == "movetime") {
+            settings.limits.movetime = number;
+        } else if (args[i] == "depth") {
+            settings.limits.depth = std::min<uint64_t>(number, MAX_PLY - 1);
+        } else if (args[i] == "threads") {
+            settings.threads = number;
+        } else if (args[i] == "hash") {
+            settings.hash = number;
+        } else {
+            err << "Unknown argument: " << args[i] << "\n";
+            return 1;
+        }
+    }
+    if (!settings.limits.nodes && !settings.limits.movetime &&
+        !settings.limits.depth) {
+        settings.limits.nodes = DEFAULT_NODES;
+    }
+
+    if (args[0] == "-") {
+        annotateStream(std::cin, out, err, settings);
+        return 0;
+    }
+    std::ifstream file(args[0]);
+    if (!file) {
+        err << "Cannot open " << args[0] << "\n";
+        return 1;
+    }
+    annotateStream(file, out, err, settings);
+    return 0;
+}
+
+}   // namespace annotate
+
+}   // namespace chessUCI
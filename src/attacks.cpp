@@ -0,0 +1,219 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "attacks.h"
+
+#include <mutex>
+
+#ifdef ATTACKS_X86
+#include <cpuid.h>
+#endif
+
+namespace chessUCI {
+
+namespace attacks {
+
+SquareTable rook_magic[64];
+SquareTable bishop_magic[64];
+SquareTable rook_pext[64];
+SquareTable bishop_pext[64];
+
+namespace {
+    /** The number of entries of all the rook and bishop tables. */
+    const int ROOK_TABLE_SIZE = 102400;
+    const int BISHOP_TABLE_SIZE = 5248;
+
+    bitboard rook_magic_table[ROOK_TABLE_SIZE];
+    bitboard bishop_magic_table[BISHOP_TABLE_SIZE];
+    bitboard rook_pext_table[ROOK_TABLE_SIZE];
+    bitboard bishop_pext_table[BISHOP_TABLE_SIZE];
+
+    std::once_flag init_flag;
+    Backend best_backend = backend_magic;
+
+    const int ROOK_DIRECTIONS[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    const int BISHOP_DIRECTIONS[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+    /** Walk the rays from a square until they leave the board or hit. */
+    bitboard slow_attacks(const int directions[4][2], int square,
+                          bitboard occupied) {
+        bitboard attacks = 0;
+        for (int d = 0; d < 4; d++) {
+            int file = square % 8 + directions[d][0];
+            int rank = square / 8 + directions[d][1];
+            while (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+                bitboard bit = bitboard{1} << (rank * 8 + file);
+                attacks |= bit;
+                if (occupied & bit) break;
+                file += directions[d][0];
+                rank += directions[d][1];
+            }
+        }
+        return attacks;
+    }
+
+    /** PEXT without BMI2, to build the tables on any CPU. */
+    uint64_t soft_pext(uint64_t value, uint64_t mask) {
+        uint64_t result = 0;
+        for (uint64_t bit = 1; mask; bit <<= 1, mask &= mask - 1) {
+            if (value & mask & -mask) result |= bit;
+        }
+        return result;
+    }
+
+    int popcount(bitboard b) {
+        int count = 0;
+        for (; b; b &= b - 1) count++;
+        return count;
+    }
+
+    /**
+     *  The magic multipliers of each square, found by trying sparse random
+     *  numbers until one maps every occupancy of the square to an index that
+     *  doesn't clash with a different attack set.
+     */
+    const bitboard ROOK_MAGICS[64] = {
+        0x0a80004000801220ULL, 0x8040004010002008ULL, 0x2080200010008008ULL,
+        0x1100100008210004ULL, 0xc200209084020008ULL, 0x2100010004000208ULL,
+        0x0400081000822421ULL, 0x0200010422048844ULL, 0x0800800080400024ULL,
+        0x0001402000401000ULL, 0x3000801000802001ULL, 0x4400800800100083ULL,
+        0x0904802402480080ULL, 0x4040800400020080ULL, 0x0018808042000100ULL,
+        0x4040800080004100ULL, 0x0040048001458024ULL, 0x00a0004000205000ULL,
+        0x3100808010002000ULL, 0x4825010010000820ULL, 0x5004808008000401ULL,
+        0x2024818004000a00ULL, 0x0005808002000100ULL, 0x2100060004806104ULL,
+        0x0080400880008421ULL, 0x4062220600410280ULL, 0x010a004a00108022ULL,
+        0x0000100080080080ULL, 0x0021000500080010ULL, 0x0044000202001008ULL,
+        0x0000100400080102ULL, 0xc020128200040545ULL, 0x0080002000400040ULL,
+        0x0000804000802004ULL, 0x0000120022004080ULL, 0x010a386103001001ULL,
+        0x9010080080800400ULL, 0x8440020080800400ULL, 0x0004228824001001ULL,
+        0x000000490a000084ULL, 0x0080002000504000ULL, 0x200020005000c000ULL,
+        0x0012088020420010ULL, 0x0010010080080800ULL, 0x0085001008010004ULL,
+        0x0002000204008080ULL, 0x0040413002040008ULL, 0x0000304081020004ULL,
+        0x0080204000800080ULL, 0x3008804000290100ULL, 0x1010100080200080ULL,
+        0x2008100208028080ULL, 0x5000850800910100ULL, 0x8402019004680200ULL,
+        0x0120911028020400ULL, 0x0000008044010200ULL, 0x0020850200244012ULL,
+        0x0020850200244012ULL, 0x0000102001040841ULL, 0x140900040a100021ULL,
+        0x000200282410a102ULL, 0x000200282410a102ULL, 0x000200282410a102ULL,
+        0x4048240043802106ULL
+    };
+
+    const bitboard BISHOP_MAGICS[64] = {
+        0x40106000a1160020ULL, 0x0020010250810120ULL, 0x2010010220280081ULL,
+        0x002806004050c040ULL, 0x0002021018000000ULL, 0x2001112010000400ULL,
+        0x0881010120218080ULL, 0x1030820110010500ULL, 0x0000120222042400ULL,
+        0x2000020404040044ULL, 0x8000480094208000ULL, 0x0003422a02000001ULL,
+        0x000a220210100040ULL, 0x8004820202226000ULL, 0x0018234854100800ULL,
+        0x0100004042101040ULL, 0x0004001004082820ULL, 0x0010000810010048ULL,
+        0x1014004208081300ULL, 0x2080818802044202ULL, 0x0040880c00a00100ULL,
+        0x0080400200522010ULL, 0x0001000188180b04ULL, 0x0080249202020204ULL,
+        0x1004400004100410ULL, 0x00013100a0022206ULL, 0x2148500001040080ULL,
+        0x4241080011004300ULL, 0x4020848004002000ULL, 0x10101380d1004100ULL,
+        0x0008004422020284ULL, 0x01010a1041008080ULL, 0x0808080400082121ULL,
+        0x0808080400082121ULL, 0x0091128200100c00ULL, 0x0202200802010104ULL,
+        0x8c0a020200440085ULL, 0x01a0008080b10040ULL, 0x0889520080122800ULL,
+        0x100902022202010aULL, 0x04081a0816002000ULL, 0x0000681208005000ULL,
+        0x8170840041008802ULL, 0x0a00004200810805ULL, 0x0830404408210100ULL,
+        0x2602208106006102ULL, 0x1048300680802628ULL, 0x2602208106006102ULL,
+        0x0602010120110040ULL, 0x0941010801043000ULL, 0x000040440a210428ULL,
+        0x0008240020880021ULL, 0x0400002012048200ULL, 0x00ac102001210220ULL,
+        0x0220021002009900ULL, 0x84440c080a013080ULL, 0x0001008044200440ULL,
+        0x0004c04410841000ULL, 0x2000500104011130ULL, 0x1a0c010011c20229ULL,
+        0x0044800112202200ULL, 0x0434804908100424ULL, 0x0300404822c08200ULL,
+        0x48081010008a2a80ULL
+    };
+
+    /** Fill the magic and PEXT tables of one kind of slider. */
+    void build(const int directions[4][2], const bitboard* magics,
+               SquareTable* magic_squares, bitboard* magic_table,
+               SquareTable* pext_squares, bitboard* pext_table) {
+        const bitboard RANK_EDGES = 0xff000000000000ffULL;
+        const bitboard FILE_EDGES = 0x8181818181818181ULL;
+        size_t offset = 0;
+
+        for (int square = 0; square < 64; square++) {
+            bitboard rank = 0xffULL << (square / 8 * 8);
+            bitboard file = 0x0101010101010101ULL << (square % 8);
+            bitboard edges = (RANK_EDGES & ~rank) | (FILE_EDGES & ~file);
+            bitboard mask = slow_attacks(directions, square, 0) & ~edges;
+            unsigned bits = popcount(mask);
+
+            SquareTable& m = magic_squares[square];
+            m.mask = mask;
+            m.magic = magics[square];
+            m.shift = 64 - bits;
+            m.attacks = magic_table + offset;
+
+            SquareTable& p = pext_squares[square];
+            p.mask = mask;
+            p.magic = 0;
+            p.shift = 64 - bits;
+            p.attacks = pext_table + offset;
+
+            // every subset of the mask, by the Carry-Rippler trick
+            bitboard occupied = 0;
+            do {
+                bitboard attacks = slow_attacks(directions, square, occupied);
+                magic_table[offset + ((occupied * m.magic) >> m.shift)] =
+                        attacks;
+                pext_table[offset + soft_pext(occupied, mask)] = attacks;
+                occupied = (occupied - mask) & mask;
+            } while (occupied);
+            offset += size_t{1} << bits;
+        }
+    }
+
+    /** Whether PEXT is implemented in hardware rather than microcode. */
+    bool fast_pext() {
+#ifdef ATTACKS_X86
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx)) return false;
+        // "AuthenticAMD"
+        bool amd = ebx == 0x68747541 && edx == 0x69746e65 &&
+                   ecx == 0x444d4163;
+        if (!amd) return true;
+
+        __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+        unsigned family = (eax >> 8) & 0xf;
+        if (family == 0xf) family += (eax >> 20) & 0xff;
+        return family >= 0x19;
+#else
+        return false;
+#endif
+    }
+}   // namespace
+
+void init() {
+    std::call_once(init_flag, []() {
+        build(ROOK_DIRECTIONS, ROOK_MAGICS, rook_magic, rook_magic_table,
+              rook_pext, rook_pext_table);
+        build(BISHOP_DIRECTIONS, BISHOP_MAGICS, bishop_magic,
+              bishop_magic_table, bishop_pext, bishop_pext_table);
+        best_backend = pextSupported() && fast_pext() ? backend_pext
+                                                      : backend_magic;
+    });
+}
+
+bool pextSupported() {
+#ifdef ATTACKS_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("bmi2");
+#else
+    return false;
+#endif
+}
+
+Backend bestBackend() {
+    return best_backend;
+}
+
+const char* backendName(Backend backend) {
+    return backend == backend_pext ? "pext" : "magic";
+}
+
+}   // namespace attacks
+
+}   // namespace chessUCI
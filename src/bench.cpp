@@ -0,0 +1,865 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "attacks.h"
+#include "engine.h"
+#include "history.h"
+#include "interface.h"
+#include "lan.h"
+#include "matesearch.h"
+#include "nnue.h"
+#include "position.h"
+
+namespace chessUCI {
+
+namespace bench {
+
+namespace {
+    /** A short opening line, so that every query carries a few moves. */
+    const std::vector<std::string> OPENING = {
+        "e2e4", "e7e5", "g1f3", "b8c6", "f1b5", "a7a6", "b5a4", "g8f6"
+    };
+
+    /** The positions searched by \ref search. */
+    const std::vector<std::string> SEARCH_SUITE = {
+        "startpos",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - "
+        "0 10",
+        "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+        "8/8/8/4k3/8/8/4P3/4K3 w - - 0 1"
+    };
+
+    /** A mate puzzle: a position and the length of its shortest mate. */
+    struct MatePuzzle {
+        const char* fen;
+        int moves;
+    };
+
+    /** The puzzles solved by \ref mate. */
+    const MatePuzzle MATE_SUITE[] = {
+        {"6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1", 1},
+        {"k7/8/1K6/8/8/8/8/7R w - - 0 1", 1},
+        {"r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4",
+         1},
+        {"r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq - 1 1",
+         2},
+        {"1rb4r/pkPp3p/1b1P3n/1Q6/N3Pp2/8/P1P3PP/7K w - - 1 1", 2},
+        {"r1b1kb1r/pppp1ppp/5q2/4n3/3KP3/2N3PN/PPP4P/R1BQ1B1R b kq - 0 1", 3}
+    };
+
+    /** A position with the leaf counts of its move tree, from depth 1. */
+    struct PerftPosition {
+        const char* fen;
+        /** The depth counted by default. */
+        int depth;
+        std::vector<uint64_t> leaves;
+    };
+
+    /** The positions counted by \ref moveGeneration. */
+    const PerftPosition PERFT_SUITE[] = {
+        {"startpos", 5,
+         {20, 400, 8902, 197281, 4865609, 119060324, 3195901860ULL}},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - "
+         "0 1", 4, {48, 2039, 97862, 4085603, 193690690, 8031647685ULL}},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6,
+         {14, 191, 2812, 43238, 674624, 11030083, 178633661}},
+        {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+         5, {6, 264, 9467, 422333, 15833292, 706045033}},
+        {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4,
+         {44, 1486, 62379, 2103487, 89941194}},
+        {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - "
+         "0 10", 4, {46, 2079, 89890, 3894594, 164075551, 6923051137ULL}}
+    };
+
+    /** Count the leaves of the move tree of the core's board. */
+    uint64_t core_perft(chessCore::Board& board, int depth) {
+        chessCore::move_t moves[MAX_MOVES];
+        int num_moves = board.getAllLegalMoves(moves);
+        if (depth <= 1) return num_moves;
+        uint64_t leaves = 0;
+        for (int i = 0; i < num_moves; i++) {
+            chessCore::Board child = board;
+            child.doMoveInPlace(moves[i]);
+            leaves += core_perft(child, depth - 1);
+        }
+        return leaves;
+    }
+
+    /** A simple deterministic random number generator. */
+    uint64_t next_random(uint64_t* state) {
+        *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return *state >> 33;
+    }
+
+    /** Play a pseudo-random game from the starting position. */
+    std::vector<chessCore::move_t> random_game(int length, uint64_t seed) {
+        std::vector<chessCore::move_t> game;
+        chessCore::Board board;
+        for (int ply = 0; ply < length; ply++) {
+            chessCore::move_t moves[MAX_MOVES];
+            int num_moves = board.getAllLegalMoves(moves);
+            if (num_moves == 0) break;
+            game.push_back(moves[next_random(&seed) % num_moves]);
+            board.doMoveInPlace(game.back());
+        }
+        return game;
+    }
+
+    /** Look up the attacks of a rook and a bishop on every occupancy. */
+    template <typename Attacks>
+    uint64_t lookup_loop(const std::vector<uint64_t>& occupancies,
+                         int num_lookups) {
+        uint64_t checksum = 0;
+        for (int i = 0; i < num_lookups; i++) {
+            uint64_t occupied = occupancies[i & (occupancies.size() - 1)];
+            checksum += Attacks::rook(i & 63, occupied) ^
+                        Attacks::bishop(i & 63, occupied);
+        }
+        return checksum;
+    }
+
+    /** The PEXT loop, compiled for BMI2 so that PEXT is inlined. */
+#ifdef ATTACKS_X86
+    __attribute__((target("bmi2"), flatten))
+#endif
+    uint64_t pext_lookup_loop(const std::vector<uint64_t>& occupancies,
+                              int num_lookups) {
+        return lookup_loop<attacks::PextAttacks>(occupancies, num_lookups);
+    }
+
+    double elapsedMicros(std::chrono::steady_clock::time_point start) {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::chrono::duration_cast<std::chrono::duration<double,
+                                          std::micro>>(elapsed).count();
+    }
+}   // namespace
+
+void apiOverhead(std::ostream& out, int num_queries) {
+    // typed path: moves are converted once, results arrive as structs
+    std::vector<chessCore::move_t> moves;
+    chessCore::Board scratch;
+    for (const std::string& move_str : OPENING) {
+        chessCore::move_t move;
+        if (!parse_lan(scratch, move_str, &move)) break;
+        moves.push_back(move);
+        scratch.doMoveInPlace(move);
+    }
+
+    Engine engine;
+    SearchLimits limits;
+    limits.depth = 1;
+    uint64_t checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_queries; i++) {
+        engine.setPosition("startpos", moves.data(), moves.size());
+        engine.go(limits,
+                  [&](const SearchInfo& info) { checksum += info.nodes; },
+                  [&](chessCore::move_t best, chessCore::move_t) {
+                      checksum += best.to_sq();
+                  });
+        engine.wait();
+    }
+    double api_time = elapsedMicros(start);
+
+    // text path: format commands, tokenise them, re-parse the output
+    std::stringstream in, uci_out, err;
+    chessInterface interface(in, uci_out, err);
+    std::stringstream position;
+    position << "position startpos moves";
+    for (const std::string& move_str : OPENING) position << " " << move_str;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_queries; i++) {
+        interface.parseMessage(position.str());
+        interface.parseMessage("go depth 1");
+        interface.getEngine().wait();
+
+        std::string line;
+        while (std::getline(uci_out, line)) {
+            std::stringstream ss(line);
+            std::string token;
+            while (ss >> token) {
+                if (token == "nodes") {
+                    ss >> token;
+                    checksum += std::stoull(token);
+                }
+            }
+        }
+        uci_out.clear();
+        uci_out.str("");
+    }
+    double uci_time = elapsedMicros(start);
+
+    out << "api overhead (" << num_queries << " queries, checksum "
+        << checksum << ")\n"
+        << "  engine api: " << api_time / num_queries << " us/query\n"
+        << "  uci text:   " << uci_time / num_queries << " us/query\n";
+}
+
+void repetition(std::ostream& out, int game_length) {
+    std::vector<chessCore::move_t> game = random_game(game_length, 1);
+    chessCore::Board board;
+    KeyHistory history;
+    history.push(board.getHashValue(), board.getHalfMoveClock());
+    for (chessCore::move_t move : game) {
+        board.doMoveInPlace(move);
+        history.push(board.getHashValue(), board.getHalfMoveClock());
+    }
+    // the game keys, latest first, for the naive scan
+    std::vector<uint64_t> naive;
+    {
+        KeyHistory copy;
+        copy.reset(history, 0);
+        while (copy.size()) {
+            naive.push_back(copy.top());
+            copy.pop();
+        }
+    }
+
+    // simulate search nodes: mostly new keys, now and then a game position
+    const int num_nodes = 10000000;
+    uint64_t seed = 2;
+    std::vector<uint64_t> node_keys(4096);
+    for (uint64_t& key : node_keys) {
+        key = next_random(&seed) << 32 | next_random(&seed);
+        if (key % 16 == 0) key = naive[std::min<size_t>(1, naive.size() - 1)];
+    }
+
+    KeyHistory search;
+    search.reset(history, 1);
+    int found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_nodes; i++) {
+        search.push(node_keys[i % node_keys.size()], i % 100);
+        found += search.isRepetition();
+        search.pop();
+    }
+    double history_time = elapsedMicros(start);
+
+    // naive: scan every position of the game
+    int naive_found = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_nodes; i++) {
+        uint64_t key = node_keys[i % node_keys.size()];
+        for (uint64_t old_key : naive) {
+            if (old_key == key) {
+                naive_found++;
+                break;
+            }
+        }
+    }
+    double naive_time = elapsedMicros(start);
+
+    // a real search with the whole game behind the root
+    Engine engine;
+    SearchLimits limits;
+    limits.depth = 5;
+    uint64_t nps = 0;
+    engine.setPosition("startpos", game.data(), game.size());
+    engine.go(limits, [&](const SearchInfo& info) { nps = info.nps; },
+              nullptr);
+    engine.wait();
+
+    out << "repetition (" << game.size() << "-ply game, "
+        << num_nodes << " nodes, " << found << "/" << naive_found
+        << " repetitions)\n"
+        << "  key history: " << history_time * 1000 / num_nodes
+        << " ns/node\n"
+        << "  naive scan:  " << naive_time * 1000 / num_nodes
+        << " ns/node\n"
+        << "  search at the end of the game: " << nps << " nps\n";
+}
+
+void lanCodec(std::ostream& out, int num_positions) {
+    // positions along pseudo-random games, with all their legal moves
+    std::vector<chessCore::Board> boards;
+    std::vector<std::vector<chessCore::move_t>> legal_moves;
+    uint64_t seed = 3;
+    while (static_cast<int>(boards.size()) < num_positions) {
+        chessCore::Board board;
+        for (int ply = 0; ply < 80; ply++) {
+            chessCore::move_t moves[MAX_MOVES];
+            int num_moves = board.getAllLegalMoves(moves);
+            if (num_moves == 0) break;
+            boards.push_back(board);
+            legal_moves.emplace_back(moves, moves + num_moves);
+            board.doMoveInPlace(moves[next_random(&seed) % num_moves]);
+        }
+    }
+
+    std::vector<std::vector<std::string>> strings(boards.size());
+    uint64_t num_moves = 0;
+    for (size_t i = 0; i < boards.size(); i++) {
+        for (chessCore::move_t move : legal_moves[i]) {
+            strings[i].push_back(move_to_string(move));
+        }
+        num_moves += legal_moves[i].size();
+    }
+
+    const int repeats = 20;
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++) {
+        for (size_t i = 0; i < boards.size(); i++) {
+            for (const std::string& move_str : strings[i]) {
+                chessCore::move_t move;
+                checksum += parse_lan(boards[i], move_str, &move);
+            }
+        }
+    }
+    double parse_time = elapsedMicros(start);
+
+    lan_buffer buf;
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats * 100; r++) {
+        for (const auto& moves : legal_moves) {
+            for (chessCore::move_t move : moves) {
+                checksum += format_lan(move, buf) + buf[2];
+            }
+        }
+    }
+    double format_time = elapsedMicros(start);
+
+    out << "lan codec (" << num_moves << " moves in " << boards.size()
+        << " positions, checksum " << checksum << ")\n"
+        << "  parsed:    " << num_moves * repeats / parse_time * 1e6
+        << " moves/s\n"
+        << "  formatted: " << num_moves * repeats * 100 / format_time * 1e6
+        << " moves/s\n";
+}
+
+void treeReuse(std::ostream& out, int num_moves, int depth) {
+    SearchLimits limits;
+    limits.depth = depth;
+
+    // both modes search the same game, the one the engine plays cold
+    std::vector<chessCore::move_t> game;
+    double times[2] = {0, 0};
+    uint64_t nodes[2] = {0, 0};
+    for (int reuse = 0; reuse < 2; reuse++) {
+        Engine engine;
+        engine.setOption("TreeReuse", reuse ? "true" : "false");
+        engine.waitForOptions();
+
+        for (int ply = 0; ply < num_moves; ply++) {
+            if (reuse && ply >= static_cast<int>(game.size())) break;
+            engine.setPosition("startpos", game.data(), ply);
+
+            chessCore::move_t best_move;
+            uint32_t time = 0;
+            uint64_t move_nodes = 0;
+            engine.go(limits,
+                      [&](const SearchInfo& info) {
+                          time = info.time;
+                          move_nodes = info.nodes;
+                      },
+                      [&](chessCore::move_t best, chessCore::move_t) {
+                          best_move = best;
+                      });
+            engine.wait();
+            if (best_move == chessCore::move_t()) break;
+            if (!reuse) game.push_back(best_move);
+
+            // the first move has nothing to reuse
+            if (ply == 0) continue;
+            times[reuse] += time;
+            nodes[reuse] += move_nodes;
+        }
+    }
+
+    int counted = std::max<int>(game.size() - 1, 1);
+    out << "tree reuse (" << game.size() << "-ply game, depth " << depth
+        << ")\n"
+        << "  cold:  " << times[0] / counted << " ms/move, "
+        << nodes[0] / counted << " nodes/move\n"
+        << "  reuse: " << times[1] / counted << " ms/move, "
+        << nodes[1] / counted << " nodes/move\n";
+}
+
+void search(std::ostream& out, int depth) {
+    Engine engine;
+    engine.setOption("Deterministic", "true");
+    engine.waitForOptions();
+
+    SearchLimits limits;
+    limits.depth = depth;
+    uint64_t total_nodes = 0;
+    double total_time = 0;
+
+    out << "search (" << SEARCH_SUITE.size() << " positions, depth "
+        << depth << ")\n";
+    for (size_t i = 0; i < SEARCH_SUITE.size(); i++) {
+        engine.newGame();
+        engine.setPosition(SEARCH_SUITE[i], nullptr, 0);
+
+        chessCore::move_t best_move;
+        auto start = std::chrono::steady_clock::now();
+        engine.go(limits, nullptr,
+                  [&](chessCore::move_t best, chessCore::move_t) {
+                      best_move = best;
+                  });
+        engine.wait();
+        double time = elapsedMicros(start);
+        uint64_t searched = engine.totalNodes();
+        total_nodes += searched;
+        total_time += time;
+
+        out << "position " << i + 1 << " bestmove "
+            << move_to_string(best_move) << " nodes " << searched
+            << " nps " << static_cast<uint64_t>(searched / time * 1e6)
+            << "\n";
+    }
+    out << "total nodes " << total_nodes << " nps "
+        << static_cast<uint64_t>(total_nodes / total_time * 1e6) << "\n";
+}
+
+void timeToDepth(std::ostream& out, int depth) {
+    Engine engine;
+    engine.setOption("Deterministic", "true");
+    engine.waitForOptions();
+
+    SearchLimits limits;
+    limits.depth = depth;
+    uint64_t total_nodes = 0;
+    double total_time = 0;
+
+    out << "depth (" << SEARCH_SUITE.size() << " positions, depth " << depth
+        << ")\n";
+    for (size_t i = 0; i < SEARCH_SUITE.size(); i++) {
+        engine.newGame();
+        engine.setPosition(SEARCH_SUITE[i], nullptr, 0);
+
+        auto start = std::chrono::steady_clock::now();
+        engine.go(limits, nullptr, nullptr);
+        engine.wait();
+        double time = elapsedMicros(start);
+        total_nodes += engine.totalNodes();
+        total_time += time;
+
+        out << "  position " << i + 1 << ": " << engine.totalNodes()
+            << " nodes, " << time / 1000 << " ms\n";
+    }
+    out << "  total: " << total_nodes << " nodes, " << total_time / 1000
+        << " ms, " << static_cast<uint64_t>(total_nodes / total_time * 1e6)
+        << " nps\n";
+}
+
+void restrictedRoot(std::ostream& out, int depth) {
+    Engine engine;
+    engine.setOption("Deterministic", "true");
+    engine.waitForOptions();
+
+    uint64_t total_nodes[2] = {0, 0};
+    double total_time[2] = {0, 0};
+
+    out << "searchmoves (" << SEARCH_SUITE.size() << " positions, depth "
+        << depth << ")\n";
+    for (size_t i = 0; i < SEARCH_SUITE.size(); i++) {
+        engine.setPosition(SEARCH_SUITE[i], nullptr, 0);
+        chessCore::Board board = engine.getBoard();
+        chessCore::move_t moves[MAX_MOVES];
+        int num_moves = board.getAllLegalMoves(moves);
+        if (num_moves < 2) continue;
+
+        out << "  position " << i + 1 << ":";
+        for (int restricted = 0; restricted < 2; restricted++) {
+            // the last two moves, which the full search tries late
+            SearchLimits limits;
+            limits.depth = depth;
+            if (restricted) {
+                limits.searchmoves.assign(moves + num_moves - 2,
+                                          moves + num_moves);
+            }
+            engine.newGame();
+            engine.setPosition(SEARCH_SUITE[i], nullptr, 0);
+
+            auto start = std::chrono::steady_clock::now();
+            engine.go(limits, nullptr, nullptr);
+            engine.wait();
+            double time = elapsedMicros(start);
+            total_nodes[restricted] += engine.totalNodes();
+            total_time[restricted] += time;
+
+            out << (restricted ? " / " : " ") << engine.totalNodes()
+                << " nodes, " << time / 1000 << " ms";
+        }
+        out << "\n";
+    }
+    out << "  total: all moves " << total_nodes[0] << " nodes, "
+        << total_time[0] / 1000 << " ms / two moves " << total_nodes[1]
+        << " nodes, " << total_time[1] / 1000 << " ms\n";
+}
+
+void evalCache(std::ostream& out, uint64_t nodes) {
+    SearchLimits limits;
+    limits.nodes = nodes;
+    double base_nps = 0;
+
+    out << "eval cache (" << SEARCH_SUITE.size() << " positions, " << nodes
+        << " nodes each)\n";
+    for (int megabytes : {0, 1, 16}) {
+        Engine engine;
+        engine.setOption("Deterministic", "true");
+        engine.setOption("EvalCache", std::to_string(megabytes));
+        engine.waitForOptions();
+
+        uint64_t total_nodes = 0;
+        double total_time = 0;
+        for (const std::string& fen : SEARCH_SUITE) {
+            engine.newGame();
+            engine.setPosition(fen, nullptr, 0);
+            auto start = std::chrono::steady_clock::now();
+            engine.go(limits, nullptr, nullptr);
+            engine.wait();
+            total_time += elapsedMicros(start);
+            total_nodes += engine.totalNodes();
+        }
+
+        double nps = total_nodes / total_time * 1e6;
+        if (megabytes == 0) base_nps = nps;
+        out << "  " << megabytes << " MB: " << static_cast<uint64_t>(nps)
+            << " nps";
+        if (megabytes) out << " (" << (nps / base_nps - 1) * 100 << "%)";
+        out << "\n";
+    }
+}
+
+void mate(std::ostream& out, int repeats) {
+    MateSolver solver;
+    solver.resize(16);
+    auto never = [](uint64_t) { return false; };
+    uint64_t total_nodes = 0;
+    int num_solved = 0;
+
+    out << "mate (" << sizeof(MATE_SUITE) / sizeof(MATE_SUITE[0])
+        << " puzzles, " << repeats << " times)\n";
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++) {
+        solver.clear();
+        for (const MatePuzzle& puzzle : MATE_SUITE) {
+            chessCore::Board board(puzzle.fen);
+            MateResult result = solver.solve(board, puzzle.moves, never);
+            total_nodes += result.nodes;
+            num_solved++;
+            if (r > 0) continue;
+
+            out << "  " << puzzle.fen << ": ";
+            if (result.outcome == MateResult::mate_found) {
+                out << "mate " << result.mate_in;
+                for (chessCore::move_t move : result.pv) {
+                    out << " " << move_to_string(move);
+                }
+            } else {
+                out << "no mate";
+            }
+            out << (result.mate_in == puzzle.moves ? "" : " (WRONG)")
+                << ", " << result.nodes << " nodes\n";
+        }
+    }
+    double time = elapsedMicros(start);
+    out << "  " << num_solved / time * 1e6 << " puzzles/s, "
+        << static_cast<uint64_t>(total_nodes / time * 1e6) << " nodes/s\n";
+}
+
+void slidingAttacks(std::ostream& out, int num_lookups) {
+    auto start = std::chrono::steady_clock::now();
+    attacks::init();
+    double init_time = elapsedMicros(start);
+
+    // sparse random occupancies, a power of two of them
+    std::vector<uint64_t> occupancies(4096);
+    uint64_t seed = 6;
+    for (uint64_t& occupied : occupancies) {
+        occupied = (next_random(&seed) << 32 | next_random(&seed)) &
+                   (next_random(&seed) << 32 | next_random(&seed));
+    }
+
+    out << "attacks (" << num_lookups << " lookups, best backend "
+        << attacks::backendName(attacks::bestBackend()) << ", tables built in "
+        << init_time / 1000 << " ms)\n";
+
+    start = std::chrono::steady_clock::now();
+    uint64_t reference = lookup_loop<attacks::MagicAttacks>(occupancies,
+                                                            num_lookups);
+    double time = elapsedMicros(start);
+    out << "  magic: " << num_lookups / time * 1e6 << " lookups/s\n";
+
+    if (!attacks::pextSupported()) {
+        out << "  pext:  not supported by this CPU\n";
+        return;
+    }
+    start = std::chrono::steady_clock::now();
+    uint64_t checksum = pext_lookup_loop(occupancies, num_lookups);
+    time = elapsedMicros(start);
+    out << "  pext:  " << num_lookups / time * 1e6 << " lookups/s"
+        << (checksum == reference ? "" : " (MISMATCH)") << "\n";
+}
+
+void eval(std::ostream& out, int num_positions,
+          const std::string& eval_file) {
+    nnue::Network network;
+    if (eval_file.empty()) {
+        network.loadRandom(4);
+    } else {
+        std::string error;
+        if (!network.load(eval_file, &error)) {
+            out << "eval: cannot load " << eval_file << ": " << error << "\n";
+            return;
+        }
+    }
+
+    // positions along pseudo-random games, each with the move leading to it
+    std::vector<chessCore::Board> boards;
+    std::vector<nnue::Pieces> pieces;
+    std::vector<nnue::Pieces::Changes> changes;
+    uint64_t seed = 5;
+    while (static_cast<int>(boards.size()) < num_positions) {
+        chessCore::Board board;
+        nnue::Pieces board_pieces;
+        nnue::Pieces::Changes move_changes = {0, 0, {}, {}};
+        for (int ply = 0; ply < 80; ply++) {
+            boards.push_back(board);
+            pieces.push_back(board_pieces);
+            changes.push_back(move_changes);
+
+            chessCore::move_t moves[MAX_MOVES];
+            int num_moves = board.getAllLegalMoves(moves);
+            if (num_moves == 0) break;
+            chessCore::move_t move = moves[next_random(&seed) % num_moves];
+            board.doMoveInPlace(move);
+            board_pieces.doMove(move, &move_changes);
+        }
+    }
+    size_t count = boards.size();
+
+    const int repeats = 20;
+    int64_t classic_checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++) {
+        for (chessCore::Board& board : boards) {
+            classic_checksum += board.evaluate();
+        }
+    }
+    double classic_time = elapsedMicros(start);
+
+    out << "eval (" << count << " positions, "
+        << (eval_file.empty() ? "random network" : eval_file) << ")\n"
+        << "  classical: " << count * repeats / classic_time * 1e6
+        << " evals/s\n";
+
+    std::vector<nnue::Accumulator> accumulators(count);
+    int64_t reference = 0;
+    for (const nnue::Kernel* kernel : nnue::supportedKernels()) {
+        network.setKernel(*kernel);
+        int64_t checksum = 0;
+
+        // from scratch, as at the root of a search
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            for (size_t i = 0; i < count; i++) {
+                network.refresh(pieces[i], &accumulators[i]);
+                checksum += network.evaluate(accumulators[i],
+                                             boards[i].getSide());
+            }
+        }
+        double refresh_time = elapsedMicros(start);
+
+        // from the parent, as inside a search
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            for (size_t i = 1; i < count; i++) {
+                if (changes[i].num_added == 0) continue;
+                network.update(accumulators[i - 1], changes[i],
+                               &accumulators[i]);
+            }
+        }
+        double update_time = elapsedMicros(start);
+
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            for (size_t i = 0; i < count; i++) {
+                checksum += network.evaluate(accumulators[i],
+                                             boards[i].getSide());
+            }
+        }
+        double output_time = elapsedMicros(start);
+
+        if (kernel == nnue::supportedKernels().front()) reference = checksum;
+        out << "  " << kernel->name << ": "
+            << count * repeats / refresh_time * 1e6 << " full evals/s, "
+            << count * repeats / update_time * 1e6 << " updates/s, "
+            << count * repeats / output_time * 1e6 << " outputs/s"
+            << (checksum == reference ? "" : " (MISMATCH)") << "\n";
+    }
+
+    if (eval_file.empty()) return;
+    SearchLimits limits;
+    limits.nodes = 1000000;
+    for (int use_nnue = 0; use_nnue < 2; use_nnue++) {
+        Engine engine;
+        engine.setOption("Deterministic", "true");
+        engine.setOption("EvalFile", use_nnue ? eval_file : "");
+        engine.waitForOptions();
+        engine.setPosition("startpos", nullptr, 0);
+
+        start = std::chrono::steady_clock::now();
+        engine.go(limits, nullptr, nullptr);
+        engine.wait();
+        double time = elapsedMicros(start);
+        out << "  search with " << (use_nnue ? "nnue" : "classical")
+            << ": " << static_cast<uint64_t>(engine.totalNodes() / time * 1e6)
+            << " nps\n";
+    }
+}
+
+void moveGeneration(std::ostream& out, int depth) {
+    // Position's two generators with each backend the CPU can run, then the
+    // core, which has attacks of its own
+    struct Generator {
+        attacks::Backend backend;
+        bool by_playing;
+        bool core;
+    };
+    std::vector<Generator> generators;
+    for (attacks::Backend backend : {attacks::backend_magic,
+                                     attacks::backend_pext}) {
+        if (backend == attacks::backend_pext && !attacks::pextSupported()) {
+            continue;
+        }
+        generators.push_back({backend, false, false});
+        generators.push_back({backend, true, false});
+    }
+    generators.push_back({attacks::bestBackend(), false, true});
+
+    out << "perft (best backend "
+        << attacks::backendName(attacks::bestBackend()) << "):";
+    for (size_t g = 0; g < generators.size(); g++) {
+        const Generator& gen = generators[g];
+        out << (g ? " /" : "") << " ";
+        if (gen.core) {
+            out << "core";
+        } else {
+            out << attacks::backendName(gen.backend)
+                << (gen.by_playing ? " playing each move" : " pin masks");
+        }
+    }
+    out << "\n";
+
+    std::vector<uint64_t> total_leaves(generators.size());
+    std::vector<double> total_time(generators.size());
+    for (const PerftPosition& test : PERFT_SUITE) {
+        int d = depth > 0 ? std::min<int>(depth, test.leaves.size())
+                          : test.depth;
+        uint64_t expected = test.leaves[d - 1];
+
+        out << "  depth " << d << " " << test.fen << "\n   ";
+        for (size_t g = 0; g < generators.size(); g++) {
+            const Generator& gen = generators[g];
+            Position pos;
+            pos.setFen(test.fen);
+            chessCore::Board board = std::string(test.fen) == "startpos" ?
+                                     chessCore::Board() :
+                                     chessCore::Board(test.fen);
+            auto start = std::chrono::steady_clock::now();
+            uint64_t leaves = gen.core ? core_perft(board, d) :
+                              perft(pos, d, gen.backend, gen.by_playing);
+            double time = elapsedMicros(start);
+            total_leaves[g] += leaves;
+            total_time[g] += time;
+            out << (g ? " /" : "") << " " << leaves
+                << (leaves == expected ? "" : " (WRONG)") << " "
+                << static_cast<uint64_t>(leaves / time * 1e6) << " leaves/s";
+        }
+        out << "\n";
+    }
+    out << "  total";
+    for (size_t g = 0; g < generators.size(); g++) {
+        out << (g ? " /" : "") << " "
+            << static_cast<uint64_t>(total_leaves[g] / total_time[g] * 1e6)
+            << " leaves/s";
+    }
+    out << "\n";
+}
+
+int run(const std::vector<std::string>& args, std::ostream& out) {
+    std::string name = args.empty() ? "all" : args[0];
+    bool all = name == "all";
+    bool found = false;
+
+    if (all || name == "api") {
+        apiOverhead(out, 2000);
+        found = true;
+    }
+    if (all || name == "lan") {
+        lanCodec(out, 1000);
+        found = true;
+    }
+    if (all || name == "repetition") {
+        repetition(out, 300);
+        found = true;
+    }
+    if (all || name == "reuse") {
+        treeReuse(out, 40, 6);
+        found = true;
+    }
+    if (all || name == "depth") {
+        timeToDepth(out, 6);
+        found = true;
+    }
+    if (all || name == "searchmoves") {
+        restrictedRoot(out, 6);
+        found = true;
+    }
+    if (all || name == "evalcache") {
+        evalCache(out, 200000);
+        found = true;
+    }
+    if (all || name == "mate") {
+        mate(out, 20);
+        found = true;
+    }
+    if (all || name == "perft") {
+        moveGeneration(out, args.size() > 1 ? std::atoi(args[1].c_str()) : 0);
+        found = true;
+    }
+    if (all || name == "attacks") {
+        slidingAttacks(out, 100000000);
+        found = true;
+    }
+    if (all || name == "eval") {
+        eval(out, 2000, args.size() > 1 ? args[1] : "");
+        found = true;
+    }
+    if (all || name == "search") {
+        search(out, 7);
+        found = true;
+    }
+
+    if (!found) {
+        out << "Unknown benchmark: " << name << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+}   // namespace bench
+
+}   // namespace chessUCI
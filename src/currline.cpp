@@ -0,0 +1,49 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "currline.h"
+
+#include <algorithm>
+
+namespace chessUCI {
+
+SharedLine::SharedLine() {
+    sequence = 0;
+    length = 0;
+    for (std::atomic<uint16_t>& move : moves) move = 0;
+}
+
+void SharedLine::publish(const chessCore::move_t* line, int num_moves) {
+    num_moves = std::min(num_moves, MAX_PLY);
+    uint32_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i = 0; i < num_moves; i++) {
+        moves[i].store(static_cast<uint16_t>(line[i]),
+                       std::memory_order_relaxed);
+    }
+    length.store(static_cast<uint8_t>(num_moves), std::memory_order_relaxed);
+    sequence.store(seq + 2, std::memory_order_release);
+}
+
+int SharedLine::read(chessCore::move_t* line) const {
+    while (true) {
+        uint32_t before = sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        int num_moves = length.load(std::memory_order_relaxed);
+        for (int i = 0; i < num_moves; i++) {
+            line[i] = chessCore::move_t(
+                    moves[i].load(std::memory_order_relaxed));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == before) {
+            return num_moves;
+        }
+    }
+}
+
+}   // namespace chessUCI
@@ -0,0 +1,874 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "attacks.h"
+#include "lan.h"
+#include "trace.h"
+
+namespace chessUCI {
+
+namespace {
+    /**
+     *  How long before the hard deadline the watchdog stops the search, and
+     *  how long it then waits for the search to send its own move.
+     */
+    const uint32_t WATCHDOG_GRACE = 5;
+
+    /**
+     *  The shortest time between two status lines or two writes of the
+     *  metrics file during a search, in milliseconds.
+     */
+    const uint32_t STATUS_INTERVAL = 1000;
+
+    /** The time between two samples of the current lines, in milliseconds. */
+    const uint32_t CURRLINE_INTERVAL = 250;
+
+    /** The longest refutation sent, in plies. */
+    const int REFUTATION_LENGTH = 4;
+
+    /**
+     *  The share of the time budget after which no new iteration is started,
+     *  in percent, by the number of iterations the best move has stayed the
+     *  same. A best move that just changed needs another look.
+     */
+    const int STABLE_STOP_PERCENT[] = {60, 50, 45, 40, 35};
+
+    /** How much later to stop if the best move took few of the nodes. */
+    const int CONTESTED_STOP_PERCENT = 10;
+
+    /** The share of the nodes below which the best move is contested. */
+    const double CONTESTED_SHARE = 0.5;
+}   // namespace
+
+SearchLimits::SearchLimits() {
+    ponder = false;
+    infinite = false;
+    wtime = 0;
+    btime = 0;
+    winc = 0;
+    binc = 0;
+    movestogo = 0;
+    depth = 0;
+    movetime = 0;
+    nodes = 0;
+    mate = 0;
+}
+
+SearchInfo::SearchInfo() {
+    depth = 0;
+    seldepth = 0;
+    time = 0;
+    nodes = 0;
+    nps = 0;
+    score = 0;
+    hashfull = 0;
+    cpuload = 0;
+    currmovenumber = 0;
+}
+
+bool SearchInfo::isMate() const {
+    return std::abs(score) >= MATE_BOUND;
+}
+
+int SearchInfo::mateIn() const {
+    if (score > 0) return (MATE_VALUE - score + 1) / 2;
+    return -(MATE_VALUE + score) / 2;
+}
+
+std::string move_to_string(chessCore::move_t move) {
+    lan_buffer buf;
+    int length = format_lan(move, buf);
+    return std::string(buf, length);
+}
+
+Engine::Engine() : search_memory(mem_search), network_memory(mem_network) {
+    stop_flag = false;
+    pondering = false;
+    running = false;
+    time_budget = 0;
+    hard_deadline = 0;
+    best_move_stability = 0;
+    best_move_sent = false;
+    search_count = 0;
+    total_nodes = 0;
+    search_threads = 1;
+    next_status = 0;
+    next_currline = 0;
+    eval_generation = 0;
+    attacks::init();
+
+    options.addSpin("Hash", &OptionValues::hash, 16, 1, 65536, true);
+    options.addSpin("Threads", &OptionValues::threads, 1, 1, 512, true);
+    options.addCombo("NumaPolicy", &OptionValues::numa_policy, "auto",
+                     {"auto", "interleave", "firsttouch", "none"}, true);
+    options.addSpin("MoveOverhead", &OptionValues::move_overhead, 30, 0, 5000);
+    options.addCheck("TreeReuse", &OptionValues::tree_reuse, true);
+    options.addCheck("Deterministic", &OptionValues::deterministic, false);
+    options.addCheck("UCI_ShowCurrLine", &OptionValues::show_currline, false);
+    options.addCheck("UCI_ShowRefutations", &OptionValues::show_refutations,
+                     false);
+    options.addSpin("MateHash", &OptionValues::mate_hash, 16, 1, 65536,
+                    true);
+    options.addSpin("EvalCache", &OptionValues::eval_cache, 1, 0, 1024,
+                    true);
+    options.addSpin("MemoryBudget", &OptionValues::memory_budget, 0, 0,
+                    1048576, true);
+    options.addSpin("AspirationWindow", &OptionValues::aspiration_window, 25,
+                    0, 1000);
+    options.addSpin("RFPMargin", &OptionValues::rfp_margin, 80, 0, 1000);
+    options.addSpin("RFPDepth", &OptionValues::rfp_depth, 6, 0, 20);
+    options.addSpin("FutilityMargin", &OptionValues::futility_margin, 100, 0,
+                    1000);
+    options.addSpin("FutilityDepth", &OptionValues::futility_depth, 3, 0, 20);
+    options.addSpin("LMRBase", &OptionValues::lmr_base, 75, 0, 500);
+    options.addSpin("LMRDivisor", &OptionValues::lmr_divisor, 225, 100, 1000);
+    options.addSpin("LMRMinDepth", &OptionValues::lmr_min_depth, 3, 0, 20);
+    options.addString("EvalFile", &OptionValues::eval_file, "", true);
+    options.addString("TraceFile", &OptionValues::trace_file,
+                      "strawberry_trace.json");
+    options.addString("StatsFile", &OptionValues::stats_file, "");
+    options.addString("MetricsFile", &OptionValues::metrics_file, "");
+    options.addButton("Clear Hash", [this]() {
+        // queued like other changes, so isready and go wait for it
+        waitForOptions();
+        std::lock_guard<std::mutex> lock{config_mutex};
+        config_thread = std::thread([this]() {
+            stop();
+            wait();
+            tt.clear(topology, numa_policy, workers.size());
+        });
+    });
+
+    const OptionValues& values = options.values();
+    search_options = options.snapshot();
+    numa_policy_from_string(values.numa_policy, &numa_policy);
+    tt.track(&memory);
+    mate_solver.track(&memory);
+    search_memory.attach(&memory);
+    network_memory.attach(&memory);
+    startGame("startpos");
+    createWorkers(values.threads);
+    planMemory(values);
+    resizeHash(true);
+}
+
+Engine::~Engine() {
+    waitForOptions();
+    stop();
+    wait();
+}
+
+void Engine::createWorkers(int num_threads) {
+    workers.clear();
+    for (int i = 0; i < std::max(num_threads, 1); i++) {
+        workers.emplace_back(new SearchWorker(*this, i,
+                                              topology.nodeForThread(i)));
+    }
+    search_memory.set(workers.size() * sizeof(SearchWorker));
+}
+
+void Engine::newGame() {
+    waitForOptions();
+    stop();
+    wait();
+    startGame("startpos");
+    last_pv.clear();
+    tt.newSearch();
+}
+
+void Engine::startGame(std::string fen) {
+    if (fen == "startpos") {
+        board = chessCore::Board();
+    } else {
+        board = chessCore::Board(fen);
+    }
+    game_history.clear();
+    game_history.push(board.getHashValue(), board.getHalfMoveClock());
+    pieces.setFen(fen);
+}
+
+void Engine::playMove(chessCore::move_t move) {
+    board.doMoveInPlace(move);
+    pieces.doMove(move, nullptr);
+    game_history.push(board.getHashValue(), board.getHalfMoveClock());
+}
+
+void Engine::setPosition(std::string fen, const chessCore::move_t* moves,
+                         size_t num_moves) {
+    stop();
+    wait();
+
+    startGame(fen);
+    for (size_t i = 0; i < num_moves; i++) {
+        playMove(moves[i]);
+    }
+}
+
+bool Engine::setPosition(std::string fen,
+                         const std::vector<std::string>& moves) {
+    stop();
+    wait();
+
+    startGame(fen);
+    for (const std::string& move_str : moves) {
+        chessCore::move_t move;
+        if (!parse_lan(board, move_str, &move)) return false;
+        playMove(move);
+    }
+    return true;
+}
+
+void Engine::makeMove(chessCore::move_t move) {
+    stop();
+    wait();
+    playMove(move);
+}
+
+const chessCore::Board& Engine::getBoard() const {
+    return board;
+}
+
+void Engine::setHashSize(size_t megabytes) {
+    setOption("Hash", std::to_string(megabytes));
+    waitForOptions();
+}
+
+void Engine::setThreads(int num_threads) {
+    setOption("Threads", std::to_string(num_threads));
+    waitForOptions();
+}
+
+void Engine::setNumaPolicy(NumaPolicy policy) {
+    setOption("NumaPolicy", numa_policy_to_string(policy));
+    waitForOptions();
+}
+
+bool Engine::setOption(const std::string& name, const std::string& value) {
+    OptionRegistry::SetResult result = options.set(name, value);
+    if (result != OptionRegistry::set_needs_apply) {
+        return result == OptionRegistry::set_ok;
+    }
+
+    // changes are applied in order, one thread at a time
+    waitForOptions();
+    std::lock_guard<std::mutex> lock{config_mutex};
+    config_thread = std::thread(&Engine::applyOptions, this);
+    return true;
+}
+
+void Engine::waitForOptions() {
+    std::lock_guard<std::mutex> lock{config_mutex};
+    if (config_thread.joinable()) config_thread.join();
+}
+
+const OptionRegistry& Engine::getOptions() const {
+    return options;
+}
+
+void Engine::applyOptions() {
+    stop();
+    wait();
+
+    // a setoption may publish a new snapshot while this one is applied
+    std::shared_ptr<const OptionValues> snapshot = options.snapshot();
+    const OptionValues& values = *snapshot;
+    NumaPolicy policy = numa_policy;
+    numa_policy_from_string(values.numa_policy, &policy);
+
+    if (static_cast<size_t>(values.threads) != workers.size()) {
+        createWorkers(values.threads);
+    }
+    if (values.eval_file != network.getPath()) {
+        std::string error;
+        eval_generation++;
+        if (values.eval_file.empty()) {
+            network.unload();
+            eval_message = "using the classical evaluation";
+        } else if (network.load(values.eval_file, &error)) {
+            eval_message = "using NNUE " + values.eval_file + " with the " +
+                           network.getKernel().name + " kernel";
+        } else {
+            eval_message = "cannot load EvalFile " + values.eval_file + ": " +
+                           error + ", using the classical evaluation";
+        }
+        network_memory.set(network.loaded() ? nnue::Network::FILE_SIZE : 0);
+    }
+
+    // the table is freed before it is reallocated, so the old and new
+    // sizes are never both in use
+    size_t old_hash_size = hash_size;
+    planMemory(values);
+    bool reallocate = hash_size != old_hash_size || policy != numa_policy;
+    numa_policy = policy;
+    resizeHash(reallocate);
+}
+
+void Engine::resizeHash(bool reallocate) {
+    if (reallocate) {
+        hash_granted = tt.resize(hash_size, topology, numa_policy,
+                                 workers.size());
+    }
+    if (hash_granted < hash_size) {
+        memory_message += std::string(memory_message.empty() ? "" : ", ") +
+                          "cannot allocate Hash " +
+                          std::to_string(hash_size) + " MB, using " +
+                          std::to_string(hash_granted) + " MB";
+    }
+}
+
+void Engine::planMemory(const OptionValues& values) {
+    memory.setLimit(values.memory_budget);
+
+    const char* names[] = {"Hash", "MateHash", "EvalCache"};
+    MemoryRequest requests[] = {
+        {mem_hash, static_cast<size_t>(values.hash), 1, 1},
+        {mem_mate_hash, static_cast<size_t>(values.mate_hash), 1, 1},
+        {mem_eval_cache, static_cast<size_t>(values.eval_cache), 0,
+         workers.size()}
+    };
+    const int num_requests = sizeof(requests) / sizeof(requests[0]);
+    size_t asked[num_requests];
+    for (int i = 0; i < num_requests; i++) asked[i] = requests[i].megabytes;
+
+    size_t fixed = search_memory.get() + network_memory.get();
+    if (!memory.fit(fixed, requests, num_requests)) {
+        memory_message = "memory budget " +
+                         std::to_string(values.memory_budget) + " MB:";
+        const char* separator = " ";
+        for (int i = 0; i < num_requests; i++) {
+            if (requests[i].megabytes == asked[i]) continue;
+            memory_message += separator + std::string(names[i]) + " " +
+                              std::to_string(asked[i]) + " -> " +
+                              std::to_string(requests[i].megabytes) + " MB";
+            separator = ", ";
+        }
+    } else {
+        memory_message.clear();
+    }
+    hash_size = requests[0].megabytes;
+    mate_hash_size = requests[1].megabytes;
+    eval_cache_size = requests[2].megabytes;
+}
+
+const NumaTopology& Engine::getTopology() const {
+    return topology;
+}
+
+const MemoryBudget& Engine::getMemoryBudget() const {
+    return memory;
+}
+
+void Engine::go(const SearchLimits& searchLimits, InfoCallback onInfo,
+                BestMoveCallback onBestMove) {
+    // the clock is running while options are applied, e.g. a table resized
+    auto go_time = std::chrono::steady_clock::now();
+    waitForOptions();
+    stop();
+    wait();
+
+    std::lock_guard<std::mutex> lock{thread_mutex};
+    search_options = options.snapshot();
+    limits = searchLimits;
+    on_info = std::move(onInfo);
+    on_best_move = std::move(onBestMove);
+    best_move_sent = false;
+    stop_flag = false;
+    pondering = limits.ponder;
+    running = true;
+    start_time = go_time;
+    if (search_options->tree_reuse && !search_options->deterministic) {
+        tt.newSearch();
+        predictLine();
+    } else {
+        tt.clear(topology, numa_policy, workers.size());
+        predicted_moves.clear();
+        predicted_keys.clear();
+    }
+    TTEntry entry;
+    chessCore::move_t tt_move = tt.probe(board.getHashValue(), &entry) ?
+                                entry.move : chessCore::move_t();
+    root_moves.init(board, pieces, tt_move, limits.searchmoves);
+    last_best = chessCore::move_t();
+    best_move_stability = 0;
+    allotTime();
+    initFallback();
+    if (!pondering) armWatchdog(start_time);
+
+    search_count++;
+    search_threads = limits.mate || search_options->deterministic ?
+                     1 : static_cast<int>(workers.size());
+    cpu_meter.start();
+    next_status = STATUS_INTERVAL;
+    next_currline = CURRLINE_INTERVAL;
+    iterations.clear();
+    last_stats = SearchStats();
+    const std::string& stats_file = search_options->stats_file;
+    if (stats_file != stats_writer.getPath() &&
+        !stats_writer.open(stats_file) && on_info) {
+        SearchInfo info;
+        info.string = "cannot open stats file " + stats_file;
+        on_info(info);
+    }
+    const std::string& metrics_file = search_options->metrics_file;
+    if (metrics_file != metrics_writer.getPath() &&
+        !metrics_writer.open(metrics_file) && on_info) {
+        SearchInfo info;
+        info.string = "cannot open metrics file " + metrics_file;
+        on_info(info);
+    }
+    if (!eval_message.empty() && on_info) {
+        SearchInfo info;
+        info.string = eval_message;
+        on_info(info);
+    }
+    eval_message.clear();
+    if (!memory_message.empty() && on_info) {
+        SearchInfo info;
+        info.string = memory_message;
+        on_info(info);
+    }
+    memory_message.clear();
+
+    search_thread = std::thread(&Engine::searchLoop, this);
+}
+
+void Engine::stop() {
+    pondering = false;
+    stop_flag = true;
+}
+
+void Engine::ponderhit() {
+    // the time spent pondering counts towards the budget, to be safe, but
+    // our clock only started running now
+    if (pondering) armWatchdog(std::chrono::steady_clock::now());
+    pondering = false;
+}
+
+void Engine::wait() {
+    std::lock_guard<std::mutex> lock{thread_mutex};
+    if (search_thread.joinable()) search_thread.join();
+    watchdog.disarm();
+}
+
+bool Engine::isSearching() const {
+    return running;
+}
+
+void Engine::predictLine() {
+    predicted_moves.clear();
+    predicted_keys.clear();
+
+    // the same position again, or after our move and the expected reply
+    const size_t skips[] = {0, 2};
+    for (size_t skip : skips) {
+        if (last_pv.size() <= skip) break;
+        chessCore::Board pos = last_root;
+        for (size_t i = 0; i < skip; i++) pos.doMoveInPlace(last_pv[i]);
+        if (pos.getHashValue() != board.getHashValue()) continue;
+
+        for (size_t i = skip; i < last_pv.size(); i++) {
+            predicted_keys.push_back(pos.getHashValue());
+            predicted_moves.push_back(last_pv[i]);
+            pos.doMoveInPlace(last_pv[i]);
+        }
+        return;
+    }
+}
+
+void Engine::allotTime() {
+    time_budget = 0;
+    hard_deadline = 0;
+    if (limits.infinite) return;
+
+    uint32_t overhead = search_options->move_overhead;
+    if (limits.movetime) {
+        time_budget = limits.movetime;
+        hard_deadline = limits.movetime + overhead;
+        return;
+    }
+
+    bool white_to_move = board.getSide() == chessCore::white;
+    uint32_t remaining = white_to_move ? limits.wtime : limits.btime;
+    uint32_t increment = white_to_move ? limits.winc : limits.binc;
+    if (!remaining) return;
+
+    uint32_t moves_left = limits.movestogo ? limits.movestogo : 30;
+    time_budget = remaining / moves_left + increment * 3 / 4;
+
+    uint32_t max_budget = remaining > overhead ? remaining - overhead : 1;
+    time_budget = std::max<uint32_t>(1, std::min(time_budget, max_budget));
+    hard_deadline = max_budget;
+}
+
+void Engine::initFallback() {
+    chessCore::move_t move = root_moves.size() ? root_moves[0].move :
+                                                 chessCore::move_t();
+    std::lock_guard<std::mutex> lock{fallback_mutex};
+    fallback_move = move;
+    fallback_ponder = chessCore::move_t();
+}
+
+void Engine::armWatchdog(std::chrono::steady_clock::time_point from) {
+    if (!hard_deadline) return;
+    // leave the watchdog time to send the move before the deadline
+    uint32_t delay = hard_deadline > WATCHDOG_GRACE ?
+                     hard_deadline - WATCHDOG_GRACE : 0;
+    watchdog.arm(from + std::chrono::milliseconds(delay),
+                 [this]() { deadlineExpired(); });
+}
+
+void Engine::deadlineExpired() {
+    if (best_move_sent) return;
+    stop_flag = true;
+    uint32_t fired = elapsed();
+
+    // the search notices the stop flag within a few thousand nodes
+    auto give_up = std::chrono::steady_clock::now() +
+                   std::chrono::milliseconds(WATCHDOG_GRACE);
+    while (!best_move_sent && std::chrono::steady_clock::now() < give_up) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    bool forced = !best_move_sent.exchange(true);
+    if (forced && on_best_move) {
+        chessCore::move_t move, ponder;
+        {
+            std::lock_guard<std::mutex> lock{fallback_mutex};
+            move = fallback_move;
+            ponder = fallback_ponder;
+        }
+        on_best_move(move, ponder);
+    }
+
+    uint32_t sent = elapsed();
+    uint32_t late = sent > time_budget ? sent - time_budget : 0;
+    trace::event(trace_deadline_overrun, late, forced);
+    if (on_info) {
+        SearchInfo info;
+        info.string = "watchdog stopped the search at " +
+                      std::to_string(fired) + " ms, bestmove sent by the " +
+                      (forced ? "watchdog" : "search") + " " +
+                      std::to_string(late) + " ms after the " +
+                      std::to_string(time_budget) + " ms budget";
+        on_info(info);
+    }
+}
+
+bool Engine::limitReached() {
+    if (pondering) return false;
+    if (limits.nodes && totalNodes() >= limits.nodes) return true;
+    return time_budget && elapsed() >= time_budget;
+}
+
+uint32_t Engine::elapsed() const {
+    auto duration = std::chrono::steady_clock::now() - start_time;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               duration).count();
+}
+
+uint64_t Engine::totalNodes() const {
+    uint64_t total = 0;
+    for (const auto& worker : workers) {
+        total += worker->nodes.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+bool Engine::iterationDone(const SearchWorker& main) {
+    SearchInfo info;
+    info.depth = main.completed_depth;
+    info.seldepth = main.seldepth;
+    info.time = elapsed();
+    info.nodes = totalNodes();
+    info.nps = info.nodes * 1000 / std::max<uint32_t>(info.time, 1);
+    info.score = main.root_score;
+    info.pv = main.root_pv;
+    info.hashfull = tt.hashfull();
+    info.cpuload = cpu_meter.load(search_threads);
+    if (on_info) on_info(info);
+    // the iteration stands in for a status line
+    next_status = info.time + STATUS_INTERVAL;
+    if (search_options->show_refutations && on_info) reportRefutations(main);
+
+    if (!main.root_pv.empty()) {
+        std::lock_guard<std::mutex> lock{fallback_mutex};
+        fallback_move = main.root_pv[0];
+        fallback_ponder = main.root_pv.size() > 1 ? main.root_pv[1]
+                                                  : chessCore::move_t();
+    }
+
+    IterationStats stats;
+    stats.depth = info.depth;
+    stats.seldepth = info.seldepth;
+    stats.score = info.score;
+    stats.time = info.time;
+    uint64_t nodes_before = 0;
+    uint64_t last_nodes = 0;
+    if (!iterations.empty()) {
+        stats.iteration_time = info.time - iterations.back().time;
+        nodes_before = iterations.back().nodes;
+        last_nodes = iterations.back().iteration_nodes;
+    } else {
+        stats.iteration_time = info.time;
+    }
+    stats.compute(last_stats, main.stats, nodes_before,
+                  main.nodes.load(std::memory_order_relaxed), last_nodes);
+    iterations.push_back(stats);
+    last_stats = main.stats;
+
+    if (!main.root_pv.empty()) {
+        best_move_stability = main.root_pv[0] == last_best ?
+                              best_move_stability + 1 : 0;
+        last_best = main.root_pv[0];
+    }
+    // the next iteration would not finish in time, or is unlikely to
+    // change the best move
+    int max_stability = sizeof(STABLE_STOP_PERCENT) /
+                        sizeof(STABLE_STOP_PERCENT[0]) - 1;
+    uint32_t stop_percent = STABLE_STOP_PERCENT[
+            std::min(best_move_stability, max_stability)];
+    if (main.root_moves.bestShare() < CONTESTED_SHARE) {
+        stop_percent += CONTESTED_STOP_PERCENT;
+    }
+    if (time_budget && !pondering &&
+        info.time >= uint64_t{time_budget} * stop_percent / 100) {
+        return false;
+    }
+    if (info.isMate() && !limits.infinite && !pondering) return false;
+    return true;
+}
+
+void Engine::reportStatus() {
+    uint32_t time = elapsed();
+    if (search_options->show_currline && on_info && time >= next_currline) {
+        next_currline = time + CURRLINE_INTERVAL;
+        chessCore::move_t line[MAX_PLY];
+        for (int i = 0; i < search_threads; i++) {
+            int length = workers[i]->current_line.read(line);
+            if (length == 0) continue;
+            SearchInfo info;
+            info.currline.resize(search_threads);
+            info.currline[i].assign(line, line + length);
+            on_info(info);
+        }
+    }
+    if (time < next_status) return;
+    next_status = time + STATUS_INTERVAL;
+
+    // called on the main worker's thread, so its root move can be read
+    const SearchWorker& main = *workers[0];
+    SearchInfo info;
+    info.time = time;
+    info.nodes = totalNodes();
+    info.nps = info.nodes * 1000 / std::max<uint32_t>(info.time, 1);
+    info.hashfull = tt.hashfull();
+    info.cpuload = cpu_meter.load(search_threads);
+    if (main.root_move_number) {
+        info.currmove = main.current_moves[0];
+        info.currmovenumber = main.root_move_number;
+    }
+    if (on_info) on_info(info);
+    writeMetrics(info.nodes, true);
+}
+
+void Engine::reportRefutations(const SearchWorker& main) {
+    const RootMoves& moves = main.root_moves;
+    for (int i = 0; i < moves.size(); i++) {
+        if (!main.root_pv.empty() && moves[i].move == main.root_pv[0]) {
+            continue;
+        }
+
+        SearchInfo info;
+        info.refutation.push_back(moves[i].move);
+        chessCore::Board pos = board;
+        pos.doMoveInPlace(moves[i].move);
+        // the hash moves are checked, as entries may be overwritten
+        chessCore::move_t replies[MAX_MOVES];
+        TTEntry entry;
+        while (static_cast<int>(info.refutation.size()) < REFUTATION_LENGTH &&
+               tt.probe(pos.getHashValue(), &entry)) {
+            int num_replies = pos.getAllLegalMoves(replies);
+            if (std::find(replies, replies + num_replies, entry.move) ==
+                replies + num_replies) {
+                break;
+            }
+            info.refutation.push_back(entry.move);
+            pos.doMoveInPlace(entry.move);
+        }
+        if (info.refutation.size() > 1) on_info(info);
+    }
+}
+
+void Engine::writeMetrics(uint64_t nodes, bool searching) {
+    if (metrics_writer.getPath().empty()) return;
+
+    Metrics metrics;
+    metrics.searches = search_count;
+    metrics.nodes = total_nodes + (searching ? nodes : 0);
+    metrics.nps = nodes * 1000 / std::max<uint32_t>(elapsed(), 1);
+    metrics.hashfull = tt.hashfull();
+    metrics.cpuload = cpu_meter.load(search_threads);
+    metrics.threads = search_threads;
+    metrics.searching = searching;
+    metrics_writer.write(metrics);
+}
+
+void Engine::reportNumaNodes() {
+    if (topology.numNodes() < 2 || !on_info) return;
+
+    uint32_t time = std::max<uint32_t>(elapsed(), 1);
+    std::vector<uint64_t> node_nodes(topology.numNodes(), 0);
+    for (const auto& worker : workers) {
+        node_nodes[worker->numa_node] +=
+                worker->nodes.load(std::memory_order_relaxed);
+    }
+
+    SearchInfo info;
+    info.string = "numa";
+    for (int node = 0; node < topology.numNodes(); node++) {
+        info.string += " node " + std::to_string(node) + " nps " +
+                       std::to_string(node_nodes[node] * 1000 / time);
+    }
+    on_info(info);
+}
+
+void Engine::reportStats() {
+    if (iterations.empty() || !on_info) return;
+
+    // rates over the whole search, the branching factor of the last depth
+    const SearchWorker& main = *workers[0];
+    IterationStats total;
+    total.compute(SearchStats(), main.stats, 0,
+                  main.nodes.load(std::memory_order_relaxed), 0);
+
+    char buf[160];
+    std::snprintf(buf, sizeof(buf),
+                  "stats depth %d ebf %.2f qnodes %.1f%% tthit %.1f%% "
+                  "ttcut %.1f%% firstcut %.1f%% evalhit %.1f%%",
+                  iterations.back().depth,
+                  iterations.back().branching_factor,
+                  total.qnode_share * 100, total.tt_hit_rate * 100,
+                  total.tt_cutoff_rate * 100,
+                  total.first_move_cutoff_rate * 100,
+                  total.eval_hit_rate * 100);
+    SearchInfo info;
+    info.string = buf;
+    on_info(info);
+}
+
+void Engine::searchLoop() {
+    if (limits.mate) {
+        solveMate();
+        return;
+    }
+    for (const auto& worker : workers) worker->nodes = 0;
+
+    bool bind = numa_policy != numa_none;
+    if (bind) topology.bindThisThread(workers[0]->numa_node);
+
+    // a deterministic search runs on the main worker alone
+    size_t num_workers = search_options->deterministic ? 1 : workers.size();
+    std::vector<std::thread> helpers;
+    for (size_t i = 1; i < num_workers; i++) {
+        SearchWorker* worker = workers[i].get();
+        helpers.emplace_back([this, worker, bind]() {
+            if (bind) topology.bindThisThread(worker->numa_node);
+            worker->search();
+        });
+    }
+
+    workers[0]->search();
+
+    waitForStop();
+    for (std::thread& helper : helpers) helper.join();
+
+    reportNumaNodes();
+    reportStats();
+    sendBestMove(workers[0]->root_pv);
+
+    // after the best move is sent, so that it isn't delayed
+    for (const IterationStats& stats : iterations) {
+        stats_writer.write(search_count, stats);
+    }
+    stats_writer.flush();
+    uint64_t nodes = totalNodes();
+    total_nodes += nodes;
+    writeMetrics(nodes, false);
+}
+
+void Engine::waitForStop() {
+    // in infinite and ponder mode the GUI decides when the search ends
+    while ((limits.infinite || pondering) && !stop_flag) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    stop_flag = true;
+}
+
+void Engine::sendBestMove(const std::vector<chessCore::move_t>& pv) {
+    last_root = board;
+    last_pv = pv;
+    chessCore::move_t best_move, ponder_move;
+    if (!pv.empty()) {
+        best_move = pv[0];
+        ponder_move = pv.size() > 1 ? pv[1] : chessCore::move_t();
+    } else {
+        // stopped before the first iteration finished
+        std::lock_guard<std::mutex> lock{fallback_mutex};
+        best_move = fallback_move;
+    }
+    running = false;
+    if (!best_move_sent.exchange(true) && on_best_move) {
+        on_best_move(best_move, ponder_move);
+    }
+    watchdog.disarm();
+}
+
+void Engine::solveMate() {
+    mate_solver.resize(mate_hash_size);
+    MateResult result = mate_solver.solve(board, limits.mate,
+                                          [this](uint64_t nodes) {
+        if (stop_flag) return true;
+        if (pondering) return false;
+        if (limits.nodes && nodes >= limits.nodes) return true;
+        return time_budget && elapsed() >= time_budget;
+    });
+
+    SearchInfo info;
+    info.time = elapsed();
+    info.nodes = result.nodes;
+    info.nps = info.nodes * 1000 / std::max<uint32_t>(info.time, 1);
+    if (result.outcome == MateResult::mate_found) {
+        info.depth = 2 * result.mate_in - 1;
+        info.seldepth = info.depth;
+        info.score = MATE_VALUE - info.depth;
+        info.pv = result.pv;
+    } else if (result.outcome == MateResult::no_mate) {
+        info.string = "no mate in " + std::to_string(limits.mate);
+    } else {
+        info.string = "mate search stopped, no mate in " +
+                      std::to_string(result.no_mate_in) + " (" +
+                      std::to_string(result.nodes) + " nodes)";
+    }
+    if (on_info) on_info(info);
+
+    waitForStop();
+    sendBestMove(result.pv);
+    total_nodes += result.nodes;
+    writeMetrics(result.nodes, false);
+}
+
+}   // namespace chessUCI
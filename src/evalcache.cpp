@@ -0,0 +1,41 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "evalcache.h"
+
+#include <algorithm>
+
+namespace chessUCI {
+
+EvalCache::EvalCache() : charge(mem_eval_cache) {
+    megabytes = 0;
+}
+
+void EvalCache::resize(size_t new_megabytes) {
+    if (new_megabytes == megabytes) return;
+    megabytes = new_megabytes;
+
+    size_t num_entries = 0;
+    if (megabytes) {
+        // the largest power of two that fits
+        num_entries = 1;
+        while (num_entries * 2 * sizeof(Entry) <= megabytes << 20) {
+            num_entries *= 2;
+        }
+    }
+    std::vector<Entry>().swap(entries);
+    entries.resize(num_entries);
+    charge.set(num_entries * sizeof(Entry));
+    clear();
+}
+
+void EvalCache::clear() {
+    // an empty slot is a collision away from a real entry, like any other
+    std::fill(entries.begin(), entries.end(), Entry{0, 0});
+}
+
+}   // namespace chessUCI
@@ -0,0 +1,34 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "history.h"
+
+#include <algorithm>
+
+namespace chessUCI {
+
+KeyHistory::KeyHistory() {
+    count = 0;
+    std::fill(filter, filter + FILTER_SIZE, 0);
+}
+
+void KeyHistory::reset(const KeyHistory& other, size_t extra) {
+    count = other.count;
+    keys.resize(count + extra);
+    rule50.resize(count + extra);
+    std::copy(other.keys.begin(), other.keys.begin() + count, keys.begin());
+    std::copy(other.rule50.begin(), other.rule50.begin() + count,
+              rule50.begin());
+    std::copy(other.filter, other.filter + FILTER_SIZE, filter);
+}
+
+void KeyHistory::clear() {
+    count = 0;
+    std::fill(filter, filter + FILTER_SIZE, 0);
+}
+
+}   // namespace chessUCI
@@ -7,17 +7,21 @@ LICENSE file in the root directory of this source tree.
 */
 #include "interface.h"
 
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <mutex>
 #include <regex>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <utility>
 
-#define DUMMY_HANDLING
+#include "attacks.h"
+#include "lan.h"
+#include "trace.h"
 
 namespace chessUCI {
 
@@ -60,6 +64,69 @@ namespace {
         return _tokens;
     }
 
+    /** The commands from the GUI, in the order used by traces. */
+    const char* const COMMANDS[] = {
+        "uci", "debug", "isready", "setoption", "register", "ucinewgame",
+        "position", "go", "stop", "ponderhit", "quit"
+    };
+
+    /** The index of a command in \ref COMMANDS, or -1 if unknown. */
+    int32_t command_kind(const std::string& line) {
+        std::istringstream ss(line);
+        std::string command;
+        ss >> command;
+        for (size_t i = 0; i < sizeof(COMMANDS) / sizeof(COMMANDS[0]); i++) {
+            if (command == COMMANDS[i]) return i;
+        }
+        return -1;
+    }
+
+    /** Append a line of moves in long algebraic notation. */
+    void append_lan(const std::vector<chessCore::move_t>& moves,
+                    std::vector<std::string>* out) {
+        // moves fit in the small string buffer, so only the vector allocates
+        out->reserve(out->size() + moves.size());
+        lan_buffer buf;
+        for (chessCore::move_t move : moves) {
+            int length = format_lan(move, buf);
+            out->emplace_back(buf, length);
+        }
+    }
+
+    MessageTypes::InfoMessage toInfoMessage(const SearchInfo& searchInfo) {
+        MessageTypes::InfoMessage infoMessage;
+        if (!searchInfo.string.empty()) {
+            infoMessage.string = searchInfo.string;
+            return infoMessage;
+        }
+        infoMessage.depth = searchInfo.depth;
+        infoMessage.seldepth = searchInfo.seldepth;
+        infoMessage.time = searchInfo.time;
+        infoMessage.nodes = searchInfo.nodes;
+        infoMessage.nps = searchInfo.nps;
+        infoMessage.hashfull = searchInfo.hashfull;
+        infoMessage.cpuload = searchInfo.cpuload;
+        // status updates (depth 0) have no score
+        if (searchInfo.isMate()) {
+            infoMessage.score = "mate " + std::to_string(searchInfo.mateIn());
+        } else if (searchInfo.depth > 0) {
+            infoMessage.score = "cp " + std::to_string(searchInfo.score);
+        }
+        if (searchInfo.currmove != chessCore::move_t()) {
+            lan_buffer buf;
+            infoMessage.currmove.assign(buf,
+                                        format_lan(searchInfo.currmove, buf));
+            infoMessage.currmovenumber = searchInfo.currmovenumber;
+        }
+        append_lan(searchInfo.pv, &infoMessage.pv);
+        append_lan(searchInfo.refutation, &infoMessage.refutation);
+        infoMessage.currline.resize(searchInfo.currline.size());
+        for (size_t i = 0; i < searchInfo.currline.size(); i++) {
+            append_lan(searchInfo.currline[i], &infoMessage.currline[i]);
+        }
+        return infoMessage;
+    }
+
 }   // end of anonymous namespace
 
 namespace MessageTypes {
@@ -129,25 +196,18 @@ std::ostream& operator<<(std::ostream& out, const InfoMessage& infoMessage) {
         for (std::string s : infoMessage.pv) out << s << " ";
     }
 
-    bool is_empty;
-    int num_nonempty = 0;
-    for (std::vector<std::string> line : infoMessage.currline) {
-        if (line.size()) num_nonempty++;
-    }
-    if (num_nonempty) {
-        int i = 1;
-        is_empty = true;
-        for (std::vector<std::string> line : infoMessage.currline) {
-            if (line.size() == 0) continue;
-            if (is_empty) {
-                out << "currline ";
-                is_empty = false;
-            }
-            if (num_nonempty > 1) out << i << " ";
-            for (std::string move : line) {
-                out << move << " ";
-            }
-            i++;
+    // lines are indexed by cpu, which is only numbered if there are several
+    bool is_empty = true;
+    for (size_t i = 0; i < infoMessage.currline.size(); i++) {
+        const std::vector<std::string>& line = infoMessage.currline[i];
+        if (line.size() == 0) continue;
+        if (is_empty) {
+            out << "currline ";
+            is_empty = false;
+        }
+        if (infoMessage.currline.size() > 1) out << i + 1 << " ";
+        for (const std::string& move : line) {
+            out << move << " ";
         }
     }
     if (infoMessage.string.size()) out << "string " << infoMessage.string;
@@ -179,7 +239,7 @@ bool OptionMessage::valid() const {
         if (type != check_type) return false;
     } else if (name == "UCI_ShowRefutations") {
         if (type != check_type) return false;
-    } else if (name == "UCI_LimittStrength") {
+    } else if (name == "UCI_LimitStrength") {
         if (type != check_type) return false;
     } else if (name == "UCI_Elo") {
         if (type != spin_type) return false;
@@ -290,8 +350,7 @@ chessInterface::chessInterface() :
                     cerr(std::cerr) {
     debug_mode = false;
     engine_name = "strawberry";
-    searcher = new chessCore::Searcher;
-    ready = false;
+    quit = false;
 }
 
 chessInterface::chessInterface(std::istream& in, std::ostream& out,
@@ -299,32 +358,37 @@ chessInterface::chessInterface(std::istream& in, std::ostream& out,
         cin(in), cout(out), cerr(err) {
     debug_mode = false;
     engine_name = "strawberry";
-    searcher = new chessCore::Searcher;
-    ready = false;
+    quit = false;
 }
 
 void chessInterface::sendIDNameMessage(std::string name) const {
-    cout << "id name " << name << "\n";
+    std::lock_guard<std::mutex> lock{output_mutex};
+    cout << "id name " << name << "\n" << std::flush;
 }
 void chessInterface::sendIDAuthorMessage(std::string author) const {
-    cout << "id author " << author << "\n";
+    std::lock_guard<std::mutex> lock{output_mutex};
+    cout << "id author " << author << "\n" << std::flush;
 }
 void chessInterface::sendUCIOkMessage() const {
-    cout << "uciok\n";
+    std::lock_guard<std::mutex> lock{output_mutex};
+    cout << "uciok\n" << std::flush;
 }
 void chessInterface::sendReadyOkMessage() const {
-    cout << "readyok\n;";
+    std::lock_guard<std::mutex> lock{output_mutex};
+    cout << "readyok\n" << std::flush;
 }
 void chessInterface::sendBestMoveMessage(std::string move1, bool ponder,
                                          std::string move2) const {
+    std::lock_guard<std::mutex> lock{output_mutex};
     cout << "bestmove " << move1;
     if (ponder) {
         cout << " ponder " << move2;
     }
-    cout<< "\n";
+    cout << "\n" << std::flush;
 }
 void chessInterface::sendCopyProtectMessage(
             MessageTypes::CopyProtectMessage status) const {
+    std::lock_guard<std::mutex> lock{output_mutex};
     cout << "copyprotection ";
     switch (status) {
         case MessageTypes::CopyProtectMessage::checking_copyprotect:
@@ -337,9 +401,11 @@ void chessInterface::sendCopyProtectMessage(
             cout << "error\n";
             break;
     }
+    cout << std::flush;
 }
 void chessInterface::sendRegisterMessage(
             MessageTypes::RegistrationMessage status) const {
+    std::lock_guard<std::mutex> lock{output_mutex};
     cout << "registration ";
     switch (status) {
         case MessageTypes::RegistrationMessage::checking_registration:
@@ -352,14 +418,17 @@ void chessInterface::sendRegisterMessage(
             cout << "error\n";
             break;
     }
+    cout << std::flush;
 }
 void chessInterface::sendInfoMessage(
             MessageTypes::InfoMessage infoMessage) const {
-    cout << infoMessage;
+    std::lock_guard<std::mutex> lock{output_mutex};
+    cout << infoMessage << std::flush;
 }
 void chessInterface::sendOptionMessage(
             MessageTypes::OptionMessage optionMessage) const {
-    cout << optionMessage;
+    std::lock_guard<std::mutex> lock{output_mutex};
+    cout << optionMessage << std::flush;
 }
 
 std::string chessInterface::readInput() const {
@@ -369,177 +438,162 @@ std::string chessInterface::readInput() const {
 }
 
 
-#ifdef DUMMY_HANDLING
-    void chessInterface::handleUCIMessage() {
-        std::cout << "\t\tUCI message\n";
-    }
-    void chessInterface::handleDebugMessage(bool on) {
-        std::cout << "\t\tDebug message: "
-                  << (on ? "on" : "off") << "\n";
-    }
-    void chessInterface::handleIsReadyMessage() {
-        std::cout << "\t\tIs ready message\n";
-    }
-    void chessInterface::handleSetOptionMessage(std::string name,
-                                                std::string value) {
-        std::cout << "\t\tSet option message: "
-                  << "name = " << name
-                  << ", value = " << value << "\n";
-    }
-    void chessInterface::handleRegisterMessage(bool later, std::string name,
-                                               std::string code) {
-        std::cout << "\t\tRegister message: ";
-        if (later) {
-            std::cout << "later\n";
-        } else {
-            std::cout << "name = " << name
-                      << ", code = " << code << "\n";
-        }
-    }
-    void chessInterface::handleUCINewGameMessage() {
-        std::cout << "\t\tUCI new game message\n";
-    }
-    void chessInterface::handlePositionMessage(std::string position,
-                                            std::vector<std::string> moves) {
-        std::cout << "\t\tPosition message: "
-                  << "position = " << position
-                  << ", moves =";
-        for (std::string s : moves) std::cout << " " << s;
-        std::cout << "\n";
-    }
-    void chessInterface::handleGoMessage(MessageTypes::GoMessage goMessage) {
-        std::cout << "\t\tGo message:\n";
-        std::cout << "\t\tponder = " << (goMessage.ponder ? "true\n" :
-                                                            "false\n");
-        std::cout << "\t\tinfinite = " << (goMessage.infinite ? "true\n" :
-                                                                "false\n");
-        if (goMessage.wtime) std::cout << "\t\twtime = "
-                                       << goMessage.wtime << "\n";
-        if (goMessage.btime) std::cout << "\t\tbtime = "
-                                       << goMessage.btime << "\n";
-        if (goMessage.winc) std::cout << "\t\twinc = "
-                                      << goMessage.winc << "\n";
-        if (goMessage.binc) std::cout << "\t\tbinc = "
-                                      << goMessage.binc << "\n";
-        if (goMessage.movestogo) std::cout << "\t\tmovestogo = "
-                                           << goMessage.movestogo << "\n";
-        if (goMessage.depth) std::cout << "\t\tdepth = "
-                                       << +goMessage.depth << "\n";
-        if (goMessage.nodes) std::cout << "\t\tnodes = "
-                                       << goMessage.nodes << "\n";
-        if (goMessage.mate) std::cout << "\t\tmate = "
-                                      << +goMessage.mate << "\n";
-        if (goMessage.movetime) std::cout << "\t\tmovetime = "
-                                          << goMessage.movetime << "\n";
-        if (!goMessage.searchmoves.empty()) {
-            std::cout << "\t\tsearchmoves =";
-            for (std::string s : goMessage.searchmoves) {
-                std::cout << " " << s;
-            }
-            std::cout << "\n";
-        }
-    }
-    void chessInterface::handleStopMessage() {
-        std::cout << "\t\tStop message\n";
-    }
-    void chessInterface::handlePonderHitMessage() {
-        std::cout << "\t\tPonder Hit message\n";
-    }
-    void chessInterface::handleQuitMessage() {
-        std::cout << "\t\tQuit message\n";
+void chessInterface::handleUCIMessage() {
+    // send ID
+    sendIDNameMessage(engine_name);
+    sendIDAuthorMessage("Freddy Pringle");
+
+    // send options
+    for (const auto& option : engine.getOptions().messages()) {
+        sendOptionMessage(option);
     }
-#else
-    void chessInterface::handleUCIMessage() {
-        // send ID
-        sendIDNameMessage(engine_name);
-        sendIDAuthorMessage("Freddy Pringle");
 
-        // send options
-        // ...
+    MessageTypes::InfoMessage info;
+    info.string = std::string("attacks ") +
+                  attacks::backendName(attacks::bestBackend());
+    sendInfoMessage(info);
 
-        // ready
-        sendUCIOkMessage();
-    }
+    // ready
+    sendUCIOkMessage();
+}
 
-    void chessInterface::handleDebugMessage(bool on) {
-        debug_mode = on;
-    }
+void chessInterface::handleDebugMessage(bool on) {
+    debug_mode = on;
 
-    void chessInterface::handleIsReadyMessage() {
-        if (read) {
-            sendReadyOkMessage();
-        } else {
-            // hmmmmmm
+    MessageTypes::InfoMessage info;
+    if (on) {
+        info.string = engine.getMemoryBudget().report();
+        sendInfoMessage(info);
+    }
+    const std::string& path = engine.getOptions().values().trace_file;
+    if (on && !trace::on()) {
+        if (!trace::start(path)) {
+            cerr << "Cannot open trace file " << path << "\n";
+            return;
         }
+        info.string = "tracing to " + path;
+        sendInfoMessage(info);
+    } else if (!on && trace::on()) {
+        trace::TraceStats stats = trace::stop();
+        info.string = "trace " + path + ": " + std::to_string(stats.events) +
+                      " events, " + std::to_string(stats.dropped) +
+                      " dropped";
+        sendInfoMessage(info);
     }
+}
 
-    void chessInterface::handleSetOptionMessage(std::string name,
-                                                std::string value) {
-    }
+void chessInterface::handleIsReadyMessage() {
+    engine.waitForOptions();
+    sendReadyOkMessage();
+}
 
-    void chessInterface::handleRegisterMessage(bool later, std::string name,
-                                               std::string code) {
-        if (later) return;
-        if (!name.empty()) registered_name = name;
-        if (!code.empty()) registered_code = code;
+void chessInterface::handleSetOptionMessage(std::string name,
+                                            std::string value) {
+    if (!engine.setOption(name, value)) {
+        handleInvalidMessage("setoption name " + name + " value " + value);
     }
+}
 
-    void chessInterface::handleUCINewGameMessage() {
-        if (ready) {
-            delete game_board
-        }
-        ready = false;
-    }
+void chessInterface::handleRegisterMessage(bool later, std::string name,
+                                           std::string code) {
+    if (later) return;
+    if (!name.empty()) registered_name = name;
+    if (!code.empty()) registered_code = code;
+}
 
-    void chessInterface::handlePositionMessage(std::string position,
-                                               std::vector<std::string> moves) {
-        if (ready) {
-            delete game_board;
-        }
+void chessInterface::handleUCINewGameMessage() {
+    engine.newGame();
+}
 
-        ready = false;
+void chessInterface::handlePositionMessage(std::string position,
+                                           std::vector<std::string> moves) {
+    if (!engine.setPosition(position, moves)) {
+        cerr << "Illegal move in position: " << position << "\n";
+    }
+}
 
-        if (position = "startpos") {
-            game_board = new chessCore::Board;
+void chessInterface::handleGoMessage(MessageTypes::GoMessage goMessage) {
+    SearchLimits limits;
+    limits.ponder = goMessage.ponder;
+    limits.infinite = goMessage.infinite;
+    limits.wtime = goMessage.wtime;
+    limits.btime = goMessage.btime;
+    limits.winc = goMessage.winc;
+    limits.binc = goMessage.binc;
+    limits.movestogo = goMessage.movestogo;
+    limits.depth = goMessage.depth;
+    limits.movetime = goMessage.movetime;
+    limits.nodes = goMessage.nodes;
+    limits.mate = goMessage.mate;
+    chessCore::Board board = engine.getBoard();
+    for (const std::string& move_str : goMessage.searchmoves) {
+        chessCore::move_t move;
+        if (parse_lan(board, move_str, &move)) {
+            limits.searchmoves.push_back(move);
         } else {
-            game_board = new chessCore::Board(position);
+            MessageTypes::InfoMessage info;
+            info.string = "ignoring illegal searchmoves move " + move_str;
+            sendInfoMessage(info);
         }
-
-        move_t move;
-        for (std::string move_str : move) {
-            move = game_board->move_from_SAN(move_str);
-            game_board->doMoveInPlace(move);
-        }
-        ready = true;
     }
 
-    void chessInterface::handleGoMessage(MessageTypes::GoMessage goMessage) {
-    }
-
-    void chessInterface::handleStopMessage() {
-    }
+    bool debug = debug_mode;
+    engine.go(limits,
+              [this](const SearchInfo& searchInfo) {
+                  sendInfoMessage(toInfoMessage(searchInfo));
+              },
+              [this, debug](chessCore::move_t best,
+                            chessCore::move_t ponder) {
+                  if (debug) {
+                      MessageTypes::InfoMessage info;
+                      info.string = engine.getMemoryBudget().report();
+                      sendInfoMessage(info);
+                  }
+                  lan_buffer best_buf, ponder_buf;
+                  format_lan(best, best_buf);
+                  format_lan(ponder, ponder_buf);
+                  sendBestMoveMessage(best_buf, ponder != chessCore::move_t(),
+                                      ponder_buf);
+              });
+}
 
-    void chessInterface::handlePonderHitMessage() {
-    }
+void chessInterface::handleStopMessage() {
+    engine.stop();
+}
 
-    void chessInterface::handleQuitMessage() {
-    }
+void chessInterface::handlePonderHitMessage() {
+    engine.ponderhit();
+}
 
-#endif  // DUMMY_HANDLING
+void chessInterface::handleQuitMessage() {
+    engine.stop();
+    engine.wait();
+    if (debug_mode) handleDebugMessage(false);
+    quit = true;
+}
 
+Engine& chessInterface::getEngine() {
+    return engine;
+}
 
 void chessInterface::inputLoop() {
     std::string tmp;
+    int32_t line_number = 0;
     while (true) {
         tmp = readInput();
+        trace::event(trace_command_received, line_number++, tmp.size());
+        // treat the end of the input like a "quit" message
+        if (cin.fail()) tmp = "quit";
+        bool done = tmp == "quit";
         std::lock_guard<std::mutex> lock{mutex};
         inputLines.push_back(std::move(tmp));
         cv.notify_one();
+        if (done) return;
     }
 }
 
 void chessInterface::processLoop() {
-    while (true) {
+    while (!quit) {
         {
             std::unique_lock<std::mutex> lock{mutex};
             if (cv.wait_for(lock, std::chrono::seconds(0), [&]{
@@ -550,7 +604,18 @@ void chessInterface::processLoop() {
         }
         if (!processLines.empty()) {
             for (auto&& line : processLines) {
-                parseMessage(line);
+                if (trace::on()) {
+                    auto start = std::chrono::steady_clock::now();
+                    parseMessage(line);
+                    auto elapsed = std::chrono::steady_clock::now() - start;
+                    trace::event(trace_command_dispatched, command_kind(line),
+                                 std::chrono::duration_cast<
+                                     std::chrono::microseconds>(elapsed)
+                                     .count());
+                } else {
+                    parseMessage(line);
+                }
+                if (quit) break;
             }
             processLines.clear();
         }
@@ -561,6 +626,7 @@ void chessInterface::processLoop() {
 void chessInterface::mainLoop() {
     std::thread io{&chessUCI::chessInterface::inputLoop, this};
     processLoop();
+    io.join();
 }
 
 void chessInterface::handleInvalidMessage(std::string message) {
@@ -662,14 +728,27 @@ void chessInterface::parseMessage(std::string message) {
     } else if (message_type == "ucinewgame") {
         handleUCINewGameMessage();
     } else if (message_type == "position") {  // word moves
-        if (num_tokens < 2) handleInvalidMessage(message);
-        if (tokens[1] == "fen" && num_tokens < 3) {
+        if (num_tokens < 2 || (tokens[1] == "fen" && num_tokens < 3)) {
+            handleInvalidMessage(message);
+            return;
+        }
+        auto moves_it = std::find(tokens.begin() + 2, tokens.end(), "moves");
+        std::string position = tokens[1];
+        if (position == "fen") {
+            // the FEN itself contains spaces
+            std::stringstream fen;
+            for (auto it = tokens.begin() + 2; it != moves_it; it++) {
+                if (it != tokens.begin() + 2) fen << " ";
+                fen << *it;
+            }
+            position = fen.str();
+        } else if (position != "startpos") {
             handleInvalidMessage(message);
+            return;
         }
-        std::vector<std::string> moves(tokens.begin() + 2, tokens.end());
-        if (tokens[1] == "fen") moves.erase(moves.begin());
-        if (moves.size()) moves.erase(moves.begin());
-        handlePositionMessage(tokens[1], moves);
+        std::vector<std::string> moves;
+        if (moves_it != tokens.end()) moves.assign(moves_it + 1, tokens.end());
+        handlePositionMessage(position, moves);
     } else if (message_type == "go") {
         MessageTypes::GoMessage goMessage;
         int i = 1;
@@ -734,7 +813,16 @@ void chessInterface::parseMessage(std::string message) {
                     handleInvalidMessage(message);
                     return;
                 }
-                goMessage.nodes = std::stoi(tokens[i+1]);
+                // too big a count is refused rather than capped
+                try {
+                    goMessage.nodes = std::stoull(tokens[i+1]);
+                } catch (const std::invalid_argument&) {
+                    handleInvalidMessage(message);
+                    return;
+                } catch (const std::out_of_range&) {
+                    handleInvalidMessage(message);
+                    return;
+                }
                 i += 2;
             } else if (tokens[i] == "mate") {
                 if (i + 1 >= num_tokens || (!is_integer(tokens[i+1]))) {
@@ -0,0 +1,100 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "lan.h"
+
+#include "engine.h"
+
+namespace chessUCI {
+
+namespace {
+    /** The names of the squares, from a1 = 0 to h8 = 63. */
+    struct SquareNames {
+        char names[64][2];
+
+        SquareNames() {
+            for (int sq = 0; sq < 64; sq++) {
+                names[sq][0] = 'a' + sq % 8;
+                names[sq][1] = '1' + sq / 8;
+            }
+        }
+    };
+
+    const SquareNames square_names;
+
+    /** The promotion pieces, indexed by the two special bits of a move. */
+    const char PROMOTION_PIECES[] = "nbrq";
+
+    int promotion_index(chessCore::move_t move) {
+        return move.special1() * 2 + move.special0();
+    }
+
+    /** Parse a square such as "e4", or return -1. */
+    int parse_square(const char* str) {
+        if (str[0] < 'a' || str[0] > 'h' || str[1] < '1' || str[1] > '8') {
+            return -1;
+        }
+        return (str[1] - '1') * 8 + (str[0] - 'a');
+    }
+}   // namespace
+
+int format_lan(chessCore::move_t move, char* buf) {
+    if (move == chessCore::move_t()) {
+        buf[0] = buf[1] = buf[2] = buf[3] = '0';
+        buf[4] = '\0';
+        return 4;
+    }
+
+    const char* from = square_names.names[move.from_sq()];
+    const char* to = square_names.names[move.to_sq()];
+    buf[0] = from[0];
+    buf[1] = from[1];
+    buf[2] = to[0];
+    buf[3] = to[1];
+    if (move.is_promotion()) {
+        buf[4] = PROMOTION_PIECES[promotion_index(move)];
+        buf[5] = '\0';
+        return 5;
+    }
+    buf[4] = '\0';
+    return 4;
+}
+
+bool parse_lan(chessCore::Board& board, const char* str, size_t length,
+               chessCore::move_t* move) {
+    if (length != 4 && length != 5) return false;
+
+    int from = parse_square(str);
+    int to = parse_square(str + 2);
+    if (from < 0 || to < 0) return false;
+
+    int promotion = -1;
+    if (length == 5) {
+        for (int i = 0; i < 4; i++) {
+            if (str[4] == PROMOTION_PIECES[i]) promotion = i;
+        }
+        if (promotion < 0) return false;
+    }
+
+    chessCore::move_t moves[MAX_MOVES];
+    int num_moves = board.getAllLegalMoves(moves);
+    for (int i = 0; i < num_moves; i++) {
+        if (static_cast<int>(moves[i].from_sq()) != from ||
+            static_cast<int>(moves[i].to_sq()) != to) {
+            continue;
+        }
+        if (moves[i].is_promotion() ?
+                promotion_index(moves[i]) != promotion : promotion >= 0) {
+            continue;
+        }
+        *move = moves[i];
+        return true;
+    }
+    return false;
+}
+
+}   // namespace chessUCI
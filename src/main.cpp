@@ -5,9 +5,35 @@ All rights reserved.
 This source code is licensed under the BSD-style license found in the
 LICENSE file in the root directory of this source tree.
 */
+#include <string>
+#include <vector>
+
+#include "annotate.h"
+#include "bench.h"
 #include "interface.h"
+#include "selfplay.h"
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    if (!args.empty() && args[0] == "bench") {
+        return chessUCI::bench::run(
+                    std::vector<std::string>(args.begin() + 1, args.end()),
+                    std::cout);
+    }
+
+    if (!args.empty() && args[0] == "annotate") {
+        return chessUCI::annotate::run(
+                    std::vector<std::string>(args.begin() + 1, args.end()),
+                    std::cout, std::cerr);
+    }
+
+    if (!args.empty() && args[0] == "selfplay") {
+        return chessUCI::selfplay::run(
+                    std::vector<std::string>(args.begin() + 1, args.end()),
+                    std::cout, std::cerr);
+    }
 
-int main() {
     chessUCI::chessInterface interface;
     interface.mainLoop();
 
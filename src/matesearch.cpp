@@ -0,0 +1,272 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "matesearch.h"
+
+#include <algorithm>
+
+#include "constants.h"
+
+namespace chessUCI {
+
+namespace {
+    /** A proof or disproof number that can't be reached: (dis)proven. */
+    const uint32_t INF = 1u << 30;
+
+    /** How many positions to expand between two calls of the callback. */
+    const uint64_t STOP_CHECK_INTERVAL = 1024;
+
+    /** The longest mate that can be looked for, in moves. */
+    const int MAX_MATE_MOVES = MAX_PLY / 2;
+}   // namespace
+
+MateResult::MateResult() {
+    outcome = unknown;
+    mate_in = 0;
+    no_mate_in = 0;
+    nodes = 0;
+}
+
+MateSolver::MateSolver() : charge(mem_mate_hash) {
+    megabytes = 0;
+    generation = 0;
+    nodes = 0;
+    stopped = false;
+}
+
+void MateSolver::resize(size_t new_megabytes) {
+    new_megabytes = std::max<size_t>(new_megabytes, 1);
+    if (new_megabytes == megabytes) return;
+    megabytes = new_megabytes;
+
+    // the largest power of two that fits, at least one bucket
+    size_t num_entries = BUCKET_SIZE;
+    while (num_entries * 2 * sizeof(Entry) <= megabytes << 20) {
+        num_entries *= 2;
+    }
+    std::vector<Entry>().swap(table);
+    table.resize(num_entries);
+    charge.set(num_entries * sizeof(Entry));
+    clear();
+}
+
+void MateSolver::clear() {
+    // empty slots read as unexplored if a position happens to match them
+    std::fill(table.begin(), table.end(), Entry{0, 1, 1, 0, 0, 0, 0});
+}
+
+MateSolver::Entry* MateSolver::bucket(uint64_t key, int depth) {
+    uint64_t index = key ^ (depth * 0x9e3779b97f4a7c15ULL);
+    return &table[index & (table.size() - BUCKET_SIZE)];
+}
+
+void MateSolver::store(const Entry& entry) {
+    Entry* entries = bucket(entry.key, entry.depth);
+    Entry* replace = entries;
+    for (int i = 0; i < BUCKET_SIZE; i++) {
+        if (entries[i].key == entry.key && entries[i].depth == entry.depth) {
+            replace = &entries[i];
+            break;
+        }
+        bool old = entries[i].generation != generation;
+        bool replace_old = replace->generation != generation;
+        if (old != replace_old ? old : entries[i].work < replace->work) {
+            replace = &entries[i];
+        }
+    }
+    *replace = entry;
+}
+
+void MateSolver::lookup(uint64_t key, int depth, uint32_t* pn, uint32_t* dn,
+                        int* plies) {
+    *plies = 0;
+    if (std::find(path.begin(), path.end(), key) != path.end()) {
+        // a repetition: the defender is happy with a draw
+        *pn = INF;
+        *dn = 0;
+        return;
+    }
+    const Entry* entries = bucket(key, depth);
+    for (int i = 0; i < BUCKET_SIZE; i++) {
+        if (entries[i].key == key && entries[i].depth == depth) {
+            *pn = entries[i].pn;
+            *dn = entries[i].dn;
+            *plies = entries[i].plies;
+            return;
+        }
+    }
+    *pn = 1;
+    *dn = 1;
+}
+
+void MateSolver::mid(chessCore::Board& pos, int depth, bool attacker,
+                     uint32_t thpn, uint32_t thdn) {
+    if (++nodes % STOP_CHECK_INTERVAL == 0 && should_stop(nodes)) {
+        stopped = true;
+    }
+    uint64_t key = pos.getHashValue();
+    uint64_t nodes_before = nodes;
+    Entry result = {key, INF, 0, 1, 0, static_cast<uint8_t>(depth),
+                    generation};
+
+    chessCore::move_t moves[MAX_MOVES];
+    int num_moves = pos.getAllLegalMoves(moves);
+    if (num_moves == 0) {
+        if (!attacker && pos.isCheck(pos.getSide())) {
+            result.pn = 0;
+            result.dn = INF;
+        }
+        store(result);
+        return;
+    }
+    if (depth == 0) {
+        store(result);
+        return;
+    }
+
+    uint64_t child_keys[MAX_MOVES];
+    for (int i = 0; i < num_moves; i++) {
+        chessCore::Board child = pos;
+        child.doMoveInPlace(moves[i]);
+        child_keys[i] = child.getHashValue();
+    }
+
+    // The attacker needs one proven move: its proof number is the least of
+    // its children's and its disproof number their sum. The defender is
+    // the other way round. "least" and "sum" below are in those terms.
+    uint32_t th_least = attacker ? thpn : thdn;
+    uint32_t th_sum = attacker ? thdn : thpn;
+    path.push_back(key);
+    while (true) {
+        uint32_t least = INF;
+        uint32_t second = INF;
+        uint32_t sum = 0;
+        uint32_t best_sum_part = 0;
+        int best = 0;
+        int plies = attacker ? MAX_PLY : 0;
+        for (int i = 0; i < num_moves; i++) {
+            uint32_t pn, dn;
+            int child_plies;
+            lookup(child_keys[i], depth - 1, &pn, &dn, &child_plies);
+            uint32_t least_part = attacker ? pn : dn;
+            uint32_t sum_part = attacker ? dn : pn;
+            sum = std::min(INF, sum + sum_part);
+            if (least_part < least) {
+                second = least;
+                least = least_part;
+                best = i;
+                best_sum_part = sum_part;
+            } else if (least_part < second) {
+                second = least_part;
+            }
+            // the attacker takes the shortest mate, the defender the longest
+            if (pn == 0) {
+                plies = attacker ? std::min(plies, child_plies + 1)
+                                 : std::max(plies, child_plies + 1);
+            }
+        }
+        result.pn = attacker ? least : sum;
+        result.dn = attacker ? sum : least;
+        result.plies = result.pn == 0 ? plies : 0;
+        if (least >= th_least || sum >= th_sum || stopped) break;
+
+        // search the most promising child until it is no longer the best,
+        // or until this node would reach its own thresholds
+        uint32_t child_least = std::min(th_least, second + 1);
+        uint32_t child_sum = th_sum - sum + best_sum_part;
+        chessCore::Board child = pos;
+        child.doMoveInPlace(moves[best]);
+        mid(child, depth - 1, !attacker, attacker ? child_least : child_sum,
+            attacker ? child_sum : child_least);
+    }
+    path.pop_back();
+    result.work = static_cast<uint32_t>(
+            std::min<uint64_t>(nodes - nodes_before, UINT32_MAX));
+    store(result);
+}
+
+std::vector<chessCore::move_t> MateSolver::provenLine(
+        const chessCore::Board& root, int depth) {
+    std::vector<chessCore::move_t> line;
+    chessCore::Board pos = root;
+    bool attacker = true;
+    path.clear();
+
+    for (; depth > 0; depth--) {
+        chessCore::move_t moves[MAX_MOVES];
+        int num_moves = pos.getAllLegalMoves(moves);
+        int best = -1;
+        int best_plies = 0;
+        for (int attempt = 0; attempt < 2 && best < 0; attempt++) {
+            // the proof may have been overwritten since: prove it again
+            if (attempt == 1) {
+                chessCore::Board copy = pos;
+                mid(copy, depth, attacker, INF, INF);
+            }
+            for (int i = 0; i < num_moves; i++) {
+                chessCore::Board child = pos;
+                child.doMoveInPlace(moves[i]);
+                uint32_t pn, dn;
+                int plies;
+                lookup(child.getHashValue(), depth - 1, &pn, &dn, &plies);
+                if (pn != 0) continue;
+                if (best < 0 || (attacker ? plies < best_plies
+                                          : plies > best_plies)) {
+                    best = i;
+                    best_plies = plies;
+                }
+            }
+        }
+        if (best < 0) break;
+
+        path.push_back(pos.getHashValue());
+        line.push_back(moves[best]);
+        pos.doMoveInPlace(moves[best]);
+        attacker = !attacker;
+    }
+    path.clear();
+    return line;
+}
+
+MateResult MateSolver::solve(const chessCore::Board& root, int max_moves,
+                             StopCallback stop) {
+    MateResult result;
+    generation++;
+    nodes = 0;
+    stopped = false;
+    should_stop = std::move(stop);
+    path.clear();
+    if (table.empty()) resize(1);
+
+    max_moves = std::min(max_moves, MAX_MATE_MOVES);
+    uint64_t key = root.getHashValue();
+    for (int moves = 1; moves <= max_moves; moves++) {
+        int depth = 2 * moves - 1;
+        chessCore::Board pos = root;
+        mid(pos, depth, true, INF, INF);
+
+        uint32_t pn, dn;
+        int plies;
+        lookup(key, depth, &pn, &dn, &plies);
+        if (pn == 0) {
+            result.outcome = MateResult::mate_found;
+            result.mate_in = moves;
+            result.pv = provenLine(root, depth);
+            break;
+        }
+        if (dn != 0 || stopped) break;
+        result.no_mate_in = moves;
+    }
+    if (result.outcome != MateResult::mate_found &&
+        result.no_mate_in == max_moves) {
+        result.outcome = MateResult::no_mate;
+    }
+    result.nodes = nodes;
+    return result;
+}
+
+}   // namespace chessUCI
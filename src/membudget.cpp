@@ -0,0 +1,119 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "membudget.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace chessUCI {
+
+namespace {
+    const char* COMPONENT_NAMES[num_memory_components] = {
+        "hash", "matehash", "evalcache", "search", "network"
+    };
+
+    const size_t MEGABYTE = size_t{1} << 20;
+
+    /** Format a size in megabytes with one decimal. */
+    std::string format_megabytes(size_t bytes) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.1f",
+                      static_cast<double>(bytes) / MEGABYTE);
+        return buf;
+    }
+}   // namespace
+
+const char* memory_component_name(MemoryComponent component) {
+    return COMPONENT_NAMES[component];
+}
+
+MemoryBudget::MemoryBudget() {
+    limit = 0;
+    for (std::atomic<size_t>& u : used) u = 0;
+}
+
+void MemoryBudget::setLimit(size_t megabytes) {
+    limit = megabytes * MEGABYTE;
+}
+
+void MemoryBudget::charge(MemoryComponent component, size_t old_bytes,
+                          size_t new_bytes) {
+    used[component] += new_bytes;
+    used[component] -= old_bytes;
+}
+
+size_t MemoryBudget::getUsed(MemoryComponent component) const {
+    return used[component];
+}
+
+size_t MemoryBudget::totalUsed() const {
+    size_t total = 0;
+    for (const std::atomic<size_t>& u : used) total += u;
+    return total;
+}
+
+bool MemoryBudget::fit(size_t fixed_bytes, MemoryRequest* requests,
+                       int num_requests) const {
+    if (!limit) return true;
+
+    bool fits = true;
+    while (true) {
+        size_t total = fixed_bytes;
+        MemoryRequest* largest = nullptr;
+        for (int i = 0; i < num_requests; i++) {
+            MemoryRequest& r = requests[i];
+            size_t bytes = r.megabytes * r.copies * MEGABYTE;
+            total += bytes;
+            if (r.megabytes > r.min_megabytes &&
+                (!largest ||
+                 bytes > largest->megabytes * largest->copies * MEGABYTE)) {
+                largest = &r;
+            }
+        }
+        // over budget even at the smallest sizes: nothing more to give up
+        if (total <= limit || !largest) return fits;
+
+        largest->megabytes = std::max(largest->megabytes / 2,
+                                      largest->min_megabytes);
+        fits = false;
+    }
+}
+
+std::string MemoryBudget::report() const {
+    std::string text = "memory " + format_megabytes(totalUsed());
+    text += limit ? " of " + std::to_string(limit / MEGABYTE) + " MB:" :
+                    " MB, no budget:";
+    for (int c = 0; c < num_memory_components; c++) {
+        text += std::string(c ? ", " : " ") + COMPONENT_NAMES[c] + " " +
+                format_megabytes(used[c]) + " MB";
+    }
+    return text;
+}
+
+MemoryCharge::MemoryCharge(MemoryComponent component) :
+        component(component) {
+    budget = nullptr;
+    bytes = 0;
+}
+
+MemoryCharge::~MemoryCharge() {
+    set(0);
+}
+
+void MemoryCharge::attach(MemoryBudget* new_budget) {
+    if (budget) budget->charge(component, bytes, 0);
+    budget = new_budget;
+    if (budget) budget->charge(component, 0, bytes);
+}
+
+void MemoryCharge::set(size_t new_bytes) {
+    if (budget) budget->charge(component, bytes, new_bytes);
+    bytes = new_bytes;
+}
+
+}   // namespace chessUCI
@@ -0,0 +1,136 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+#define METRICS_POSIX
+#endif
+
+namespace chessUCI {
+
+namespace {
+    /** Write one metric with its help and type lines. */
+    template <typename T>
+    void metric(std::ostream& out, const char* name, const char* type,
+                const char* help, T value) {
+        out << "# HELP " << name << " " << help << "\n"
+            << "# TYPE " << name << " " << type << "\n"
+            << name << " " << value << "\n";
+    }
+}   // namespace
+
+double process_cpu_seconds() {
+#ifdef METRICS_POSIX
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#else
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+uint64_t resident_memory_bytes() {
+#ifdef __linux__
+    // the second field of statm is the resident size in pages
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size, resident;
+    if (statm >> size >> resident) {
+        return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return 0;
+}
+
+CpuMeter::CpuMeter() {
+    start();
+}
+
+void CpuMeter::start() {
+    start_cpu = process_cpu_seconds();
+    start_wall = std::chrono::steady_clock::now();
+}
+
+int CpuMeter::load(int num_threads) const {
+    double wall = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start_wall).count();
+    if (wall <= 0 || num_threads < 1) return 0;
+    double cpu = process_cpu_seconds() - start_cpu;
+    return std::min(1000, static_cast<int>(cpu / (wall * num_threads) *
+                                           1000));
+}
+
+Metrics::Metrics() {
+    searches = 0;
+    nodes = 0;
+    nps = 0;
+    hashfull = 0;
+    cpuload = 0;
+    threads = 0;
+    searching = false;
+}
+
+bool MetricsWriter::open(const std::string& new_path) {
+    path = new_path;
+    if (path.empty()) return true;
+
+    std::ofstream test(path + ".tmp");
+    if (!test) {
+        path.clear();
+        return false;
+    }
+    return true;
+}
+
+const std::string& MetricsWriter::getPath() const {
+    return path;
+}
+
+void MetricsWriter::write(const Metrics& metrics) {
+    if (path.empty()) return;
+
+    std::ostringstream out;
+    metric(out, "strawberry_searches_total", "counter",
+           "Searches started.", metrics.searches);
+    metric(out, "strawberry_nodes_total", "counter",
+           "Nodes searched by all searches.", metrics.nodes);
+    metric(out, "strawberry_nps", "gauge",
+           "Nodes per second of the current or last search.", metrics.nps);
+    metric(out, "strawberry_hashfull_permille", "gauge",
+           "How full the hash table is, out of 1000.", metrics.hashfull);
+    metric(out, "strawberry_cpu_load_permille", "gauge",
+           "CPU load of the current or last search over its threads, out "
+           "of 1000.", metrics.cpuload);
+    metric(out, "strawberry_cpu_seconds_total", "counter",
+           "CPU time used by the process.", process_cpu_seconds());
+    metric(out, "strawberry_resident_memory_bytes", "gauge",
+           "Memory of the process resident in RAM.", resident_memory_bytes());
+    metric(out, "strawberry_threads", "gauge", "Search threads.",
+           metrics.threads);
+    metric(out, "strawberry_searching", "gauge",
+           "Whether a search is running.", metrics.searching ? 1 : 0);
+
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp, std::ios::out | std::ios::trunc);
+        file << out.str();
+        if (!file) return;
+    }
+    std::rename(tmp.c_str(), path.c_str());
+}
+
+}   // namespace chessUCI
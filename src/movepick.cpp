@@ -0,0 +1,221 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "movepick.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace chessUCI {
+
+namespace {
+    /** The values of the piece types PNBRQK, for ordering captures. */
+    const int PIECE_VALUES[6] = {1, 3, 3, 5, 9, 20};
+
+    /** The largest history bonus, reached at depth 20. */
+    const int MAX_HISTORY_BONUS = 400;
+
+    /** Whether a move is searched with the captures. */
+    bool is_noisy(chessCore::move_t move) {
+        return move.is_capture() ||
+               (move.is_promotion() && move.special1() && move.special0());
+    }
+
+    /** Move a history score towards a bonus, slowing down near the limit. */
+    void apply_bonus(int16_t* entry, int bonus) {
+        *entry += bonus - *entry * std::abs(bonus) / MoveHistory::MAX_SCORE;
+    }
+}   // namespace
+
+MoveHistory::MoveHistory() {
+    clear();
+}
+
+void MoveHistory::clear() {
+    std::fill(&killers[0][0], &killers[0][0] + MAX_PLY * 2,
+              chessCore::move_t());
+    std::fill(&counter_moves[0][0], &counter_moves[0][0] + 64 * 64,
+              chessCore::move_t());
+    std::memset(history, 0, sizeof(history));
+}
+
+void MoveHistory::update(int side, chessCore::move_t move,
+                         chessCore::move_t previous,
+                         const chessCore::move_t* tried, int num_tried,
+                         int depth, int ply) {
+    if (killers[ply][0] != move) {
+        killers[ply][1] = killers[ply][0];
+        killers[ply][0] = move;
+    }
+    if (previous != chessCore::move_t()) {
+        counter_moves[previous.from_sq()][previous.to_sq()] = move;
+    }
+
+    int bonus = std::min(depth * depth, MAX_HISTORY_BONUS);
+    apply_bonus(&history[side][move.from_sq()][move.to_sq()], bonus);
+    for (int i = 0; i < num_tried; i++) {
+        apply_bonus(&history[side][tried[i].from_sq()][tried[i].to_sq()],
+                    -bonus);
+    }
+}
+
+MovePicker::MovePicker(chessCore::Board& pos, const nnue::Pieces& pieces,
+                       const MoveHistory& heuristics,
+                       chessCore::move_t tt_move,
+                       chessCore::move_t previous, int ply,
+                       bool noisy_only) :
+        pieces(pieces), heuristics(heuristics) {
+    num_moves = pos.getAllLegalMoves(moves);
+    end_noisy = std::partition(moves, moves + num_moves, is_noisy) - moves;
+    end_quiet = num_moves;
+    current = 0;
+    end = 0;
+    next_stage = stage_tt;
+    last_quiet = false;
+    this->noisy_only = noisy_only;
+
+    side = pos.getSide() == chessCore::white ? 0 : 1;
+    this->tt_move = noisy_only ? chessCore::move_t() : tt_move;
+    killers[0] = heuristics.killers[ply][0];
+    killers[1] = heuristics.killers[ply][1];
+    counter = previous == chessCore::move_t() ? chessCore::move_t() :
+              heuristics.counter_moves[previous.from_sq()][previous.to_sq()];
+}
+
+MovePicker::MovePicker(const RootMoves& root_moves,
+                       const nnue::Pieces& pieces,
+                       const MoveHistory& heuristics) :
+        pieces(pieces), heuristics(heuristics) {
+    num_moves = root_moves.size();
+    for (int i = 0; i < num_moves; i++) moves[i] = root_moves[i].move;
+    end_noisy = 0;
+    end_quiet = num_moves;
+    current = 0;
+    end = num_moves;
+    next_stage = stage_root;
+    last_quiet = false;
+    noisy_only = false;
+
+    side = 0;
+    killers[0] = chessCore::move_t();
+    killers[1] = chessCore::move_t();
+    counter = chessCore::move_t();
+}
+
+bool MovePicker::takeQuiet(chessCore::move_t move) {
+    if (move == chessCore::move_t() || move == tt_move) return false;
+    for (int i = end_noisy; i < end_quiet; i++) {
+        if (moves[i] == move) {
+            std::swap(moves[i], moves[--end_quiet]);
+            return true;
+        }
+    }
+    return false;
+}
+
+chessCore::move_t MovePicker::pickBest() {
+    while (current < end) {
+        int best = current;
+        for (int i = current + 1; i < end; i++) {
+            if (scores[i] > scores[best]) best = i;
+        }
+        std::swap(moves[best], moves[current]);
+        std::swap(scores[best], scores[current]);
+        chessCore::move_t move = moves[current++];
+        if (move != tt_move) return move;
+    }
+    return chessCore::move_t();
+}
+
+chessCore::move_t MovePicker::next() {
+    chessCore::move_t move;
+    switch (next_stage) {
+        case stage_root:
+            if (current == end) break;
+            last_quiet = !is_noisy(moves[current]);
+            return moves[current++];
+        case stage_tt:
+            next_stage = stage_init_noisy;
+            if (tt_move != chessCore::move_t() &&
+                std::find(moves, moves + num_moves, tt_move) !=
+                moves + num_moves) {
+                last_quiet = !is_noisy(tt_move);
+                return tt_move;
+            }
+            tt_move = chessCore::move_t();
+            // fall through
+        case stage_init_noisy:
+            // most valuable victim, then least valuable attacker
+            for (int i = 0; i < end_noisy; i++) {
+                int attacker = pieces.at(moves[i].from_sq());
+                int victim = pieces.at(moves[i].to_sq());
+                scores[i] = moves[i].is_promotion() ? PIECE_VALUES[4] : 0;
+                // an empty target square means en passant
+                if (moves[i].is_capture()) {
+                    scores[i] += victim == nnue::Pieces::NONE ?
+                                 PIECE_VALUES[0] : PIECE_VALUES[victim % 6];
+                }
+                scores[i] = scores[i] * 64 -
+                            (attacker == nnue::Pieces::NONE ? 0 :
+                             PIECE_VALUES[attacker % 6]);
+            }
+            current = 0;
+            end = end_noisy;
+            next_stage = stage_noisy;
+            // fall through
+        case stage_noisy:
+            move = pickBest();
+            if (move != chessCore::move_t()) {
+                last_quiet = false;
+                return move;
+            }
+            if (noisy_only) {
+                next_stage = stage_done;
+                return chessCore::move_t();
+            }
+            last_quiet = true;
+            next_stage = stage_killer_1;
+            // fall through
+        case stage_killer_1:
+            next_stage = stage_killer_2;
+            if (takeQuiet(killers[0])) return killers[0];
+            // fall through
+        case stage_killer_2:
+            next_stage = stage_counter;
+            if (killers[1] != killers[0] && takeQuiet(killers[1])) {
+                return killers[1];
+            }
+            // fall through
+        case stage_counter:
+            next_stage = stage_init_quiet;
+            if (counter != killers[0] && counter != killers[1] &&
+                takeQuiet(counter)) {
+                return counter;
+            }
+            // fall through
+        case stage_init_quiet:
+            for (int i = end_noisy; i < end_quiet; i++) {
+                scores[i] = heuristics.history[side][moves[i].from_sq()]
+                                              [moves[i].to_sq()];
+            }
+            current = end_noisy;
+            end = end_quiet;
+            next_stage = stage_quiet;
+            // fall through
+        case stage_quiet:
+            move = pickBest();
+            if (move != chessCore::move_t()) return move;
+            next_stage = stage_done;
+            // fall through
+        case stage_done:
+            break;
+    }
+    return chessCore::move_t();
+}
+
+}   // namespace chessUCI
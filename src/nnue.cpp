@@ -0,0 +1,483 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "nnue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NNUE_X86
+#include <immintrin.h>
+#endif
+
+namespace chessUCI {
+
+namespace nnue {
+
+namespace {
+    const char START_PLACEMENT[] =
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR";
+    const char PIECE_CHARS[] = "PNBRQKpnbrqk";
+    const int KNIGHT = 1;
+    const int ROOK = 3;
+
+    const char MAGIC[4] = {'S', 'B', 'N', 'N'};
+    const uint32_t VERSION = 1;
+    const size_t HEADER_SIZE = 16;
+
+    uint32_t read_u32(const char* data) {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    void scalar_add_sub(int16_t* out, const int16_t* in,
+                        const int16_t* const* add, int num_add,
+                        const int16_t* const* sub, int num_sub) {
+        for (int i = 0; i < HIDDEN; i++) {
+            int16_t value = in[i];
+            for (int a = 0; a < num_add; a++) value += add[a][i];
+            for (int s = 0; s < num_sub; s++) value -= sub[s][i];
+            out[i] = value;
+        }
+    }
+
+    int32_t scalar_output(const int16_t* us, const int16_t* them,
+                          const int16_t* weights) {
+        int32_t sum = 0;
+        for (int i = 0; i < HIDDEN; i++) {
+            int32_t a = std::min<int32_t>(std::max<int32_t>(us[i], 0), QA);
+            int32_t b = std::min<int32_t>(std::max<int32_t>(them[i], 0), QA);
+            sum += a * weights[i] + b * weights[HIDDEN + i];
+        }
+        return sum;
+    }
+
+    const Kernel SCALAR_KERNEL = {"scalar", scalar_add_sub, scalar_output};
+
+#ifdef NNUE_X86
+    __attribute__((target("sse4.1")))
+    void sse41_add_sub(int16_t* out, const int16_t* in,
+                       const int16_t* const* add, int num_add,
+                       const int16_t* const* sub, int num_sub) {
+        for (int i = 0; i < HIDDEN; i += 8) {
+            __m128i v = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(in + i));
+            for (int a = 0; a < num_add; a++) {
+                v = _mm_add_epi16(v, _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(add[a] + i)));
+            }
+            for (int s = 0; s < num_sub; s++) {
+                v = _mm_sub_epi16(v, _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(sub[s] + i)));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+        }
+    }
+
+    __attribute__((target("sse4.1")))
+    int32_t sse41_output(const int16_t* us, const int16_t* them,
+                         const int16_t* weights) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i qa = _mm_set1_epi16(QA);
+        __m128i sum = zero;
+        for (int i = 0; i < HIDDEN; i += 8) {
+            __m128i a = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(us + i));
+            __m128i b = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(them + i));
+            a = _mm_min_epi16(_mm_max_epi16(a, zero), qa);
+            b = _mm_min_epi16(_mm_max_epi16(b, zero), qa);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(a, _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(weights + i))));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(b, _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(weights + HIDDEN + i))));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+        return _mm_cvtsi128_si32(sum);
+    }
+
+    const Kernel SSE41_KERNEL = {"sse4.1", sse41_add_sub, sse41_output};
+
+    __attribute__((target("avx2")))
+    void avx2_add_sub(int16_t* out, const int16_t* in,
+                      const int16_t* const* add, int num_add,
+                      const int16_t* const* sub, int num_sub) {
+        for (int i = 0; i < HIDDEN; i += 16) {
+            __m256i v = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(in + i));
+            for (int a = 0; a < num_add; a++) {
+                v = _mm256_add_epi16(v, _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i*>(add[a] + i)));
+            }
+            for (int s = 0; s < num_sub; s++) {
+                v = _mm256_sub_epi16(v, _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i*>(sub[s] + i)));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), v);
+        }
+    }
+
+    __attribute__((target("avx2")))
+    int32_t avx2_output(const int16_t* us, const int16_t* them,
+                        const int16_t* weights) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i qa = _mm256_set1_epi16(QA);
+        __m256i sum = zero;
+        for (int i = 0; i < HIDDEN; i += 16) {
+            __m256i a = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(us + i));
+            __m256i b = _mm256_loadu_si256(
+                    reinterpret_cast<const __m256i*>(them + i));
+            a = _mm256_min_epi16(_mm256_max_epi16(a, zero), qa);
+            b = _mm256_min_epi16(_mm256_max_epi16(b, zero), qa);
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(
+                    a, _mm256_loadu_si256(
+                            reinterpret_cast<const __m256i*>(weights + i))));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(
+                    b, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(
+                            weights + HIDDEN + i))));
+        }
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                     _mm256_extracti128_si256(sum, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+        return _mm_cvtsi128_si32(half);
+    }
+
+    const Kernel AVX2_KERNEL = {"avx2", avx2_add_sub, avx2_output};
+
+    __attribute__((target("avx512f,avx512bw")))
+    void avx512_add_sub(int16_t* out, const int16_t* in,
+                        const int16_t* const* add, int num_add,
+                        const int16_t* const* sub, int num_sub) {
+        for (int i = 0; i < HIDDEN; i += 32) {
+            __m512i v = _mm512_loadu_si512(in + i);
+            for (int a = 0; a < num_add; a++) {
+                v = _mm512_add_epi16(v, _mm512_loadu_si512(add[a] + i));
+            }
+            for (int s = 0; s < num_sub; s++) {
+                v = _mm512_sub_epi16(v, _mm512_loadu_si512(sub[s] + i));
+            }
+            _mm512_storeu_si512(out + i, v);
+        }
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    int32_t avx512_output(const int16_t* us, const int16_t* them,
+                          const int16_t* weights) {
+        const __m512i zero = _mm512_setzero_si512();
+        const __m512i qa = _mm512_set1_epi16(QA);
+        __m512i sum = zero;
+        for (int i = 0; i < HIDDEN; i += 32) {
+            __m512i a = _mm512_loadu_si512(us + i);
+            __m512i b = _mm512_loadu_si512(them + i);
+            a = _mm512_min_epi16(_mm512_max_epi16(a, zero), qa);
+            b = _mm512_min_epi16(_mm512_max_epi16(b, zero), qa);
+            sum = _mm512_add_epi32(sum, _mm512_madd_epi16(
+                    a, _mm512_loadu_si512(weights + i)));
+            sum = _mm512_add_epi32(sum, _mm512_madd_epi16(
+                    b, _mm512_loadu_si512(weights + HIDDEN + i)));
+        }
+        // GCC's 512-bit reduction intrinsics trip -Wuninitialized
+        int32_t lanes[16];
+        _mm512_storeu_si512(lanes, sum);
+        int32_t total = 0;
+        for (int32_t lane : lanes) total += lane;
+        return total;
+    }
+
+    const Kernel AVX512_KERNEL = {"avx512", avx512_add_sub, avx512_output};
+#endif
+}   // namespace
+
+const int8_t Pieces::NONE;
+
+Pieces::Pieces() {
+    setFen("startpos");
+}
+
+bool Pieces::setFen(const std::string& fen) {
+    std::string placement = fen == "startpos" ? START_PLACEMENT :
+                            fen.substr(0, fen.find(' '));
+    std::fill(squares, squares + 64, NONE);
+
+    int rank = 7;
+    int file = 0;
+    for (char c : placement) {
+        if (c == '/') {
+            if (file != 8 || rank == 0) break;
+            rank--;
+            file = 0;
+        } else if (c >= '1' && c <= '8') {
+            file += c - '0';
+        } else {
+            const char* found = std::strchr(PIECE_CHARS, c);
+            if (!found || c == '\0' || file > 7) break;
+            squares[rank * 8 + file++] = found - PIECE_CHARS;
+        }
+        if (file > 8) break;
+    }
+    if (rank != 0 || file != 8) {
+        std::fill(squares, squares + 64, NONE);
+        return false;
+    }
+    return true;
+}
+
+void Pieces::doMove(chessCore::move_t move, Changes* changes) {
+    Changes local;
+    Changes& c = changes ? *changes : local;
+    c.num_added = 0;
+    c.num_removed = 0;
+
+    int from = move.from_sq();
+    int to = move.to_sq();
+    int8_t piece = squares[from];
+    if (piece == NONE) return;
+
+    if (move.is_capture()) {
+        // en passant is the only capture with special bits 01
+        bool en_passant = !move.is_promotion() && !move.special1() &&
+                          move.special0();
+        int captured = en_passant ? to ^ 8 : to;
+        if (squares[captured] != NONE) {
+            c.removed[c.num_removed++] = {squares[captured],
+                                          static_cast<uint8_t>(captured)};
+            squares[captured] = NONE;
+        }
+    } else if (!move.is_promotion() && move.special1()) {
+        // castling: special bit 0 tells the queen side from the king side
+        int rook_from = move.special0() ? to - 2 : to + 1;
+        int rook_to = move.special0() ? to + 1 : to - 1;
+        int8_t rook = squares[rook_from];
+        if (rook % 6 == ROOK) {
+            c.removed[c.num_removed++] = {rook,
+                                          static_cast<uint8_t>(rook_from)};
+            c.added[c.num_added++] = {rook, static_cast<uint8_t>(rook_to)};
+            squares[rook_from] = NONE;
+            squares[rook_to] = rook;
+        }
+    }
+
+    int8_t placed = piece;
+    if (move.is_promotion()) {
+        placed = piece / 6 * 6 + KNIGHT + move.special1() * 2 +
+                 move.special0();
+    }
+    c.removed[c.num_removed++] = {piece, static_cast<uint8_t>(from)};
+    c.added[c.num_added++] = {placed, static_cast<uint8_t>(to)};
+    squares[from] = NONE;
+    squares[to] = placed;
+}
+
+std::vector<const Kernel*> supportedKernels() {
+    std::vector<const Kernel*> kernels;
+#ifdef NNUE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) kernels.push_back(&AVX512_KERNEL);
+    if (__builtin_cpu_supports("avx2")) kernels.push_back(&AVX2_KERNEL);
+    if (__builtin_cpu_supports("sse4.1")) kernels.push_back(&SSE41_KERNEL);
+#endif
+    kernels.push_back(&SCALAR_KERNEL);
+    return kernels;
+}
+
+const size_t Network::FILE_SIZE = HEADER_SIZE +
+        sizeof(int16_t) * (NUM_FEATURES * HIDDEN + HIDDEN + 2 * HIDDEN) +
+        sizeof(int32_t);
+
+Network::Network() {
+    mapping = nullptr;
+    feature_weights = nullptr;
+    feature_biases = nullptr;
+    output_weights = nullptr;
+    output_bias = 0;
+    kernel = supportedKernels().front();
+}
+
+Network::~Network() {
+    unload();
+}
+
+bool Network::attach(const char* data, std::string* error) {
+    if (std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        *error = "not a network file";
+        return false;
+    }
+    if (read_u32(data + 4) != VERSION) {
+        *error = "unsupported version " + std::to_string(read_u32(data + 4));
+        return false;
+    }
+    if (read_u32(data + 8) != NUM_FEATURES || read_u32(data + 12) != HIDDEN) {
+        *error = "unsupported architecture";
+        return false;
+    }
+
+    const int16_t* weights = reinterpret_cast<const int16_t*>(
+                                data + HEADER_SIZE);
+    feature_weights = weights;
+    feature_biases = weights + NUM_FEATURES * HIDDEN;
+    output_weights = feature_biases + HIDDEN;
+    std::memcpy(&output_bias, output_weights + 2 * HIDDEN,
+                sizeof(output_bias));
+    return true;
+}
+
+bool Network::load(const std::string& new_path, std::string* error) {
+    unload();
+    const char* data;
+#ifdef __linux__
+    int fd = open(new_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        *error = "cannot open file";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != FILE_SIZE) {
+        close(fd);
+        *error = "wrong file size";
+        return false;
+    }
+    void* mem = mmap(nullptr, FILE_SIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        *error = "cannot map file";
+        return false;
+    }
+    mapping = mem;
+    data = static_cast<const char*>(mem);
+#else
+    std::ifstream file(new_path, std::ios::in | std::ios::binary);
+    if (!file) {
+        *error = "cannot open file";
+        return false;
+    }
+    buffer.resize(FILE_SIZE + 1);
+    file.read(buffer.data(), buffer.size());
+    if (static_cast<size_t>(file.gcount()) != FILE_SIZE) {
+        unload();
+        *error = "wrong file size";
+        return false;
+    }
+    data = buffer.data();
+#endif
+
+    if (!attach(data, error)) {
+        unload();
+        return false;
+    }
+    path = new_path;
+    return true;
+}
+
+void Network::loadRandom(uint64_t seed) {
+    unload();
+    buffer.assign(FILE_SIZE, 0);
+    std::memcpy(buffer.data(), MAGIC, sizeof(MAGIC));
+    uint32_t header[3] = {VERSION, NUM_FEATURES, HIDDEN};
+    std::memcpy(buffer.data() + 4, header, sizeof(header));
+
+    size_t num_weights = NUM_FEATURES * HIDDEN + 3 * HIDDEN;
+    for (size_t i = 0; i < num_weights; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        int16_t weight = static_cast<int16_t>((seed >> 33) % 128) - 64;
+        std::memcpy(buffer.data() + HEADER_SIZE + i * sizeof(int16_t),
+                    &weight, sizeof(weight));
+    }
+
+    std::string error;
+    attach(buffer.data(), &error);
+}
+
+void Network::unload() {
+#ifdef __linux__
+    if (mapping) munmap(mapping, FILE_SIZE);
+#endif
+    mapping = nullptr;
+    std::vector<char>().swap(buffer);
+    path.clear();
+    feature_weights = nullptr;
+    feature_biases = nullptr;
+    output_weights = nullptr;
+    output_bias = 0;
+}
+
+const std::string& Network::getPath() const {
+    return path;
+}
+
+const Kernel& Network::getKernel() const {
+    return *kernel;
+}
+
+void Network::setKernel(const Kernel& new_kernel) {
+    kernel = &new_kernel;
+}
+
+const int16_t* Network::row(int side, Pieces::Change change) const {
+    int feature = side == 0 ? change.piece * 64 + change.square :
+                  (change.piece + 6) % 12 * 64 + (change.square ^ 56);
+    return feature_weights + feature * HIDDEN;
+}
+
+void Network::refresh(const Pieces& pieces, Accumulator* acc) const {
+    for (int side = 0; side < 2; side++) {
+        const int16_t* rows[32];
+        int num_rows = 0;
+        for (int square = 0; square < 64 && num_rows < 32; square++) {
+            if (pieces.at(square) == Pieces::NONE) continue;
+            Pieces::Change change = {pieces.at(square),
+                                     static_cast<uint8_t>(square)};
+            rows[num_rows++] = row(side, change);
+        }
+        kernel->addSub(acc->values[side], feature_biases, rows, num_rows,
+                       nullptr, 0);
+    }
+}
+
+void Network::update(const Accumulator& parent,
+                     const Pieces::Changes& changes,
+                     Accumulator* acc) const {
+    for (int side = 0; side < 2; side++) {
+        const int16_t* added[2];
+        const int16_t* removed[2];
+        for (int i = 0; i < changes.num_added; i++) {
+            added[i] = row(side, changes.added[i]);
+        }
+        for (int i = 0; i < changes.num_removed; i++) {
+            removed[i] = row(side, changes.removed[i]);
+        }
+        kernel->addSub(acc->values[side], parent.values[side],
+                       added, changes.num_added,
+                       removed, changes.num_removed);
+    }
+}
+
+chessCore::value_t Network::evaluate(const Accumulator& acc,
+                                     chessCore::colour side) const {
+    int us = side == chessCore::white ? 0 : 1;
+    int64_t sum = kernel->output(acc.values[us], acc.values[1 - us],
+                                 output_weights) + int64_t{output_bias};
+    return static_cast<chessCore::value_t>(sum * OUTPUT_SCALE / (QA * QB));
+}
+
+}   // namespace nnue
+
+}   // namespace chessUCI
@@ -0,0 +1,159 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "numa.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace chessUCI {
+
+namespace {
+    /** Parse a sysfs CPU list such as "0-7,16-23". */
+    std::vector<int> parse_cpu_list(std::string list) {
+        std::vector<int> cpus;
+        std::stringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ',')) {
+            if (range.empty()) continue;
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ?
+                       first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+#ifdef __linux__
+    /** The mbind(2) mode that interleaves pages, from <numaif.h>. */
+    const int MPOL_INTERLEAVE_MODE = 3;
+#endif
+}   // namespace
+
+bool numa_policy_from_string(std::string name, NumaPolicy* policy) {
+    if (name == "auto") {
+        *policy = numa_auto;
+    } else if (name == "interleave") {
+        *policy = numa_interleave;
+    } else if (name == "firsttouch") {
+        *policy = numa_firsttouch;
+    } else if (name == "none") {
+        *policy = numa_none;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string numa_policy_to_string(NumaPolicy policy) {
+    switch (policy) {
+        case numa_interleave:
+            return "interleave";
+        case numa_firsttouch:
+            return "firsttouch";
+        case numa_none:
+            return "none";
+        default:
+            return "auto";
+    }
+}
+
+NumaTopology::NumaTopology() {
+#ifdef __linux__
+    std::vector<int> ids;
+    DIR* dir = opendir("/sys/devices/system/node");
+    if (dir) {
+        while (struct dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") != 0 || name.size() == 4) continue;
+            if (!std::all_of(name.begin() + 4, name.end(), ::isdigit)) continue;
+            ids.push_back(std::stoi(name.substr(4)));
+        }
+        closedir(dir);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    for (int id : ids) {
+        std::ifstream file("/sys/devices/system/node/node" +
+                           std::to_string(id) + "/cpulist");
+        std::string list;
+        if (!std::getline(file, list)) continue;
+        try {
+            std::vector<int> cpus = parse_cpu_list(list);
+            // memory-only nodes have no CPUs to run threads on
+            if (cpus.empty()) continue;
+            node_ids.push_back(id);
+            node_cpus.push_back(cpus);
+        } catch (const std::exception&) {
+            continue;
+        }
+    }
+#endif
+
+    if (node_cpus.empty()) {
+        node_ids.push_back(0);
+        node_cpus.emplace_back();
+    }
+}
+
+int NumaTopology::numNodes() const {
+    return node_cpus.size();
+}
+
+const std::vector<int>& NumaTopology::cpus(int node) const {
+    return node_cpus[node];
+}
+
+int NumaTopology::nodeForThread(int thread_id) const {
+    return thread_id % numNodes();
+}
+
+bool NumaTopology::bindThisThread(int node) const {
+#ifdef __linux__
+    if (numNodes() < 2 || cpus(node).empty()) return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus(node)) {
+        if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+bool NumaTopology::interleave(void* addr, size_t size) const {
+#if defined(__linux__) && defined(SYS_mbind)
+    if (numNodes() < 2) return false;
+
+    // node ids are small, so one word of mask is enough in practice
+    unsigned long mask = 0;
+    for (int id : node_ids) {
+        if (id < 64) mask |= 1UL << id;
+    }
+    return syscall(SYS_mbind, addr, size, MPOL_INTERLEAVE_MODE, &mask,
+                   sizeof(mask) * 8, 0) == 0;
+#else
+    return false;
+#endif
+}
+
+}   // namespace chessUCI
@@ -0,0 +1,197 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "options.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <vector>
+
+namespace chessUCI {
+
+namespace {
+    std::string lower_string(std::string s) {
+        std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+        return s;
+    }
+
+    bool parse_int(const std::string& s, int* value) {
+        size_t start = (!s.empty() && s[0] == '-') ? 1 : 0;
+        if (s.size() == start || s.size() - start > 9) return false;
+        for (size_t i = start; i < s.size(); i++) {
+            if (s[i] < '0' || s[i] > '9') return false;
+        }
+        *value = std::stoi(s);
+        return true;
+    }
+}   // namespace
+
+OptionValues::OptionValues() {
+    hash = 0;
+    threads = 0;
+    move_overhead = 0;
+    tree_reuse = false;
+    deterministic = false;
+    show_currline = false;
+    show_refutations = false;
+    mate_hash = 0;
+    eval_cache = 0;
+    memory_budget = 0;
+    aspiration_window = 0;
+    rfp_margin = 0;
+    rfp_depth = 0;
+    futility_margin = 0;
+    futility_depth = 0;
+    lmr_base = 0;
+    lmr_divisor = 0;
+    lmr_min_depth = 0;
+}
+
+OptionRegistry::Option::Option() {
+    int_field = nullptr;
+    bool_field = nullptr;
+    string_field = nullptr;
+    needs_apply = false;
+}
+
+OptionRegistry::OptionRegistry() {
+    current = std::make_shared<const OptionValues>();
+}
+
+const OptionRegistry::Option* OptionRegistry::find(
+            const std::string& name) const {
+    std::string lower = lower_string(name);
+    for (const Option& option : options) {
+        if (lower_string(option.message.name) == lower) return &option;
+    }
+    return nullptr;
+}
+
+void OptionRegistry::publish(const OptionValues& values) {
+    std::atomic_store(&current,
+                      std::make_shared<const OptionValues>(values));
+}
+
+void OptionRegistry::add(const Option& option) {
+    options.push_back(option);
+    set(option.message.name, option.message.option_default);
+}
+
+void OptionRegistry::addSpin(std::string name, int OptionValues::* field,
+                             int value, int min, int max, bool needs_apply) {
+    Option option;
+    option.message.name = name;
+    option.message.type = MessageTypes::spin_type;
+    option.message.option_default = std::to_string(value);
+    option.message.option_min = std::to_string(min);
+    option.message.option_max = std::to_string(max);
+    option.int_field = field;
+    option.needs_apply = needs_apply;
+    add(option);
+}
+
+void OptionRegistry::addCheck(std::string name, bool OptionValues::* field,
+                              bool value, bool needs_apply) {
+    Option option;
+    option.message.name = name;
+    option.message.type = MessageTypes::check_type;
+    option.message.option_default = value ? "true" : "false";
+    option.bool_field = field;
+    option.needs_apply = needs_apply;
+    add(option);
+}
+
+void OptionRegistry::addCombo(std::string name,
+                              std::string OptionValues::* field,
+                              std::string value,
+                              std::vector<std::string> vars,
+                              bool needs_apply) {
+    Option option;
+    option.message.name = name;
+    option.message.type = MessageTypes::combo_type;
+    option.message.option_default = value;
+    option.message.vars = vars;
+    option.string_field = field;
+    option.needs_apply = needs_apply;
+    add(option);
+}
+
+void OptionRegistry::addString(std::string name,
+                               std::string OptionValues::* field,
+                               std::string value, bool needs_apply) {
+    Option option;
+    option.message.name = name;
+    option.message.type = MessageTypes::string_type;
+    option.message.option_default = value;
+    option.string_field = field;
+    option.needs_apply = needs_apply;
+    add(option);
+}
+
+void OptionRegistry::addButton(std::string name,
+                               std::function<void()> on_press) {
+    Option option;
+    option.message.name = name;
+    option.message.type = MessageTypes::button_type;
+    option.on_press = on_press;
+    options.push_back(option);
+}
+
+std::vector<MessageTypes::OptionMessage> OptionRegistry::messages() const {
+    std::vector<MessageTypes::OptionMessage> result;
+    for (const Option& option : options) result.push_back(option.message);
+    return result;
+}
+
+OptionRegistry::SetResult OptionRegistry::set(const std::string& name,
+                                              const std::string& value) {
+    const Option* option = find(name);
+    if (!option) return set_invalid;
+
+    OptionValues values = this->values();
+    switch (option->message.type) {
+        case MessageTypes::spin_type: {
+            int number;
+            if (!parse_int(value, &number)) return set_invalid;
+            int min = std::stoi(option->message.option_min);
+            int max = std::stoi(option->message.option_max);
+            values.*(option->int_field) = std::max(min, std::min(max, number));
+            break;
+        }
+        case MessageTypes::check_type: {
+            std::string lower = lower_string(value);
+            if (lower != "true" && lower != "false") return set_invalid;
+            values.*(option->bool_field) = lower == "true";
+            break;
+        }
+        case MessageTypes::combo_type: {
+            auto var = std::find_if(option->message.vars.begin(),
+                                    option->message.vars.end(),
+                                    [&](const std::string& v) {
+                                        return lower_string(v) ==
+                                               lower_string(value);
+                                    });
+            if (var == option->message.vars.end()) return set_invalid;
+            values.*(option->string_field) = *var;
+            break;
+        }
+        case MessageTypes::string_type:
+            values.*(option->string_field) = value == "<empty>" ? "" : value;
+            break;
+        case MessageTypes::button_type:
+            if (option->on_press) option->on_press();
+            return set_ok;
+        default:
+            return set_invalid;
+    }
+
+    publish(values);
+    return option->needs_apply ? set_needs_apply : set_ok;
+}
+
+}   // namespace chessUCI
@@ -0,0 +1,130 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "pgn.h"
+
+#include <cctype>
+#include <cstring>
+#include <string>
+
+namespace chessUCI {
+
+namespace {
+    /** Characters that end a movetext token. */
+    const char TOKEN_DELIMITERS[] = "{}()[];";
+
+    bool is_result(const std::string& token) {
+        return token == "1-0" || token == "0-1" || token == "1/2-1/2" ||
+               token == "*";
+    }
+}   // namespace
+
+std::string PgnGame::tag(const std::string& name) const {
+    for (const auto& tag : tags) {
+        if (tag.first == name) return tag.second;
+    }
+    return "";
+}
+
+PgnReader::PgnReader(std::istream& in) : in(in) {
+}
+
+void PgnReader::skipBlock(char open) {
+    int depth = 1;
+    char close = open == '{' ? '}' : ')';
+    char c;
+    while (depth > 0 && in.get(c)) {
+        // comments don't nest, variations do and may contain comments
+        if (c == close) {
+            depth--;
+        } else if (open == '(' && c == '(') {
+            depth++;
+        } else if (open == '(' && c == '{') {
+            skipBlock('{');
+        }
+    }
+}
+
+void PgnReader::readTag(PgnGame* game) {
+    std::string name;
+    std::string value;
+    char c;
+    while (in.get(c) && std::isspace(static_cast<unsigned char>(c))) {}
+    while (in && !std::isspace(static_cast<unsigned char>(c)) && c != '"' &&
+           c != ']') {
+        name += c;
+        in.get(c);
+    }
+    while (in && c != '"' && c != ']') in.get(c);
+    if (c == '"') {
+        while (in.get(c) && c != '"') {
+            if (c == '\\') in.get(c);
+            value += c;
+        }
+        while (in && c != ']') in.get(c);
+    }
+    game->tags.emplace_back(name, value);
+}
+
+bool PgnReader::next(PgnGame* game) {
+    *game = PgnGame();
+    bool started = false;
+    char c;
+    while (in.get(c)) {
+        if (std::isspace(static_cast<unsigned char>(c))) continue;
+        started = true;
+
+        if (c == '[') {
+            // a game without a termination marker ends at the next tags
+            if (!game->moves.empty()) {
+                in.unget();
+                return true;
+            }
+            readTag(game);
+        } else if (c == '{' || c == '(') {
+            skipBlock(c);
+        } else if (c == ';' || c == '%') {
+            std::string line;
+            std::getline(in, line);
+        } else {
+            std::string token(1, c);
+            while (in.get(c)) {
+                if (std::isspace(static_cast<unsigned char>(c)) ||
+                    std::strchr(TOKEN_DELIMITERS, c)) {
+                    in.unget();
+                    break;
+                }
+                token += c;
+            }
+
+            if (is_result(token)) {
+                game->result = token;
+                return true;
+            }
+            if (token[0] == '$') continue;
+
+            // "12.", "12...", or a move glued to its number as in "12.e4"
+            size_t start = 0;
+            while (start < token.size() &&
+                   std::isdigit(static_cast<unsigned char>(token[start]))) {
+                start++;
+            }
+            if (start < token.size() && token[start] == '.') {
+                while (start < token.size() && token[start] == '.') start++;
+            } else {
+                start = 0;
+            }
+            size_t end = token.find_first_of("!?", start);
+            if (end == std::string::npos) end = token.size();
+            if (end > start) game->moves.push_back(token.substr(start,
+                                                                end - start));
+        }
+    }
+    return started;
+}
+
+}   // namespace chessUCI
@@ -0,0 +1,626 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "position.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace chessUCI {
+
+namespace {
+    typedef chessCore::bitboard bitboard;
+
+    const char PIECE_CHARS[] = "PNBRQKpnbrqk";
+    const char CASTLING_CHARS[] = "KQkq";
+    const char START_FEN[] =
+            "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+    const int PAWN = 0;
+    const int KNIGHT = 1;
+    const int BISHOP = 2;
+    const int ROOK = 3;
+    const int QUEEN = 4;
+    const int KING = 5;
+
+    const bitboard RANK_1 = 0xffULL;
+
+    /** The hash keys of pieces on squares, castling rights and so on. */
+    uint64_t piece_keys[12][64];
+    uint64_t castling_keys[16];
+    uint64_t en_passant_keys[8];
+    uint64_t side_key;
+
+    /** The attacks of knights, kings and pawns of each side. */
+    bitboard knight_attacks[64];
+    bitboard king_attacks[64];
+    bitboard pawn_attacks[2][64];
+
+    /** The squares strictly between two squares on a line, or none. */
+    bitboard between[64][64];
+    /** The whole line through two squares, or none. */
+    bitboard line[64][64];
+
+    /** The castling rights kept when a piece leaves or lands on a square. */
+    uint8_t castling_masks[64];
+
+    std::once_flag init_flag;
+
+    /** The number of a piece of a side. */
+    int piece_of(int colour, int type) {
+        return colour * 6 + type;
+    }
+
+    bitboard square_bit(int square) {
+        return bitboard{1} << square;
+    }
+
+    /** The index of the lowest set bit, which must exist. */
+    int lsb(bitboard b) {
+#ifdef __GNUC__
+        return __builtin_ctzll(b);
+#else
+        int square = 0;
+        while (!(b & 1)) {
+            b >>= 1;
+            square++;
+        }
+        return square;
+#endif
+    }
+
+    /** Remove the lowest set bit and return its index. */
+    int pop_lsb(bitboard* b) {
+        int square = lsb(*b);
+        *b &= *b - 1;
+        return square;
+    }
+
+    chessCore::move_t make_move(int from, int to, bool promotion,
+                                bool capture, bool special1, bool special0) {
+        return chessCore::move_t(from, to, promotion, capture, special1,
+                                 special0);
+    }
+
+    /** The attacks of a leaper, from its offsets in files and ranks. */
+    bitboard leaper_attacks(int square, const int offsets[][2],
+                            int num_offsets) {
+        bitboard attacks = 0;
+        for (int i = 0; i < num_offsets; i++) {
+            int file = square % 8 + offsets[i][0];
+            int rank = square / 8 + offsets[i][1];
+            if (file >= 0 && file < 8 && rank >= 0 && rank < 8) {
+                attacks |= square_bit(rank * 8 + file);
+            }
+        }
+        return attacks;
+    }
+
+    void init_tables() {
+        attacks::init();
+
+        const int KNIGHT_OFFSETS[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2},
+                                          {-1, -2}, {-2, -1}, {-2, 1},
+                                          {-1, 2}};
+        const int KING_OFFSETS[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1},
+                                        {-1, 0}, {-1, -1}, {0, -1},
+                                        {1, -1}};
+        const int WHITE_PAWN_OFFSETS[2][2] = {{-1, 1}, {1, 1}};
+        const int BLACK_PAWN_OFFSETS[2][2] = {{-1, -1}, {1, -1}};
+        for (int square = 0; square < 64; square++) {
+            knight_attacks[square] = leaper_attacks(square, KNIGHT_OFFSETS, 8);
+            king_attacks[square] = leaper_attacks(square, KING_OFFSETS, 8);
+            pawn_attacks[chessCore::white][square] =
+                    leaper_attacks(square, WHITE_PAWN_OFFSETS, 2);
+            pawn_attacks[chessCore::black][square] =
+                    leaper_attacks(square, BLACK_PAWN_OFFSETS, 2);
+            castling_masks[square] = 0xf;
+        }
+        typedef attacks::MagicAttacks Attacks;
+        for (int a = 0; a < 64; a++) {
+            for (int b = 0; b < 64; b++) {
+                bitboard ends = square_bit(a) | square_bit(b);
+                between[a][b] = 0;
+                line[a][b] = 0;
+                if (a == b) continue;
+                if (Attacks::rook(a, 0) & square_bit(b)) {
+                    between[a][b] = Attacks::rook(a, square_bit(b)) &
+                                    Attacks::rook(b, square_bit(a));
+                    line[a][b] = (Attacks::rook(a, 0) & Attacks::rook(b, 0)) |
+                                 ends;
+                } else if (Attacks::bishop(a, 0) & square_bit(b)) {
+                    between[a][b] = Attacks::bishop(a, square_bit(b)) &
+                                    Attacks::bishop(b, square_bit(a));
+                    line[a][b] = (Attacks::bishop(a, 0) &
+                                  Attacks::bishop(b, 0)) | ends;
+                }
+            }
+        }
+        castling_masks[0] &= ~Position::white_queen_side;
+        castling_masks[4] &= ~(Position::white_king_side |
+                               Position::white_queen_side);
+        castling_masks[7] &= ~Position::white_king_side;
+        castling_masks[56] &= ~Position::black_queen_side;
+        castling_masks[60] &= ~(Position::black_king_side |
+                                Position::black_queen_side);
+        castling_masks[63] &= ~Position::black_king_side;
+
+        // a fixed seed, so that keys are the same in every run
+        uint64_t seed = 0x9e3779b97f4a7c15ULL;
+        auto next_key = [&seed]() {
+            // splitmix64
+            uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            return z ^ (z >> 31);
+        };
+        for (auto& keys : piece_keys) {
+            for (uint64_t& key : keys) key = next_key();
+        }
+        castling_keys[0] = 0;
+        for (int i = 1; i < 16; i++) castling_keys[i] = next_key();
+        for (uint64_t& key : en_passant_keys) key = next_key();
+        side_key = next_key();
+    }
+}   // namespace
+
+const int8_t Position::NONE;
+
+Position::Position() {
+    std::call_once(init_flag, init_tables);
+    setFen("startpos");
+}
+
+void Position::clear() {
+    std::fill(by_piece, by_piece + 12, 0);
+    by_colour[0] = 0;
+    by_colour[1] = 0;
+    occupied = 0;
+    side = chessCore::white;
+    std::fill(squares, squares + 64, NONE);
+    state = stack;
+    state->key = 0;
+    state->castling = 0;
+    state->en_passant = -1;
+    state->rule50 = 0;
+    state->captured = NONE;
+}
+
+bool Position::setFen(const std::string& fen) {
+    std::istringstream ss(fen == "startpos" ? START_FEN : fen);
+    std::string placement, colour, castling, en_passant;
+    int rule50 = 0;
+    ss >> placement >> colour >> castling >> en_passant;
+    if (!(ss >> rule50)) rule50 = 0;
+
+    clear();
+    bool valid = true;
+    int rank = 7;
+    int file = 0;
+    for (char c : placement) {
+        if (c == '/') {
+            if (file != 8 || rank == 0) {
+                valid = false;
+                break;
+            }
+            rank--;
+            file = 0;
+        } else if (c >= '1' && c <= '8') {
+            file += c - '0';
+        } else {
+            const char* found = std::strchr(PIECE_CHARS, c);
+            if (!found || file > 7) {
+                valid = false;
+                break;
+            }
+            put(found - PIECE_CHARS, rank * 8 + file++);
+        }
+        if (!valid || file > 8) break;
+    }
+    valid = valid && rank == 0 && file == 8 &&
+            (colour == "w" || colour == "b") &&
+            by_piece[piece_of(chessCore::white, KING)] &&
+            by_piece[piece_of(chessCore::black, KING)];
+    if (castling != "-") {
+        for (char c : castling) {
+            const char* found = std::strchr(CASTLING_CHARS, c);
+            if (!found) valid = false;
+            else state->castling |= 1 << (found - CASTLING_CHARS);
+        }
+    }
+    if (en_passant != "-" && !en_passant.empty()) {
+        if (en_passant.size() != 2 || en_passant[0] < 'a' ||
+            en_passant[0] > 'h' || (en_passant[1] != '3' &&
+                                    en_passant[1] != '6')) {
+            valid = false;
+        } else {
+            state->en_passant = static_cast<int8_t>(
+                    (en_passant[1] - '1') * 8 + en_passant[0] - 'a');
+        }
+    }
+    if (!valid || rule50 < 0 || rule50 > 255) {
+        clear();
+        return false;
+    }
+
+    side = colour == "w" ? chessCore::white : chessCore::black;
+    state->rule50 = static_cast<uint8_t>(rule50);
+    state->key = castling_keys[state->castling];
+    for (int square = 0; square < 64; square++) {
+        if (squares[square] != NONE) {
+            state->key ^= piece_keys[squares[square]][square];
+        }
+    }
+    if (state->en_passant >= 0) {
+        state->key ^= en_passant_keys[state->en_passant % 8];
+    }
+    if (side == chessCore::black) state->key ^= side_key;
+    return true;
+}
+
+void Position::doMove(chessCore::move_t move) {
+    State* next = state + 1;
+    *next = *state;
+    next->captured = NONE;
+    next->rule50++;
+    if (state->en_passant >= 0) {
+        next->key ^= en_passant_keys[state->en_passant % 8];
+        next->en_passant = -1;
+    }
+
+    int from = move.from_sq();
+    int to = move.to_sq();
+    int piece = squares[from];
+
+    if (move.is_capture()) {
+        // en passant is the only capture with special bits 01
+        bool en_passant = !move.is_promotion() && !move.special1() &&
+                          move.special0();
+        int captured = en_passant ? to ^ 8 : to;
+        next->captured = squares[captured];
+        next->key ^= piece_keys[squares[captured]][captured];
+        next->rule50 = 0;
+        remove(captured);
+    } else if (!move.is_promotion() && move.special1()) {
+        // castling: special bit 0 tells the queen side from the king side
+        int rook_from = move.special0() ? to - 2 : to + 1;
+        int rook_to = move.special0() ? to + 1 : to - 1;
+        int rook = squares[rook_from];
+        next->key ^= piece_keys[rook][rook_from] ^ piece_keys[rook][rook_to];
+        remove(rook_from);
+        put(rook, rook_to);
+    }
+
+    int placed = piece;
+    if (move.is_promotion()) {
+        placed = piece / 6 * 6 + KNIGHT + move.special1() * 2 +
+                 move.special0();
+    }
+    next->key ^= piece_keys[piece][from] ^ piece_keys[placed][to];
+    remove(from);
+    put(placed, to);
+
+    if (piece % 6 == PAWN) {
+        next->rule50 = 0;
+        if ((from ^ to) == 16) {
+            next->en_passant = static_cast<int8_t>((from + to) / 2);
+            next->key ^= en_passant_keys[from % 8];
+        }
+    }
+    uint8_t castling = state->castling & castling_masks[from] &
+                       castling_masks[to];
+    next->key ^= castling_keys[state->castling] ^ castling_keys[castling];
+    next->castling = castling;
+
+    next->key ^= side_key;
+    side = side == chessCore::white ? chessCore::black : chessCore::white;
+    state = next;
+}
+
+void Position::undoMove(chessCore::move_t move) {
+    side = side == chessCore::white ? chessCore::black : chessCore::white;
+    int from = move.from_sq();
+    int to = move.to_sq();
+
+    int placed = squares[to];
+    remove(to);
+    put(move.is_promotion() ? piece_of(side, PAWN) : placed, from);
+
+    if (move.is_capture()) {
+        bool en_passant = !move.is_promotion() && !move.special1() &&
+                          move.special0();
+        put(state->captured, en_passant ? to ^ 8 : to);
+    } else if (!move.is_promotion() && move.special1()) {
+        int rook_from = move.special0() ? to - 2 : to + 1;
+        int rook_to = move.special0() ? to + 1 : to - 1;
+        int rook = squares[rook_to];
+        remove(rook_to);
+        put(rook, rook_from);
+    }
+    state--;
+}
+
+template <typename Attacks>
+bitboard Position::attackers(int square, chessCore::colour by,
+                             bitboard occupancy) const {
+    const bitboard* p = by_piece + by * 6;
+    bitboard queens = p[QUEEN];
+    return (pawn_attacks[!by][square] & p[PAWN]) |
+           (knight_attacks[square] & p[KNIGHT]) |
+           (king_attacks[square] & p[KING]) |
+           (Attacks::bishop(square, occupancy) & (p[BISHOP] | queens)) |
+           (Attacks::rook(square, occupancy) & (p[ROOK] | queens));
+}
+
+template <typename Attacks>
+bool Position::attacked(int square, chessCore::colour by) const {
+    return attackers<Attacks>(square, by, occupied) != 0;
+}
+
+template <typename Attacks, bool LEGAL>
+int Position::generate(chessCore::move_t* moves) const {
+    int num_moves = 0;
+    int us = side;
+    chessCore::colour them = chessCore::colour(!us);
+    bitboard enemies = by_colour[them];
+    bitboard targets = ~by_colour[us];
+    int king = lsb(by_piece[piece_of(us, KING)]);
+
+    // the squares other pieces may move to, and the pieces pinned to the
+    // king, each of which may only move along the line through it
+    bitboard checkers = 0;
+    bitboard pinned = 0;
+    if (LEGAL) {
+        checkers = attackers<Attacks>(king, them, occupied);
+        const bitboard* p = by_piece + them * 6;
+        bitboard snipers =
+                (Attacks::bishop(king, 0) & (p[BISHOP] | p[QUEEN])) |
+                (Attacks::rook(king, 0) & (p[ROOK] | p[QUEEN]));
+        while (snipers) {
+            bitboard blockers = between[king][pop_lsb(&snipers)] & occupied;
+            if (blockers && !(blockers & (blockers - 1))) {
+                pinned |= blockers & by_colour[us];
+            }
+        }
+
+        // the king steps off its square, so it can't hide behind itself
+        bitboard without_king = occupied & ~square_bit(king);
+        for (bitboard b = king_attacks[king] & targets; b;) {
+            int to = pop_lsb(&b);
+            if (attackers<Attacks>(to, them, without_king)) continue;
+            moves[num_moves++] = make_move(king, to, false,
+                                           enemies & square_bit(to), false,
+                                           false);
+        }
+        // in double check only the king can move
+        if (checkers & (checkers - 1)) return num_moves;
+        if (checkers) targets &= checkers | between[king][lsb(checkers)];
+    }
+
+    // pawns, moving up the board for white and down for black
+    int up = us == chessCore::white ? 8 : -8;
+    bitboard promotion_rank = us == chessCore::white ? RANK_1 << 56 : RANK_1;
+    bitboard double_rank = us == chessCore::white ? RANK_1 << 16
+                                                  : RANK_1 << 40;
+    for (bitboard b = by_piece[piece_of(us, PAWN)]; b;) {
+        int from = pop_lsb(&b);
+        int to = from + up;
+        bitboard allowed = targets;
+        if (LEGAL && (pinned & square_bit(from))) {
+            allowed &= line[king][from];
+        }
+        bitboard captures = pawn_attacks[us][from] & enemies & allowed;
+        bool push = !(occupied & square_bit(to));
+        if (square_bit(to) & promotion_rank) {
+            if (push && (allowed & square_bit(to))) {
+                for (int p = 3; p >= 0; p--) {
+                    moves[num_moves++] = make_move(from, to, true, false,
+                                                   p >> 1, p & 1);
+                }
+            }
+            while (captures) {
+                int target = pop_lsb(&captures);
+                for (int p = 3; p >= 0; p--) {
+                    moves[num_moves++] = make_move(from, target, true, true,
+                                                   p >> 1, p & 1);
+                }
+            }
+            continue;
+        }
+        if (push) {
+            if (allowed & square_bit(to)) {
+                moves[num_moves++] = make_move(from, to, false, false, false,
+                                               false);
+            }
+            if ((square_bit(to) & double_rank) &&
+                (allowed & ~occupied & square_bit(to + up))) {
+                moves[num_moves++] = make_move(from, to + up, false, false,
+                                               false, true);
+            }
+        }
+        while (captures) {
+            moves[num_moves++] = make_move(from, pop_lsb(&captures), false,
+                                           true, false, false);
+        }
+
+        int ep = state->en_passant;
+        if (ep >= 0 && (pawn_attacks[us][from] & square_bit(ep))) {
+            if (LEGAL) {
+                // the captured pawn may be the checker, and taking it can
+                // uncover the king along the rank, which no pin mask sees
+                int captured = ep ^ 8;
+                if (!((targets & square_bit(ep)) ||
+                      (checkers & square_bit(captured)))) {
+                    continue;
+                }
+                bitboard after = (occupied ^ square_bit(from) ^
+                                  square_bit(captured)) | square_bit(ep);
+                const bitboard* p = by_piece + them * 6;
+                if ((Attacks::bishop(king, after) &
+                     (p[BISHOP] | p[QUEEN])) ||
+                    (Attacks::rook(king, after) & (p[ROOK] | p[QUEEN]))) {
+                    continue;
+                }
+            }
+            moves[num_moves++] = make_move(from, ep, false, true, false,
+                                           true);
+        }
+    }
+
+    // the other pieces, the king too unless it was done above
+    for (int type = KNIGHT; type <= (LEGAL ? QUEEN : KING); type++) {
+        bitboard movers = by_piece[piece_of(us, type)];
+        for (bitboard b = movers; b;) {
+            int from = pop_lsb(&b);
+            bitboard attacks;
+            switch (type) {
+                case KNIGHT: attacks = knight_attacks[from]; break;
+                case BISHOP: attacks = Attacks::bishop(from, occupied); break;
+                case ROOK: attacks = Attacks::rook(from, occupied); break;
+                case QUEEN:
+                    attacks = Attacks::bishop(from, occupied) |
+                              Attacks::rook(from, occupied);
+                    break;
+                default: attacks = king_attacks[from]; break;
+            }
+            attacks &= type == KING ? ~by_colour[us] : targets;
+            if (LEGAL && (pinned & square_bit(from))) {
+                attacks &= line[king][from];
+            }
+            while (attacks) {
+                int to = pop_lsb(&attacks);
+                moves[num_moves++] = make_move(from, to, false,
+                                               enemies & square_bit(to),
+                                               false, false);
+            }
+        }
+    }
+
+    // castling, through and out of squares that aren't attacked
+    int home = us == chessCore::white ? 4 : 60;
+    uint8_t rights = state->castling >> (us * 2);
+    if ((rights & 3) && king == home &&
+        (LEGAL ? !checkers : !attacked<Attacks>(home, them))) {
+        if ((rights & 1) && !(occupied & (3ULL << (home + 1))) &&
+            !attacked<Attacks>(home + 1, them) &&
+            !attacked<Attacks>(home + 2, them)) {
+            moves[num_moves++] = make_move(home, home + 2, false, false,
+                                           true, false);
+        }
+        if ((rights & 2) && !(occupied & (7ULL << (home - 3))) &&
+            !attacked<Attacks>(home - 1, them) &&
+            !attacked<Attacks>(home - 2, them)) {
+            moves[num_moves++] = make_move(home, home - 2, false, false,
+                                           true, true);
+        }
+    }
+    return num_moves;
+}
+
+template <typename Attacks>
+int Position::generateMovesByPlaying(chessCore::move_t* moves) {
+    chessCore::move_t pseudo[MAX_MOVES];
+    int num_pseudo = generate<Attacks, false>(pseudo);
+    int num_moves = 0;
+    int us = side;
+    for (int i = 0; i < num_pseudo; i++) {
+        doMove(pseudo[i]);
+        int king = lsb(by_piece[piece_of(us, KING)]);
+        if (!attacked<Attacks>(king, side)) moves[num_moves++] = pseudo[i];
+        undoMove(pseudo[i]);
+    }
+    return num_moves;
+}
+
+template bool Position::attacked<attacks::MagicAttacks>(
+        int, chessCore::colour) const;
+template bool Position::attacked<attacks::PextAttacks>(
+        int, chessCore::colour) const;
+template int Position::generate<attacks::MagicAttacks, true>(
+        chessCore::move_t*) const;
+template int Position::generate<attacks::PextAttacks, true>(
+        chessCore::move_t*) const;
+template int Position::generateMovesByPlaying<attacks::MagicAttacks>(
+        chessCore::move_t*);
+template int Position::generateMovesByPlaying<attacks::PextAttacks>(
+        chessCore::move_t*);
+
+namespace {
+    /** Generate the legal moves one way or the other. */
+    template <typename Attacks, bool BY_PLAYING>
+    int legal_moves(Position& pos, chessCore::move_t* moves) {
+        return BY_PLAYING ? pos.generateMovesByPlaying<Attacks>(moves)
+                          : pos.generateMoves<Attacks>(moves);
+    }
+
+    /**
+     *  Count the leaves of the tree below a position, without recursion so
+     *  that the whole loop can be compiled for one backend.
+     */
+    template <typename Attacks, bool BY_PLAYING>
+    uint64_t perft_loop(Position& pos, int depth) {
+        depth = std::min(depth, MAX_PLY);
+        if (depth <= 0) return 1;
+
+        std::vector<chessCore::move_t> moves(depth * MAX_MOVES);
+        int num_moves[MAX_PLY];
+        int next[MAX_PLY];
+        num_moves[0] = legal_moves<Attacks, BY_PLAYING>(pos, moves.data());
+        next[0] = 0;
+        if (depth == 1) return num_moves[0];
+
+        uint64_t leaves = 0;
+        int ply = 0;
+        while (ply >= 0) {
+            chessCore::move_t* list = moves.data() + ply * MAX_MOVES;
+            if (next[ply] == num_moves[ply]) {
+                if (--ply >= 0) {
+                    pos.undoMove(moves[ply * MAX_MOVES + next[ply] - 1]);
+                }
+                continue;
+            }
+            chessCore::move_t move = list[next[ply]++];
+            pos.doMove(move);
+            if (ply + 2 == depth) {
+                // the last ply is counted, not played
+                leaves += legal_moves<Attacks, BY_PLAYING>(pos,
+                                                           list + MAX_MOVES);
+                pos.undoMove(move);
+            } else {
+                ply++;
+                num_moves[ply] = legal_moves<Attacks, BY_PLAYING>(
+                        pos, list + MAX_MOVES);
+                next[ply] = 0;
+            }
+        }
+        return leaves;
+    }
+
+    /** The PEXT loop, compiled for BMI2 so that PEXT is inlined. */
+#ifdef ATTACKS_X86
+    __attribute__((target("bmi2"), flatten))
+#endif
+    uint64_t perft_pext(Position& pos, int depth, bool by_playing) {
+        return by_playing ?
+               perft_loop<attacks::PextAttacks, true>(pos, depth) :
+               perft_loop<attacks::PextAttacks, false>(pos, depth);
+    }
+}   // namespace
+
+uint64_t perft(Position& pos, int depth, attacks::Backend backend,
+               bool by_playing) {
+    if (backend == attacks::backend_pext) {
+        return perft_pext(pos, depth, by_playing);
+    }
+    return by_playing ? perft_loop<attacks::MagicAttacks, true>(pos, depth) :
+                        perft_loop<attacks::MagicAttacks, false>(pos, depth);
+}
+
+}   // namespace chessUCI
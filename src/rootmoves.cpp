@@ -0,0 +1,74 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "rootmoves.h"
+
+#include <algorithm>
+
+#include "constants.h"
+#include "movepick.h"
+
+namespace chessUCI {
+
+void RootMoves::init(chessCore::Board& board, const nnue::Pieces& pieces,
+                     chessCore::move_t tt_move,
+                     const std::vector<chessCore::move_t>& allowed) {
+    static const MoveHistory no_history;
+    MovePicker picker(board, pieces, no_history, tt_move, chessCore::move_t(),
+                      0, false);
+    moves.clear();
+    for (chessCore::move_t move = picker.next(); move != chessCore::move_t();
+         move = picker.next()) {
+        RootMove root_move;
+        root_move.move = move;
+        root_move.nodes = 0;
+        root_move.last_nodes = 0;
+        root_move.score = -MATE_VALUE;
+        moves.push_back(root_move);
+    }
+
+    auto is_allowed = [&allowed](const RootMove& m) {
+        return std::find(allowed.begin(), allowed.end(), m.move) !=
+               allowed.end();
+    };
+    // a restriction without a legal move would leave nothing to play
+    if (std::any_of(moves.begin(), moves.end(), is_allowed)) {
+        moves.erase(std::stable_partition(moves.begin(), moves.end(),
+                                          is_allowed),
+                    moves.end());
+    }
+}
+
+bool RootMoves::contains(chessCore::move_t move) const {
+    return std::any_of(moves.begin(), moves.end(),
+                       [move](const RootMove& m) { return m.move == move; });
+}
+
+void RootMoves::iterationDone(chessCore::move_t best) {
+    for (RootMove& m : moves) {
+        m.last_nodes = m.nodes;
+        m.nodes = 0;
+    }
+    std::stable_sort(moves.begin(), moves.end(),
+                     [best](const RootMove& a, const RootMove& b) {
+                         if ((a.move == best) != (b.move == best)) {
+                             return a.move == best;
+                         }
+                         if (a.last_nodes != b.last_nodes) {
+                             return a.last_nodes > b.last_nodes;
+                         }
+                         return a.score > b.score;
+                     });
+}
+
+double RootMoves::bestShare() const {
+    uint64_t total = 0;
+    for (const RootMove& m : moves) total += m.last_nodes;
+    return total ? static_cast<double>(moves[0].last_nodes) / total : 0;
+}
+
+}   // namespace chessUCI
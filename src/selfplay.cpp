@@ -0,0 +1,425 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "selfplay.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "board.h"
+#include "history.h"
+#include "interface.h"
+#include "lan.h"
+
+namespace chessUCI {
+
+namespace selfplay {
+
+namespace {
+    /** A small opening suite, used when no file is given. */
+    const char* const DEFAULT_OPENINGS[] = {
+        "e2e4 e7e5 g1f3 b8c6 f1b5",
+        "e2e4 c7c5 g1f3 d7d6 d2d4 c5d4 f3d4",
+        "e2e4 e7e6 d2d4 d7d5",
+        "e2e4 c7c6 d2d4 d7d5",
+        "d2d4 d7d5 c2c4 e7e6 b1c3 g8f6",
+        "d2d4 g8f6 c2c4 g7g6 b1c3 f8g7",
+        "d2d4 g8f6 c2c4 e7e6 b1c3 f8b4",
+        "c2c4 e7e5 b1c3 g8f6",
+        "g1f3 d7d5 g2g3 g8f6 f1g2",
+        "e2e4 d7d5 e4d5 d8d5 b1c3"
+    };
+
+    /** How a game ended, from white's point of view. */
+    enum Outcome {
+        white_wins,
+        draw,
+        black_wins
+    };
+
+    /** Split a line into tokens. */
+    std::vector<std::string> split(const std::string& line) {
+        std::istringstream ss(line);
+        std::vector<std::string> tokens;
+        std::string token;
+        while (ss >> token) tokens.push_back(token);
+        return tokens;
+    }
+
+    /** The expected score of a player this many Elo points stronger. */
+    double expected_score(double elo) {
+        return 1 / (1 + std::pow(10, -elo / 400));
+    }
+
+    /** The Elo difference giving an expected score. */
+    double score_to_elo(double score) {
+        score = std::min(std::max(score, 1e-3), 1 - 1e-3);
+        return 400 * std::log10(score / (1 - score));
+    }
+
+    /**
+     *  One side of a match: an interface with its own in-memory streams,
+     *  driven by the match thread as a GUI would drive it over pipes.
+     */
+    class Player {
+     private:
+        std::stringstream in;
+        std::stringstream out;
+        std::stringstream err;
+        chessInterface interface;
+
+     public:
+        explicit Player(
+                const std::vector<std::pair<std::string, std::string>>&
+                options) : interface(in, out, err) {
+            for (const auto& option : options) {
+                interface.parseMessage("setoption name " + option.first +
+                                       " value " + option.second);
+            }
+            interface.parseMessage("isready");
+            out.str("");
+        }
+
+        /** Anything the interface complained about. */
+        std::string errors() const {
+            return err.str();
+        }
+
+        void newGame() {
+            interface.parseMessage("ucinewgame");
+        }
+
+        /** Search a position and read the best move and statistics. */
+        std::string bestMove(const std::string& position,
+                             const std::string& go_command, uint64_t* nodes,
+                             uint64_t* time) {
+            interface.parseMessage(position);
+            interface.parseMessage(go_command);
+            interface.getEngine().wait();
+
+            std::string best;
+            uint64_t last_nodes = 0;
+            uint64_t last_time = 0;
+            std::string line;
+            while (std::getline(out, line)) {
+                std::vector<std::string> tokens = split(line);
+                if (tokens.empty()) continue;
+                if (tokens[0] == "bestmove" && tokens.size() > 1) {
+                    best = tokens[1];
+                } else if (tokens[0] == "info") {
+                    for (size_t i = 1; i + 1 < tokens.size(); i++) {
+                        if (tokens[i] == "nodes") {
+                            last_nodes = std::stoull(tokens[i + 1]);
+                        } else if (tokens[i] == "time") {
+                            last_time = std::stoull(tokens[i + 1]);
+                        }
+                    }
+                }
+            }
+            out.clear();
+            out.str("");
+
+            *nodes += last_nodes;
+            *time += last_time;
+            return best;
+        }
+    };
+
+    /**
+     *  Play one game. players[0] has white. Statistics are added to the
+     *  entries of nodes and time of each player.
+     */
+    Outcome playGame(const std::vector<std::string>& opening,
+                     Player* players[2], const MatchSettings& settings,
+                     uint64_t nodes[2], uint64_t time[2],
+                     std::string* reason) {
+        chessCore::Board board;
+        KeyHistory history;
+        history.push(board.getHashValue(), board.getHalfMoveClock());
+        std::string position = "position startpos moves";
+
+        for (const std::string& move_str : opening) {
+            chessCore::move_t move;
+            if (!parse_lan(board, move_str, &move)) break;
+            board.doMoveInPlace(move);
+            history.push(board.getHashValue(), board.getHalfMoveClock());
+            position += " " + move_str;
+        }
+
+        players[0]->newGame();
+        players[1]->newGame();
+        for (int ply = 0; ply < settings.max_plies; ply++) {
+            bool white_to_move = board.getSide() == chessCore::white;
+            Outcome loss = white_to_move ? black_wins : white_wins;
+
+            chessCore::move_t moves[MAX_MOVES];
+            if (board.getAllLegalMoves(moves) == 0) {
+                bool mate = board.isCheck(board.getSide());
+                *reason = mate ? "checkmate" : "stalemate";
+                return mate ? loss : draw;
+            }
+            // the third occurrence of a position, not the second
+            if (history.repetitions() >= 2) {
+                *reason = "repetition";
+                return draw;
+            }
+            if (history.isFiftyMoveDraw()) {
+                *reason = "fifty moves";
+                return draw;
+            }
+
+            int side = white_to_move ? 0 : 1;
+            std::string best = players[side]->bestMove(
+                                   position, settings.go_command,
+                                   &nodes[side], &time[side]);
+            chessCore::move_t move;
+            if (!parse_lan(board, best, &move)) {
+                *reason = "illegal move " + best;
+                return loss;
+            }
+            board.doMoveInPlace(move);
+            history.push(board.getHashValue(), board.getHalfMoveClock());
+            position += " " + best;
+        }
+        *reason = "too long";
+        return draw;
+    }
+
+    /** Read a number argument. */
+    bool parse_number(const std::string& arg, double* number) {
+        std::istringstream ss(arg);
+        return (ss >> *number) && ss.eof();
+    }
+}   // namespace
+
+MatchSettings::MatchSettings() {
+    games = 100;
+    concurrency = std::max<int>(1, std::thread::hardware_concurrency());
+    go_command = "go nodes 20000";
+    max_plies = 400;
+    for (const char* opening : DEFAULT_OPENINGS) {
+        openings.push_back(split(opening));
+    }
+    elo0 = 0;
+    elo1 = 5;
+    alpha = 0.05;
+    beta = 0.05;
+}
+
+MatchResult::MatchResult() {
+    wins = 0;
+    draws = 0;
+    losses = 0;
+    nodes[0] = nodes[1] = 0;
+    time[0] = time[1] = 0;
+}
+
+int MatchResult::games() const {
+    return wins + draws + losses;
+}
+
+double MatchResult::score() const {
+    return games() ? (wins + draws / 2.0) / games() : 0.5;
+}
+
+double MatchResult::elo(double* margin) const {
+    int n = games();
+    double s = score();
+    double variance = n ? (wins * (1 - s) * (1 - s) +
+                           draws * (0.5 - s) * (0.5 - s) +
+                           losses * s * s) / n : 0;
+    double error = n ? 1.96 * std::sqrt(variance / n) : 0;
+    *margin = (score_to_elo(s + error) - score_to_elo(s - error)) / 2;
+    return score_to_elo(s);
+}
+
+double MatchResult::llr(double elo0, double elo1) const {
+    // the normal approximation of the trinomial GSPRT
+    int n = games();
+    if (!n) return 0;
+    double s = score();
+    double variance = (wins * (1 - s) * (1 - s) +
+                       draws * (0.5 - s) * (0.5 - s) +
+                       losses * s * s) / n;
+    // e.g. only draws so far: no spread to measure the score against
+    if (variance == 0) return 0;
+    double s0 = expected_score(elo0);
+    double s1 = expected_score(elo1);
+    return n * (s1 - s0) * (2 * s - s0 - s1) / (2 * variance);
+}
+
+MatchResult playMatch(const MatchSettings& settings, std::ostream& log) {
+    MatchResult result;
+    std::mutex mutex;
+    std::atomic<int> next_game{0};
+    std::atomic<bool> finished{false};
+    double lower = std::log(settings.beta / (1 - settings.alpha));
+    double upper = std::log((1 - settings.beta) / settings.alpha);
+
+    auto work = [&]() {
+        Player a(settings.options[0]);
+        Player b(settings.options[1]);
+        uint64_t nodes[2] = {0, 0};
+        uint64_t time[2] = {0, 0};
+
+        while (!finished) {
+            int game = next_game++;
+            if (game >= settings.games) break;
+
+            // each opening is played twice, A having white in the first game
+            const std::vector<std::string>& opening =
+                    settings.openings[game / 2 % settings.openings.size()];
+            bool a_white = game % 2 == 0;
+            Player* players[2] = {a_white ? &a : &b, a_white ? &b : &a};
+            uint64_t game_nodes[2] = {0, 0};
+            uint64_t game_time[2] = {0, 0};
+            std::string reason;
+            Outcome outcome = playGame(opening, players, settings,
+                                       game_nodes, game_time, &reason);
+            for (int side = 0; side < 2; side++) {
+                int player = (side == 0) == a_white ? 0 : 1;
+                nodes[player] += game_nodes[side];
+                time[player] += game_time[side];
+            }
+
+            std::lock_guard<std::mutex> lock{mutex};
+            const char* score = outcome == white_wins ? "1-0" :
+                                outcome == black_wins ? "0-1" : "1/2-1/2";
+            if (outcome == draw) {
+                result.draws++;
+            } else if ((outcome == white_wins) == a_white) {
+                result.wins++;
+            } else {
+                result.losses++;
+            }
+            log << "game " << game + 1 << " " << (a_white ? "A-B " : "B-A ")
+                << score << " (" << reason << ")  +" << result.wins << " ="
+                << result.draws << " -" << result.losses << "\n";
+
+            double llr = result.llr(settings.elo0, settings.elo1);
+            if (llr <= lower || llr >= upper) finished = true;
+        }
+
+        std::lock_guard<std::mutex> lock{mutex};
+        for (int player = 0; player < 2; player++) {
+            result.nodes[player] += nodes[player];
+            result.time[player] += time[player];
+        }
+    };
+
+    std::vector<std::thread> threads;
+    int num_threads = std::min(std::max(settings.concurrency, 1),
+                               std::max(settings.games, 1));
+    for (int i = 0; i < num_threads; i++) threads.emplace_back(work);
+    for (std::thread& thread : threads) thread.join();
+    return result;
+}
+
+int run(const std::vector<std::string>& args, std::ostream& out,
+        std::ostream& err) {
+    MatchSettings settings;
+    std::string limit;
+    for (size_t i = 0; i < args.size(); i += 2) {
+        const std::string& name = args[i];
+        if (i + 1 >= args.size()) {
+            err << "Missing value for " << name << "\n";
+            return 1;
+        }
+        const std::string& value = args[i + 1];
+
+        if (name.compare(0, 2, "a.") == 0 || name.compare(0, 2, "b.") == 0) {
+            settings.options[name[0] == 'a' ? 0 : 1].emplace_back(
+                    name.substr(2), value);
+            continue;
+        }
+        if (name == "openings") {
+            std::ifstream file(value);
+            if (!file) {
+                err << "Cannot open " << value << "\n";
+                return 1;
+            }
+            settings.openings.clear();
+            std::string line;
+            while (std::getline(file, line)) {
+                std::vector<std::string> moves = split(line);
+                if (moves.empty() || moves[0][0] == '#') continue;
+                settings.openings.push_back(moves);
+            }
+            if (settings.openings.empty()) settings.openings.emplace_back();
+            continue;
+        }
+
+        double number;
+        if (!parse_number(value, &number)) {
+            err << "Invalid value for " << name << ": " << value << "\n";
+            return 1;
+        }
+        if (name == "games") {
+            settings.games = number;
+        } else if (name == "concurrency") {
+            settings.concurrency = number;
+        } else if (name == "nodes" || name == "movetime" || name == "depth") {
+            limit += " " + name + " " + value;
+        } else if (name == "maxplies") {
+            settings.max_plies = number;
+        } else if (name == "elo0") {
+            settings.elo0 = number;
+        } else if (name == "elo1") {
+            settings.elo1 = number;
+        } else {
+            err << "Unknown argument: " << name << "\n";
+            return 1;
+        }
+    }
+    if (!limit.empty()) settings.go_command = "go" + limit;
+
+    // check the options once before spawning all the players
+    for (int player = 0; player < 2; player++) {
+        Player check(settings.options[player]);
+        if (!check.errors().empty()) {
+            err << check.errors();
+            return 1;
+        }
+    }
+
+    MatchResult result = playMatch(settings, out);
+
+    double margin;
+    double elo = result.elo(&margin);
+    double llr = result.llr(settings.elo0, settings.elo1);
+    double lower = std::log(settings.beta / (1 - settings.alpha));
+    double upper = std::log((1 - settings.beta) / settings.alpha);
+    const char* verdict = llr >= upper ? "H1 accepted" :
+                          llr <= lower ? "H0 accepted" : "inconclusive";
+
+    out << "\nA vs B: +" << result.wins << " =" << result.draws << " -"
+        << result.losses << " (" << result.games() << " games, "
+        << settings.go_command << ")\n"
+        << "  score: " << result.score() * 100 << "%\n"
+        << "  elo:   " << elo << " +/- " << margin << "\n"
+        << "  sprt:  llr " << llr << " (" << lower << ", " << upper
+        << ") for elo " << settings.elo0 << " vs " << settings.elo1 << ": "
+        << verdict << "\n";
+    for (int player = 0; player < 2; player++) {
+        uint64_t time = std::max<uint64_t>(result.time[player], 1);
+        out << "  nps " << (player ? "B" : "A") << ": "
+            << result.nodes[player] * 1000 / time << "\n";
+    }
+    return 0;
+}
+
+}   // namespace selfplay
+
+}   // namespace chessUCI
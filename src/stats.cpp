@@ -0,0 +1,176 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "stats.h"
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+namespace chessUCI {
+
+namespace {
+    /** The columns of CSV files, in the order rows are written. */
+    const char CSV_HEADER[] = "search,depth,seldepth,score,time,"
+                              "iteration_time,nodes,iteration_nodes,"
+                              "branching_factor,qnode_share,tt_hit_rate,"
+                              "tt_cutoff_rate,first_move_cutoff_rate,"
+                              "eval_hit_rate,lmr_research_rate,"
+                              "aspiration_fails\n";
+
+    double ratio(uint64_t part, uint64_t whole) {
+        return whole ? static_cast<double>(part) / whole : 0;
+    }
+
+    bool ends_with(const std::string& s, const std::string& suffix) {
+        return s.size() >= suffix.size() &&
+               s.compare(s.size() - suffix.size(), suffix.size(),
+                         suffix) == 0;
+    }
+}   // namespace
+
+SearchStats::SearchStats() {
+    qnodes = 0;
+    tt_probes = 0;
+    tt_hits = 0;
+    tt_cutoffs = 0;
+    beta_cutoffs = 0;
+    first_move_cutoffs = 0;
+    eval_probes = 0;
+    eval_hits = 0;
+    rfp_cutoffs = 0;
+    futility_prunes = 0;
+    lmr_reductions = 0;
+    lmr_researches = 0;
+    aspiration_fails = 0;
+}
+
+IterationStats::IterationStats() {
+    depth = 0;
+    seldepth = 0;
+    score = 0;
+    time = 0;
+    iteration_time = 0;
+    nodes = 0;
+    iteration_nodes = 0;
+    branching_factor = 0;
+    qnode_share = 0;
+    tt_hit_rate = 0;
+    tt_cutoff_rate = 0;
+    first_move_cutoff_rate = 0;
+    eval_hit_rate = 0;
+    lmr_research_rate = 0;
+    aspiration_fails = 0;
+}
+
+void IterationStats::compute(const SearchStats& before,
+                             const SearchStats& after,
+                             uint64_t nodes_before, uint64_t nodes_after,
+                             uint64_t last_nodes) {
+    nodes = nodes_after;
+    iteration_nodes = nodes_after - nodes_before;
+    branching_factor = ratio(iteration_nodes, last_nodes);
+    qnode_share = ratio(after.qnodes - before.qnodes, iteration_nodes);
+
+    uint64_t probes = after.tt_probes - before.tt_probes;
+    tt_hit_rate = ratio(after.tt_hits - before.tt_hits, probes);
+    tt_cutoff_rate = ratio(after.tt_cutoffs - before.tt_cutoffs, probes);
+    first_move_cutoff_rate = ratio(
+            after.first_move_cutoffs - before.first_move_cutoffs,
+            after.beta_cutoffs - before.beta_cutoffs);
+    eval_hit_rate = ratio(after.eval_hits - before.eval_hits,
+                          after.eval_probes - before.eval_probes);
+    lmr_research_rate = ratio(after.lmr_researches - before.lmr_researches,
+                              after.lmr_reductions - before.lmr_reductions);
+    aspiration_fails = after.aspiration_fails - before.aspiration_fails;
+}
+
+StatsWriter::StatsWriter() {
+    csv = false;
+    size = 0;
+}
+
+bool StatsWriter::open(const std::string& new_path) {
+    if (file.is_open()) file.close();
+    path = new_path;
+    if (path.empty()) return true;
+
+    csv = ends_with(path, ".csv");
+    reopen();
+    if (!file) {
+        path.clear();
+        return false;
+    }
+    return true;
+}
+
+void StatsWriter::reopen() {
+    file.open(path, std::ios::out | std::ios::app);
+    file.seekp(0, std::ios::end);
+    size = file.tellp();
+    if (csv && size == 0) {
+        file << CSV_HEADER;
+        size += sizeof(CSV_HEADER) - 1;
+    }
+}
+
+void StatsWriter::rotate() {
+    file.close();
+    for (int i = MAX_ROTATED_FILES - 1; i >= 1; i--) {
+        std::string from = path + "." + std::to_string(i);
+        std::string to = path + "." + std::to_string(i + 1);
+        std::rename(from.c_str(), to.c_str());
+    }
+    std::rename(path.c_str(), (path + ".1").c_str());
+    reopen();
+}
+
+const std::string& StatsWriter::getPath() const {
+    return path;
+}
+
+void StatsWriter::write(uint64_t search, const IterationStats& stats) {
+    if (path.empty()) return;
+
+    std::ostringstream row;
+    if (csv) {
+        row << search << "," << stats.depth << "," << stats.seldepth << ","
+            << stats.score << "," << stats.time << ","
+            << stats.iteration_time << "," << stats.nodes << ","
+            << stats.iteration_nodes << "," << stats.branching_factor << ","
+            << stats.qnode_share << "," << stats.tt_hit_rate << ","
+            << stats.tt_cutoff_rate << "," << stats.first_move_cutoff_rate
+            << "," << stats.eval_hit_rate << "," << stats.lmr_research_rate
+            << "," << stats.aspiration_fails << "\n";
+    } else {
+        row << "{\"search\":" << search << ",\"depth\":" << stats.depth
+            << ",\"seldepth\":" << stats.seldepth << ",\"score\":"
+            << stats.score << ",\"time\":" << stats.time
+            << ",\"iteration_time\":" << stats.iteration_time
+            << ",\"nodes\":" << stats.nodes << ",\"iteration_nodes\":"
+            << stats.iteration_nodes << ",\"branching_factor\":"
+            << stats.branching_factor << ",\"qnode_share\":"
+            << stats.qnode_share << ",\"tt_hit_rate\":" << stats.tt_hit_rate
+            << ",\"tt_cutoff_rate\":" << stats.tt_cutoff_rate
+            << ",\"first_move_cutoff_rate\":"
+            << stats.first_move_cutoff_rate << ",\"eval_hit_rate\":"
+            << stats.eval_hit_rate << ",\"lmr_research_rate\":"
+            << stats.lmr_research_rate << ",\"aspiration_fails\":"
+            << stats.aspiration_fails << "}\n";
+    }
+
+    std::string line = row.str();
+    if (size + line.size() > MAX_FILE_SIZE) rotate();
+    file << line;
+    size += line.size();
+}
+
+void StatsWriter::flush() {
+    if (file.is_open()) file.flush();
+}
+
+}   // namespace chessUCI
@@ -0,0 +1,160 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "strawberry.h"
+
+#include <string>
+#include <vector>
+
+#include "engine.h"
+
+struct strawberry_engine {
+    chessUCI::Engine engine;
+};
+
+namespace {
+    strawberry_move toCMove(chessCore::move_t move) {
+        strawberry_move c_move;
+        c_move.from = move.from_sq();
+        c_move.to = move.to_sq();
+        c_move.promotion = 0;
+        if (move.is_promotion()) {
+            c_move.promotion = "nbrq"[move.special1() * 2 + move.special0()];
+        }
+        return c_move;
+    }
+
+    bool fromCMove(chessCore::Board& board, strawberry_move c_move,
+                   chessCore::move_t* move) {
+        chessCore::move_t moves[chessUCI::MAX_MOVES];
+        int num_moves = board.getAllLegalMoves(moves);
+        for (int i = 0; i < num_moves; i++) {
+            if (toCMove(moves[i]).from == c_move.from &&
+                toCMove(moves[i]).to == c_move.to &&
+                toCMove(moves[i]).promotion == c_move.promotion) {
+                *move = moves[i];
+                return true;
+            }
+        }
+        return false;
+    }
+}   // namespace
+
+extern "C" {
+
+strawberry_engine* strawberry_new(void) {
+    return new strawberry_engine;
+}
+
+void strawberry_free(strawberry_engine* engine) {
+    delete engine;
+}
+
+void strawberry_new_game(strawberry_engine* engine) {
+    engine->engine.newGame();
+}
+
+void strawberry_set_hash(strawberry_engine* engine, size_t megabytes) {
+    engine->engine.setHashSize(megabytes);
+}
+
+void strawberry_set_threads(strawberry_engine* engine, int num_threads) {
+    engine->engine.setThreads(num_threads);
+}
+
+int strawberry_set_option(strawberry_engine* engine, const char* name,
+                          const char* value) {
+    if (!engine->engine.setOption(name, value)) return -1;
+    engine->engine.waitForOptions();
+    return 0;
+}
+
+int strawberry_set_position(strawberry_engine* engine, const char* fen,
+                            const strawberry_move* moves, size_t num_moves) {
+    chessCore::Board board = fen == std::string("startpos") ?
+                             chessCore::Board() : chessCore::Board(fen);
+    std::vector<chessCore::move_t> core_moves(num_moves);
+    for (size_t i = 0; i < num_moves; i++) {
+        if (!fromCMove(board, moves[i], &core_moves[i])) return -1;
+        board.doMoveInPlace(core_moves[i]);
+    }
+    engine->engine.setPosition(fen, core_moves.data(), num_moves);
+    return 0;
+}
+
+void strawberry_go(strawberry_engine* engine, const strawberry_limits* limits,
+                   strawberry_info_callback on_info,
+                   strawberry_bestmove_callback on_bestmove,
+                   void* user_data) {
+    chessUCI::SearchLimits searchLimits;
+    if (limits) {
+        searchLimits.ponder = limits->ponder;
+        searchLimits.infinite = limits->infinite;
+        searchLimits.wtime = limits->wtime;
+        searchLimits.btime = limits->btime;
+        searchLimits.winc = limits->winc;
+        searchLimits.binc = limits->binc;
+        searchLimits.movestogo = limits->movestogo;
+        searchLimits.depth = limits->depth;
+        searchLimits.movetime = limits->movetime;
+        searchLimits.nodes = limits->nodes;
+        searchLimits.mate = limits->mate;
+
+        chessCore::Board board = engine->engine.getBoard();
+        for (size_t i = 0; limits->searchmoves && i < limits->num_searchmoves;
+             i++) {
+            chessCore::move_t move;
+            if (fromCMove(board, limits->searchmoves[i], &move)) {
+                searchLimits.searchmoves.push_back(move);
+            }
+        }
+    }
+
+    engine->engine.go(
+        searchLimits,
+        [on_info, user_data](const chessUCI::SearchInfo& searchInfo) {
+            if (!on_info) return;
+            std::vector<strawberry_move> pv;
+            for (chessCore::move_t move : searchInfo.pv) {
+                pv.push_back(toCMove(move));
+            }
+            strawberry_info info;
+            info.depth = searchInfo.depth;
+            info.seldepth = searchInfo.seldepth;
+            info.time = searchInfo.time;
+            info.nodes = searchInfo.nodes;
+            info.nps = searchInfo.nps;
+            info.mate = searchInfo.isMate();
+            info.score = info.mate ? searchInfo.mateIn() : searchInfo.score;
+            info.pv = pv.data();
+            info.pv_length = pv.size();
+            info.hashfull = searchInfo.hashfull;
+            info.string = searchInfo.string.empty() ?
+                          nullptr : searchInfo.string.c_str();
+            on_info(&info, user_data);
+        },
+        [on_bestmove, user_data](chessCore::move_t best,
+                                 chessCore::move_t ponder) {
+            if (on_bestmove) {
+                on_bestmove(toCMove(best), toCMove(ponder), user_data);
+            }
+        });
+}
+
+void strawberry_stop(strawberry_engine* engine) {
+    engine->engine.stop();
+}
+
+void strawberry_ponderhit(strawberry_engine* engine) {
+    engine->engine.ponderhit();
+}
+
+void strawberry_wait(strawberry_engine* engine) {
+    engine->engine.wait();
+}
+
+}   // extern "C"
@@ -0,0 +1,222 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "trace.h"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace chessUCI {
+
+TraceRing::TraceRing(uint16_t id) : id(id) {
+    head = 0;
+    tail = 0;
+    dropped = 0;
+    in_use = false;
+}
+
+size_t TraceRing::pop(TraceEvent* out, size_t max) {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+    uint64_t available = head.load(std::memory_order_acquire) - t;
+    size_t count = available < max ? available : max;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = events[(t + i) & (CAPACITY - 1)];
+    }
+    tail.store(t + count, std::memory_order_release);
+    return count;
+}
+
+void TraceRing::discard() {
+    tail.store(head.load(std::memory_order_acquire),
+               std::memory_order_release);
+}
+
+namespace trace {
+
+std::atomic<bool> enabled{false};
+
+namespace {
+    /** How often the rings are drained. */
+    const std::chrono::milliseconds DRAIN_INTERVAL{10};
+
+    /** How each event type is written: its name, phase and arguments. */
+    struct EventFormat {
+        const char* name;
+        char phase;
+        const char* a_name;
+        const char* b_name;
+    };
+
+    const EventFormat FORMATS[trace_num_types] = {
+        {"command received", 'i', "line", "length"},
+        {"command", 'i', "kind", "us"},
+        {"iteration", 'B', "depth", nullptr},
+        {"iteration", 'E', "score", "nodes"},
+        {"tt burst", 'i', "hits", "misses"},
+        {"time check", 'i', "elapsed", "nodes"},
+        {"root fail high", 'i', "move", "score"},
+        {"root fail low", 'i', "score", "last"},
+        {"aspiration fail low", 'i', "score", "alpha"},
+        {"aspiration fail high", 'i', "score", "beta"},
+        {"deadline overrun", 'i', "late", "forced"}
+    };
+
+    /** Every ring ever created. Rings are reused but never freed. */
+    std::vector<std::unique_ptr<TraceRing>> rings;
+    /** A mutex guarding \ref rings. */
+    std::mutex rings_mutex;
+
+    /** A mutex serialising \ref start and \ref stop. */
+    std::mutex control_mutex;
+    /** The thread draining the rings into \ref file. */
+    std::thread drainer;
+    /** Set while \ref drainer should keep running. */
+    std::atomic<bool> draining{false};
+    /** The trace file. */
+    std::ofstream file;
+    /** The number of events written to \ref file. */
+    uint64_t written = 0;
+    /** When tracing started, in steady clock nanoseconds. */
+    std::atomic<int64_t> epoch{0};
+
+    int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+               .count();
+    }
+
+    /** Gives the calling thread a ring, and hands it back when it exits. */
+    struct RingHandle {
+        TraceRing* ring = nullptr;
+
+        ~RingHandle() {
+            if (ring) ring->in_use.store(false, std::memory_order_release);
+        }
+    };
+
+    thread_local RingHandle handle;
+
+    TraceRing* acquire_ring() {
+        std::lock_guard<std::mutex> lock{rings_mutex};
+        for (const auto& ring : rings) {
+            bool expected = false;
+            if (ring->in_use.compare_exchange_strong(
+                        expected, true, std::memory_order_acquire)) {
+                return ring.get();
+            }
+        }
+        rings.emplace_back(new TraceRing(rings.size()));
+        rings.back()->in_use = true;
+        return rings.back().get();
+    }
+
+    void write_event(const TraceEvent& event) {
+        const EventFormat& format = FORMATS[event.type];
+        file << (written++ ? ",\n" : "\n")
+             << "{\"name\":\"" << format.name << "\",\"ph\":\""
+             << format.phase << "\",\"ts\":" << event.time / 1000 << "."
+             << event.time / 100 % 10 << event.time / 10 % 10
+             << event.time % 10 << ",\"pid\":1,\"tid\":" << event.thread;
+        if (format.phase == 'i') file << ",\"s\":\"t\"";
+        file << ",\"args\":{\"" << format.a_name << "\":" << event.a;
+        if (format.b_name) {
+            file << ",\"" << format.b_name << "\":" << event.b;
+        }
+        file << "}}";
+    }
+
+    void drain_all() {
+        std::vector<TraceRing*> snapshot;
+        {
+            std::lock_guard<std::mutex> lock{rings_mutex};
+            for (const auto& ring : rings) snapshot.push_back(ring.get());
+        }
+
+        TraceEvent buf[256];
+        for (TraceRing* ring : snapshot) {
+            while (size_t count = ring->pop(buf, 256)) {
+                for (size_t i = 0; i < count; i++) write_event(buf[i]);
+            }
+        }
+        file.flush();
+    }
+
+    void drain_loop() {
+        while (draining) {
+            std::this_thread::sleep_for(DRAIN_INTERVAL);
+            drain_all();
+        }
+    }
+}   // namespace
+
+TraceStats::TraceStats() {
+    events = 0;
+    dropped = 0;
+}
+
+void record(TraceEventType type, int32_t a, int64_t b) {
+    if (!handle.ring) handle.ring = acquire_ring();
+
+    TraceEvent event;
+    event.time = now_ns() - epoch.load(std::memory_order_relaxed);
+    event.thread = handle.ring->id;
+    event.type = type;
+    event.a = a;
+    event.b = b;
+    handle.ring->push(event);
+}
+
+bool start(const std::string& path) {
+    std::lock_guard<std::mutex> lock{control_mutex};
+    if (on()) return true;
+
+    file.open(path, std::ios::out | std::ios::trunc);
+    if (!file) return false;
+    {
+        // forget events recorded while the last trace was stopping
+        std::lock_guard<std::mutex> rings_lock{rings_mutex};
+        for (const auto& ring : rings) {
+            ring->discard();
+            ring->dropped = 0;
+        }
+    }
+    written = 0;
+    epoch = now_ns();
+    file << "[";
+
+    draining = true;
+    drainer = std::thread(drain_loop);
+    enabled.store(true, std::memory_order_release);
+    return true;
+}
+
+TraceStats stop() {
+    std::lock_guard<std::mutex> lock{control_mutex};
+    TraceStats stats;
+    if (!on()) return stats;
+
+    enabled = false;
+    draining = false;
+    drainer.join();
+    drain_all();
+    file << "\n]\n";
+    file.close();
+
+    stats.events = written;
+    std::lock_guard<std::mutex> rings_lock{rings_mutex};
+    for (const auto& ring : rings) stats.dropped += ring->dropped.exchange(0);
+    return stats;
+}
+
+}   // namespace trace
+
+}   // namespace chessUCI
@@ -0,0 +1,164 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "tt.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace chessUCI {
+
+namespace {
+    /** Whether memory should be placed by the threads that first touch it. */
+    bool use_first_touch(const NumaTopology& topology, NumaPolicy policy) {
+        return policy == numa_firsttouch ||
+               (policy == numa_auto && topology.numNodes() > 1);
+    }
+
+    /**
+     *  How much deeper than a new result an entry of the current search must
+     *  be to survive it, so that shallow entries still get replaced.
+     */
+    const int REPLACE_DEPTH_MARGIN = 4;
+}   // namespace
+
+TranspositionTable::TranspositionTable() : charge(mem_hash) {
+    table = nullptr;
+    num_entries = 0;
+    alloc_size = 0;
+    generation = 0;
+}
+
+TranspositionTable::~TranspositionTable() {
+    release();
+}
+
+void TranspositionTable::release() {
+    if (!table) return;
+#ifdef __linux__
+    munmap(table, alloc_size);
+#else
+    delete[] table;
+#endif
+    table = nullptr;
+    num_entries = 0;
+    alloc_size = 0;
+    charge.set(0);
+}
+
+bool TranspositionTable::allocate(size_t megabytes) {
+    size_t max_entries = megabytes * 1024 * 1024 / sizeof(TTEntry);
+    num_entries = 1;
+    while (num_entries * 2 <= max_entries) num_entries *= 2;
+    alloc_size = num_entries * sizeof(TTEntry);
+
+#ifdef __linux__
+    // mmap so that no page is touched before the NUMA policy is applied
+    void* mem = mmap(nullptr, alloc_size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) mem = nullptr;
+#ifdef MADV_HUGEPAGE
+    if (mem) madvise(mem, alloc_size, MADV_HUGEPAGE);
+#endif
+    table = static_cast<TTEntry*>(mem);
+#else
+    table = new (std::nothrow) TTEntry[num_entries];
+#endif
+    if (!table) {
+        num_entries = 0;
+        alloc_size = 0;
+        return false;
+    }
+    charge.set(alloc_size);
+    return true;
+}
+
+size_t TranspositionTable::resize(size_t megabytes,
+                                  const NumaTopology& topology,
+                                  NumaPolicy policy, int num_threads) {
+    release();
+
+    // a smaller table beats no engine at all
+    megabytes = std::max<size_t>(megabytes, 1);
+    while (!allocate(megabytes)) {
+        if (megabytes == 1) throw std::bad_alloc();
+        megabytes /= 2;
+    }
+
+    if (policy == numa_interleave) topology.interleave(table, alloc_size);
+    clear(topology, policy, num_threads);
+    return megabytes;
+}
+
+void TranspositionTable::clear(const NumaTopology& topology,
+                               NumaPolicy policy, int num_threads) {
+    num_threads = std::max(num_threads, 1);
+    bool first_touch = use_first_touch(topology, policy);
+    size_t slice = (num_entries + num_threads - 1) / num_threads;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back([&, i]() {
+            if (first_touch) topology.bindThisThread(
+                                            topology.nodeForThread(i));
+            size_t begin = std::min(num_entries, i * slice);
+            size_t end = std::min(num_entries, begin + slice);
+            std::memset(static_cast<void*>(table + begin), 0,
+                        (end - begin) * sizeof(TTEntry));
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+}
+
+void TranspositionTable::store(uint64_t key, chessCore::move_t move,
+                               chessCore::value_t score, int depth,
+                               TTBound bound) {
+    TTEntry& slot = table[key & (num_entries - 1)];
+    uint32_t key32 = static_cast<uint32_t>(key >> 32);
+
+    bool current = slot.generation == generation &&
+                   slot.bound != bound_none;
+
+    if (slot.key == key32) {
+        // keep deeper results for the same position unless they're inexact,
+        // but mark them as used by this search
+        if (depth < slot.depth && bound != bound_exact) {
+            slot.generation = generation;
+            return;
+        }
+    } else if (current && slot.depth >= depth + REPLACE_DEPTH_MARGIN) {
+        // a much deeper entry of this search is worth more than a new one
+        return;
+    }
+    if (slot.key != key32 || move != chessCore::move_t()) slot.move = move;
+    slot.key = key32;
+    slot.score = score;
+    slot.depth = depth;
+    slot.bound = bound;
+    slot.generation = generation;
+}
+
+int TranspositionTable::hashfull() const {
+    size_t sample = std::min<size_t>(1000, num_entries);
+    int used = 0;
+    for (size_t i = 0; i < sample; i++) {
+        if (table[i].bound != bound_none &&
+            table[i].generation == generation) {
+            used++;
+        }
+    }
+    return used * 1000 / sample;
+}
+
+}   // namespace chessUCI
@@ -0,0 +1,70 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "watchdog.h"
+
+#include <utility>
+
+namespace chessUCI {
+
+Watchdog::Watchdog() {
+    quit = false;
+    armed = false;
+    firing = false;
+}
+
+Watchdog::~Watchdog() {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        quit = true;
+    }
+    changed.notify_all();
+    if (thread.joinable()) thread.join();
+}
+
+void Watchdog::run() {
+    std::unique_lock<std::mutex> lock{mutex};
+    while (!quit) {
+        if (!armed) {
+            changed.wait(lock);
+            continue;
+        }
+        if (std::chrono::steady_clock::now() < deadline) {
+            changed.wait_until(lock, deadline);
+            continue;
+        }
+
+        armed = false;
+        firing = true;
+        std::function<void()> callback = on_expiry;
+        lock.unlock();
+        callback();
+        lock.lock();
+        firing = false;
+        changed.notify_all();
+    }
+}
+
+void Watchdog::arm(time_point new_deadline, std::function<void()> callback) {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        if (!thread.joinable()) thread = std::thread(&Watchdog::run, this);
+        deadline = new_deadline;
+        on_expiry = std::move(callback);
+        armed = true;
+    }
+    changed.notify_all();
+}
+
+void Watchdog::disarm() {
+    std::unique_lock<std::mutex> lock{mutex};
+    armed = false;
+    changed.notify_all();
+    changed.wait(lock, [this]() { return !firing; });
+}
+
+}   // namespace chessUCI
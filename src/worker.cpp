@@ -0,0 +1,414 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "engine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "trace.h"
+
+namespace chessUCI {
+
+namespace {
+    /** How many nodes to search between two checks of the limits. */
+    const uint64_t LIMIT_CHECK_INTERVAL = 2048;
+
+    /** How many nodes a thread searches between publishing its line. */
+    const uint64_t LINE_PUBLISH_INTERVAL = 4096;
+
+    /** How many hash table probes are summed up in one trace event. */
+    const uint32_t TT_BURST_SIZE = 4096;
+
+    /** The first depth searched with an aspiration window. */
+    const int ASPIRATION_MIN_DEPTH = 4;
+
+    /** How many moves are searched at full depth before any is reduced. */
+    const int LMR_MIN_MOVES = 3;
+
+    /**
+     *  The static evaluation from the point of view of the side to move.
+     *  The core evaluates positions from white's point of view.
+     */
+    chessCore::value_t staticEval(chessCore::Board& pos) {
+        chessCore::value_t value = pos.evaluate();
+        return pos.getSide() == chessCore::white ? value : -value;
+    }
+
+    /** Make mate scores relative to the position rather than the root. */
+    chessCore::value_t scoreToTT(chessCore::value_t score, int ply) {
+        if (score >= MATE_BOUND) return score + ply;
+        if (score <= -MATE_BOUND) return score - ply;
+        return score;
+    }
+
+    /** Make mate scores relative to the root rather than the position. */
+    chessCore::value_t scoreFromTT(chessCore::value_t score, int ply) {
+        if (score >= MATE_BOUND) return score - ply;
+        if (score <= -MATE_BOUND) return score + ply;
+        return score;
+    }
+}   // namespace
+
+SearchWorker::SearchWorker(Engine& engine, int id, int numa_node) :
+        engine(engine), id(id), numa_node(numa_node) {
+    nodes = 0;
+    seldepth = 0;
+    completed_depth = 0;
+    root_score = 0;
+    next_check = 0;
+    tt_hits = 0;
+    tt_misses = 0;
+    use_nnue = false;
+    cache_generation = 0;
+    root_move_number = 0;
+    publish_line = false;
+    eval_cache.track(&engine.memory);
+}
+
+bool SearchWorker::countNode(int ply) {
+    uint64_t count = nodes.load(std::memory_order_relaxed) + 1;
+    nodes.store(count, std::memory_order_relaxed);
+    if (publish_line && count % LINE_PUBLISH_INTERVAL == 0) {
+        current_line.publish(current_moves, ply);
+    }
+    if (id == 0 && count >= next_check) {
+        uint64_t total = engine.totalNodes();
+        trace::event(trace_time_check, engine.elapsed(), total);
+        if (engine.limitReached()) engine.stop_flag = true;
+        engine.reportStatus();
+
+        uint64_t interval = LIMIT_CHECK_INTERVAL;
+        if (engine.limits.nodes && total < engine.limits.nodes) {
+            interval = std::min(interval, engine.limits.nodes - total);
+        }
+        next_check = count + interval;
+    }
+    return engine.stop_flag.load(std::memory_order_relaxed);
+}
+
+void SearchWorker::countProbe(bool hit) {
+    (hit ? tt_hits : tt_misses)++;
+    if (tt_hits + tt_misses == TT_BURST_SIZE) {
+        trace::event(trace_tt_burst, tt_hits, tt_misses);
+        tt_hits = 0;
+        tt_misses = 0;
+    }
+}
+
+chessCore::value_t SearchWorker::evaluate(chessCore::Board& pos, int ply) {
+    chessCore::value_t value;
+    uint64_t key = 0;
+    if (eval_cache.enabled()) {
+        key = pos.getHashValue();
+        stats.eval_probes++;
+        if (eval_cache.probe(key, &value)) {
+            stats.eval_hits++;
+            return value;
+        }
+    }
+
+    if (use_nnue) {
+        value = engine.network.evaluate(accumulators[ply], pos.getSide());
+        // keep a badly scaled network from producing mate scores
+        value = std::max(std::min(value, MATE_BOUND - 1), -MATE_BOUND + 1);
+    } else {
+        value = staticEval(pos);
+    }
+    if (eval_cache.enabled()) eval_cache.store(key, value);
+    return value;
+}
+
+void SearchWorker::pushMove(chessCore::move_t move, int ply) {
+    nnue::Pieces::Changes changes;
+    pieces[ply + 1] = pieces[ply];
+    pieces[ply + 1].doMove(move, &changes);
+    current_moves[ply] = move;
+    if (!use_nnue) return;
+    engine.network.update(accumulators[ply], changes,
+                          &accumulators[ply + 1]);
+}
+
+chessCore::value_t SearchWorker::quiesce(chessCore::Board& pos,
+                                         chessCore::value_t alpha,
+                                         chessCore::value_t beta, int ply) {
+    pv_length[ply] = 0;
+    if (countNode(ply)) return 0;
+    stats.qnodes++;
+    if (ply > seldepth) seldepth = ply;
+
+    chessCore::value_t stand_pat = evaluate(pos, ply);
+    if (ply >= MAX_PLY - 1 || stand_pat >= beta) return stand_pat;
+    if (stand_pat > alpha) alpha = stand_pat;
+
+    MovePicker picker(pos, pieces[ply], heuristics, chessCore::move_t(),
+                      chessCore::move_t(), ply, true);
+    for (chessCore::move_t move = picker.next(); move != chessCore::move_t();
+         move = picker.next()) {
+        chessCore::Board child = pos;
+        child.doMoveInPlace(move);
+        pushMove(move, ply);
+        chessCore::value_t score = -quiesce(child, -beta, -alpha, ply + 1);
+        if (engine.stop_flag) return 0;
+
+        if (score >= beta) return score;
+        if (score > alpha) alpha = score;
+    }
+    return alpha;
+}
+
+chessCore::value_t SearchWorker::alphaBeta(chessCore::Board& pos,
+                                           chessCore::value_t alpha,
+                                           chessCore::value_t beta,
+                                           int depth, int ply) {
+    if (ply > 0 && (history.isRepetition() || history.isFiftyMoveDraw())) {
+        pv_length[ply] = 0;
+        return 0;
+    }
+    if (depth <= 0) return quiesce(pos, alpha, beta, ply);
+
+    pv_length[ply] = 0;
+    if (countNode(ply)) return 0;
+    if (ply > seldepth) seldepth = ply;
+    if (ply >= MAX_PLY - 1) return evaluate(pos, ply);
+
+    uint64_t key = history.top();
+    chessCore::move_t tt_move;
+    TTEntry entry;
+    bool tt_hit = engine.tt.probe(key, &entry);
+    if (trace::on()) countProbe(tt_hit);
+    stats.tt_probes++;
+    if (tt_hit) {
+        stats.tt_hits++;
+        tt_move = entry.move;
+        // never cut at the root, and keep exact scores from cutting the PV
+        if (ply > 0 && entry.depth >= depth) {
+            chessCore::value_t score = scoreFromTT(entry.score, ply);
+            if ((entry.bound == bound_exact && beta - alpha == 1) ||
+                (entry.bound == bound_lower && score >= beta) ||
+                (entry.bound == bound_upper && score <= alpha)) {
+                stats.tt_cutoffs++;
+                return score;
+            }
+        }
+    }
+    if (tt_move == chessCore::move_t() &&
+        ply < static_cast<int>(engine.predicted_moves.size()) &&
+        engine.predicted_keys[ply] == key) {
+        tt_move = engine.predicted_moves[ply];
+    }
+
+    const OptionValues& params = *engine.search_options;
+    bool pv_node = beta - alpha > 1;
+    bool in_check = pos.isCheck(pos.getSide());
+    chessCore::value_t static_eval = in_check ? -MATE_VALUE :
+                                                evaluate(pos, ply);
+
+    // reverse futility: far enough above beta that a quiet move won't drop
+    // the score below it
+    if (!pv_node && !in_check && depth <= params.rfp_depth &&
+        beta > -MATE_BOUND && beta < MATE_BOUND &&
+        static_eval - params.rfp_margin * depth >= beta) {
+        stats.rfp_cutoffs++;
+        return static_eval;
+    }
+    bool futile = !pv_node && !in_check && depth <= params.futility_depth &&
+                  alpha > -MATE_BOUND && alpha < MATE_BOUND &&
+                  static_eval + params.futility_margin * depth <= alpha;
+    int lmr_min_depth = params.lmr_min_depth ?
+                        std::max(params.lmr_min_depth, 2) : MAX_PLY;
+
+    chessCore::move_t previous = ply > 0 ? current_moves[ply - 1] :
+                                           chessCore::move_t();
+    MovePicker picker = ply == 0 ?
+                        MovePicker(root_moves, pieces[0], heuristics) :
+                        MovePicker(pos, pieces[ply], heuristics, tt_move,
+                                   previous, ply, false);
+    if (picker.numMoves() == 0) return in_check ? -MATE_VALUE + ply : 0;
+
+    chessCore::value_t old_alpha = alpha;
+    chessCore::value_t best_score = -MATE_VALUE;
+    chessCore::move_t best_move;
+    chessCore::move_t quiets_tried[MAX_MOVES];
+    int num_quiets = 0;
+    int i = 0;
+    for (chessCore::move_t move = picker.next(); move != chessCore::move_t();
+         move = picker.next(), i++) {
+        bool quiet = picker.lastWasQuiet();
+        chessCore::Board child = pos;
+        child.doMoveInPlace(move);
+        bool gives_check = child.isCheck(child.getSide());
+        if (futile && i > 0 && quiet && !gives_check) {
+            stats.futility_prunes++;
+            continue;
+        }
+        pushMove(move, ply);
+        uint64_t nodes_before = nodes.load(std::memory_order_relaxed);
+        if (ply == 0) root_move_number = i + 1;
+        history.push(child.getHashValue(), child.getHalfMoveClock());
+
+        chessCore::value_t score;
+        if (i == 0) {
+            score = -alphaBeta(child, -beta, -alpha, depth - 1, ply + 1);
+        } else {
+            int reduction = 0;
+            if (quiet && !in_check && !gives_check &&
+                depth >= lmr_min_depth && i >= LMR_MIN_MOVES) {
+                reduction = reductions[std::min(depth, 63)][std::min(i, 63)];
+                if (pv_node) reduction--;
+                reduction = std::max(0, std::min(reduction, depth - 2));
+            }
+            score = -alphaBeta(child, -alpha - 1, -alpha,
+                               depth - 1 - reduction, ply + 1);
+            if (reduction > 0) stats.lmr_reductions++;
+            if (score > alpha && reduction > 0 && !engine.stop_flag) {
+                stats.lmr_researches++;
+                score = -alphaBeta(child, -alpha - 1, -alpha, depth - 1,
+                                   ply + 1);
+            }
+            if (score > alpha && score < beta && !engine.stop_flag) {
+                score = -alphaBeta(child, -beta, -alpha, depth - 1, ply + 1);
+            }
+        }
+        history.pop();
+        if (engine.stop_flag) return 0;
+        if (ply == 0) {
+            // the picker hands out the root moves in order
+            root_moves[i].nodes += nodes.load(std::memory_order_relaxed) -
+                                   nodes_before;
+            root_moves[i].score = score;
+        }
+
+        if (score > best_score) {
+            best_score = score;
+            best_move = move;
+        }
+        if (score > alpha) {
+            if (ply == 0 && i > 0) {
+                trace::event(trace_root_fail_high, i, score);
+            }
+            alpha = score;
+            pv_table[ply][0] = move;
+            std::copy(pv_table[ply + 1], pv_table[ply + 1] + pv_length[ply + 1],
+                      pv_table[ply] + 1);
+            pv_length[ply] = pv_length[ply + 1] + 1;
+            if (alpha >= beta) {
+                stats.beta_cutoffs++;
+                if (i == 0) stats.first_move_cutoffs++;
+                if (quiet) {
+                    heuristics.update(pos.getSide() == chessCore::white ? 0 : 1,
+                                      move, previous, quiets_tried,
+                                      num_quiets, depth, ply);
+                }
+                break;
+            }
+        }
+        if (quiet) quiets_tried[num_quiets++] = move;
+    }
+
+    TTBound bound = best_score >= beta ? bound_lower :
+                    best_score > old_alpha ? bound_exact : bound_upper;
+    engine.tt.store(key, best_move, scoreToTT(best_score, ply), depth, bound);
+    return best_score;
+}
+
+chessCore::value_t SearchWorker::aspirationSearch(chessCore::Board& root,
+                                                  int depth, int window) {
+    chessCore::value_t alpha = std::max(root_score - window, -MATE_VALUE);
+    chessCore::value_t beta = std::min(root_score + window, MATE_VALUE);
+    while (true) {
+        chessCore::value_t score = alphaBeta(root, alpha, beta, depth, 0);
+        if (engine.stop_flag) return score;
+        // widen the side that failed, doubling the window each time
+        window *= 2;
+        if (score <= alpha) {
+            stats.aspiration_fails++;
+            alpha = std::max(score - window, -MATE_VALUE);
+            trace::event(trace_aspiration_fail_low, score, alpha);
+        } else if (score >= beta) {
+            stats.aspiration_fails++;
+            beta = std::min(score + window, MATE_VALUE);
+            trace::event(trace_aspiration_fail_high, score, beta);
+        } else {
+            return score;
+        }
+    }
+}
+
+void SearchWorker::search() {
+    completed_depth = 0;
+    root_score = 0;
+    root_pv.clear();
+    stats = SearchStats();
+    next_check = 0;
+    history.reset(engine.game_history, MAX_PLY + 1);
+    heuristics.clear();
+    root_move_number = 0;
+    root_moves = engine.root_moves;
+    publish_line = engine.search_options->show_currline;
+    current_line.publish(current_moves, 0);
+    pieces[0] = engine.pieces;
+    use_nnue = engine.network.loaded();
+    if (use_nnue) engine.network.refresh(pieces[0], &accumulators[0]);
+
+    const OptionValues& params = *engine.search_options;
+    // allocated here so that the memory is local to the worker's NUMA node
+    eval_cache.resize(engine.eval_cache_size);
+    if (cache_generation != engine.eval_generation) {
+        eval_cache.clear();
+        cache_generation = engine.eval_generation;
+    }
+
+    double base = params.lmr_base / 100.0;
+    double divisor = params.lmr_divisor / 100.0;
+    for (int depth = 0; depth < 64; depth++) {
+        for (int move = 0; move < 64; move++) {
+            double r = depth && move ?
+                       base + std::log(depth) * std::log(move) / divisor : 0;
+            reductions[depth][move] = static_cast<int8_t>(
+                    std::max(0.0, std::min(r, 63.0)));
+        }
+    }
+
+    int max_depth = engine.limits.depth ?
+                    std::min<int>(engine.limits.depth, MAX_PLY - 1) :
+                    MAX_PLY - 1;
+
+    // helpers start at different depths so that the threads diverge
+    for (int depth = 1 + id % 2; depth <= max_depth; depth++) {
+        seldepth = 0;
+        trace::event(trace_iteration_start, depth);
+        chessCore::Board root = engine.board;
+        chessCore::value_t score;
+        if (params.aspiration_window && depth >= ASPIRATION_MIN_DEPTH &&
+            completed_depth && root_score > -MATE_BOUND &&
+            root_score < MATE_BOUND) {
+            score = aspirationSearch(root, depth, params.aspiration_window);
+        } else {
+            score = alphaBeta(root, -MATE_VALUE, MATE_VALUE, depth, 0);
+        }
+        trace::event(trace_iteration_end, score,
+                     nodes.load(std::memory_order_relaxed));
+        if (completed_depth && score < root_score && !engine.stop_flag) {
+            trace::event(trace_root_fail_low, score, root_score);
+        }
+
+        // only trust an interrupted iteration if there is nothing else
+        if (engine.stop_flag && !root_pv.empty()) break;
+        if (pv_length[0] == 0) break;
+
+        root_pv.assign(pv_table[0], pv_table[0] + pv_length[0]);
+        root_score = score;
+        completed_depth = depth;
+        root_moves.iterationDone(root_pv[0]);
+        if (engine.stop_flag) break;
+        if (id == 0 && !engine.iterationDone(*this)) break;
+    }
+}
+
+}   // namespace chessUCI
@@ -15,7 +15,32 @@ INCLUDEPATH += $${CORE_DIR}/include \
 
 QT -= core gui
 
-HEADERS += include/interface.h \
+HEADERS += include/annotate.h \
+           include/attacks.h \
+           include/bench.h \
+           include/constants.h \
+           include/currline.h \
+           include/engine.h \
+           include/evalcache.h \
+           include/history.h \
+           include/interface.h \
+           include/lan.h \
+           include/matesearch.h \
+           include/membudget.h \
+           include/messages.h \
+           include/metrics.h \
+           include/movepick.h \
+           include/nnue.h \
+           include/numa.h \
+           include/options.h \
+           include/pgn.h \
+           include/position.h \
+           include/rootmoves.h \
+           include/selfplay.h \
+           include/stats.h \
+           include/trace.h \
+           include/tt.h \
+           include/watchdog.h \
            $${CORE_DIR}/include/action.h \
            $${CORE_DIR}/include/board.h \
            $${CORE_DIR}/include/eval.h \
@@ -28,8 +53,39 @@ HEADERS += include/interface.h \
            $${CORE_DIR}/include/twiddle.h \
            $${CORE_DIR}/include/typedefs.h
 
-SOURCES += src/interface.cpp \
-           src/main.cpp
+SOURCES += src/annotate.cpp \
+           src/attacks.cpp \
+           src/bench.cpp \
+           src/currline.cpp \
+           src/engine.cpp \
+           src/evalcache.cpp \
+           src/history.cpp \
+           src/interface.cpp \
+           src/lan.cpp \
+           src/main.cpp \
+           src/matesearch.cpp \
+           src/membudget.cpp \
+           src/metrics.cpp \
+           src/movepick.cpp \
+           src/nnue.cpp \
+           src/numa.cpp \
+           src/options.cpp \
+           src/pgn.cpp \
+           src/position.cpp \
+           src/rootmoves.cpp \
+           src/selfplay.cpp \
+           src/stats.cpp \
+           src/trace.cpp \
+           src/tt.cpp \
+           src/watchdog.cpp \
+           src/worker.cpp
+
+# "make regression" checks the search against scripts/bench_baseline.txt,
+# and fails until a baseline has been written with regression.sh --update
+regression.target = regression
+regression.commands = sh scripts/regression.sh $(TARGET)
+regression.depends = $(TARGET)
+QMAKE_EXTRA_TARGETS += regression
 
 win32 {
     LIBS += $${CORE_DIR}/obj/win32/action.o \